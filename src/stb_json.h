@@ -1,4 +1,4 @@
-/* stb_json - v0.6 - public domain json parser - http://d0n3val.github.org
+/* stb_json - v0.26 - public domain json parser - http://d0n3val.github.org
    no warranty implied; use at your own risk
 
    Do this:
@@ -14,7 +14,16 @@
 
    You can #define STBI_ASSERT(x) before the #include to avoid using assert.h.
    This lib has zero dependencies, even against standard libraries. It does not
-   allocate any memory in the heap.
+   allocate any memory in the heap. The exception is STBJ_ENABLE_THREADS (see
+   PARALLEL FOR): it needs pthreads or Win32 and keeps threads, with the stacks the
+   system gives them, until stbj_pool_shutdown().
+
+   You can #define STBJ_PADDED_BUFFERS before the #include if you promise that all
+   buffers are followed by STBJ_PADDING readable zero bytes (see stbj_pad_buffer).
+   Scans then skip all bounds checks and only stop at '\0'.
+
+   You can #define STBJ_LARGE_DOCUMENTS before the #include to read documents bigger
+   than 4 GB (see SIZES below). All files must agree on it.
 
    QUICK NOTES:
       Primarily of interest to deploy a non-intrusive json parser
@@ -44,7 +53,7 @@ LICENSE AND REVISION HISTORY:
 // Limitations:
 //    - no reading from files, only buffers
 //    - no writing of json files
-//    - not intended for strict/formal parsing
+//    - not intended for strict/formal parsing, use stbj_validate() first for that
 //
 // Basic usage example: ---
 //
@@ -90,7 +99,6 @@ LICENSE AND REVISION HISTORY:
 //
 // TODO ======================================================================
 //
-// Cannot parse exponents for doubles
 // Cannot parse hex, ignored right now (\uFFFF)
 // Unicode support
 // Benchmark the lib against other json parsers
@@ -123,6 +131,8 @@ LICENSE AND REVISION HISTORY:
 
 #define STBJ_VERSION 1
 
+#include <stddef.h> // size_t
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -135,19 +145,44 @@ extern "C" {
 #endif
 #endif
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// SIZES
+//
+// Lengths and offsets are stbj_size, counts and indices (and -1 for errors) stbj_index.
+// By default they are unsigned int and int: documents up to 4 GB and 2^31 values in an
+// array. #define STBJ_LARGE_DOCUMENTS before including this file to make them size_t
+// and ptrdiff_t, for bigger documents (memory mapped dumps for example). It changes
+// structs and prototypes, so every file that includes it must use the same setting.
+//
+#ifdef STBJ_LARGE_DOCUMENTS
+typedef size_t stbj_size;
+typedef ptrdiff_t stbj_index;
+#else
+typedef unsigned int stbj_size;
+typedef int stbj_index;
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // STBJ_CURSOR holds data to parse a buffer from a specific object/array
 //
 enum cursor_type { STBJ_OBJECT, STBJ_ARRAY, STBJ_ERROR };
 
+typedef struct stbj_cache stbj_cache;
+typedef struct stbj_struct_index stbj_struct_index;
+typedef struct stbj_depth_stack stbj_depth_stack;
+
 typedef struct
 {
     enum cursor_type type;
-	unsigned int len;
+	stbj_size len;
 	const char* buffer;
     const char* cursor;
     char error;
+    stbj_cache* cache; // optional, see CACHE below
+    const stbj_struct_index* struct_index; // optional, see STRUCTURAL INDEX below
+    stbj_depth_stack* depth_stack; // optional, see DEPTH below
 } stbj_cursor;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -156,20 +191,518 @@ typedef struct
 //
 STBJDEF int			stbj_any_error(const stbj_cursor* context);
 STBJDEF const char* stbj_get_last_error(const stbj_cursor* context);
-STBJDEF stbj_cursor stbj_load_buffer(const char *buffer, unsigned int len);
-STBJDEF int			stbj_count_values(stbj_cursor* context);
-STBJDEF stbj_cursor stbj_move_cursor_index(stbj_cursor* context, int index);
+STBJDEF stbj_cursor stbj_load_buffer(const char *buffer, stbj_size len);
+STBJDEF stbj_index  stbj_count_values(stbj_cursor* context);
+STBJDEF stbj_cursor stbj_move_cursor_index(stbj_cursor* context, stbj_index index);
 STBJDEF stbj_cursor stbj_move_cursor_name(stbj_cursor* context, const char* name);
-STBJDEF const char* stbj_find_index(stbj_cursor* context, int index);
-STBJDEF int			stbj_find_name(stbj_cursor* context, const char* name);
+STBJDEF const char* stbj_find_index(stbj_cursor* context, stbj_index index);
+STBJDEF stbj_index  stbj_find_name(stbj_cursor* context, const char* name);
 
-STBJDEF int			stbj_read_int_index(stbj_cursor* context, int index, int default_value);
+STBJDEF int			stbj_read_int_index(stbj_cursor* context, stbj_index index, int default_value);
 STBJDEF int			stbj_read_int_name(stbj_cursor* context, const char* name, int default_value);
-STBJDEF double		stbj_read_double_index(stbj_cursor* context, int index, double default_value);
+STBJDEF double		stbj_read_double_index(stbj_cursor* context, stbj_index index, double default_value);
 STBJDEF double		stbj_read_double_name(stbj_cursor* context, const char* name, double default_value);
-STBJDEF int			stbj_read_string_index(stbj_cursor* context, int index, char* buffer, int buffer_size, const char* default_value);
+STBJDEF int			stbj_read_string_index(stbj_cursor* context, stbj_index index, char* buffer, int buffer_size, const char* default_value);
 STBJDEF int			stbj_read_string_name(stbj_cursor* context, const char* name, char* buffer, int buffer_size, const char* default_value);
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// REENTRANT API
+//
+// Same as above but cursors are never written, the error goes to *error instead.
+// They don't use the cache or the depth stack (see CACHE and DEPTH below), so many
+// threads can read the same buffer through the same cursors at once.
+//
+STBJDEF const char* stbj_get_error_string(int error);
+STBJDEF stbj_index  stbj_count_values_r(const stbj_cursor* context, int* error);
+STBJDEF stbj_cursor stbj_move_cursor_index_r(const stbj_cursor* context, stbj_index index, int* error);
+STBJDEF stbj_cursor stbj_move_cursor_name_r(const stbj_cursor* context, const char* name, int* error);
+STBJDEF const char* stbj_find_index_r(const stbj_cursor* context, stbj_index index, int* error);
+STBJDEF stbj_index  stbj_find_name_r(const stbj_cursor* context, const char* name, int* error);
+
+STBJDEF int			stbj_read_int_index_r(const stbj_cursor* context, stbj_index index, int default_value, int* error);
+STBJDEF int			stbj_read_int_name_r(const stbj_cursor* context, const char* name, int default_value, int* error);
+STBJDEF double		stbj_read_double_index_r(const stbj_cursor* context, stbj_index index, double default_value, int* error);
+STBJDEF double		stbj_read_double_name_r(const stbj_cursor* context, const char* name, double default_value, int* error);
+STBJDEF int			stbj_read_string_index_r(const stbj_cursor* context, stbj_index index, char* buffer, int buffer_size, const char* default_value, int* error);
+STBJDEF int			stbj_read_string_name_r(const stbj_cursor* context, const char* name, char* buffer, int buffer_size, const char* default_value, int* error);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// KEYS
+//
+// Name lookups done again and again (the same fields of millions of objects) can
+// hash and measure the name once. stbj_make_key keeps a pointer to name, so name must
+// outlive the key. The _key functions work like their _name versions, but most keys
+// in the document are rejected by one 8 byte compare and a length check. They only
+// match member names, never string values.
+//
+typedef struct
+{
+    const char* name;
+    stbj_size len;
+    unsigned int hash;          // same hash as the cache uses for names
+    unsigned long long prefix;  // first 8 bytes of name, zero padded
+} stbj_key;
+
+STBJDEF stbj_key    stbj_make_key(const char* name);
+STBJDEF stbj_cursor stbj_move_cursor_key(stbj_cursor* context, const stbj_key* key);
+STBJDEF stbj_index  stbj_find_key(stbj_cursor* context, const stbj_key* key);
+STBJDEF int			stbj_read_int_key(stbj_cursor* context, const stbj_key* key, int default_value);
+STBJDEF double		stbj_read_double_key(stbj_cursor* context, const stbj_key* key, double default_value);
+STBJDEF int			stbj_read_string_key(stbj_cursor* context, const stbj_key* key, char* buffer, int buffer_size, const char* default_value);
+
+STBJDEF stbj_cursor stbj_move_cursor_key_r(const stbj_cursor* context, const stbj_key* key, int* error);
+STBJDEF stbj_index  stbj_find_key_r(const stbj_cursor* context, const stbj_key* key, int* error);
+STBJDEF int			stbj_read_int_key_r(const stbj_cursor* context, const stbj_key* key, int default_value, int* error);
+STBJDEF double		stbj_read_double_key_r(const stbj_cursor* context, const stbj_key* key, double default_value, int* error);
+STBJDEF int			stbj_read_string_key_r(const stbj_cursor* context, const stbj_key* key, char* buffer, int buffer_size, const char* default_value, int* error);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// ITERATION
+//
+// Walks the elements of an array or the members of an object once, in order, instead
+// of one scan per index or name. After each step it.element is positioned at the
+// element, read it with index 0: stbj_read_int_index(&it.element, 0, ...) or
+// stbj_move_cursor_index(&it.element, 0). For objects name is the member name as it is
+// in the buffer (escapes kept, not terminated).
+// stbj_iterate returns 1 when it moved to the next element, 0 at the end or on error.
+//
+typedef struct
+{
+    stbj_cursor element;
+    const char* name;
+    stbj_size name_len;
+    stbj_index index;
+    const char* next;       // ',' or closing bracket after the element
+} stbj_iterator;
+
+STBJDEF void        stbj_iterator_init(const stbj_cursor* context, stbj_iterator* it);
+STBJDEF int         stbj_iterate(stbj_cursor* context, stbj_iterator* it);
+STBJDEF int         stbj_iterate_r(const stbj_cursor* context, stbj_iterator* it, int* error);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// VALIDATION
+//
+// The functions above are lenient and only detect errors on the values they touch.
+// Validate a buffer once before trusting it. Returns -1 if valid or the offset of the
+// first error. STRICT checks structure, string escapes, UTF-8, number grammar and
+// true/false/null. LENIENT only checks what the parser relies on: a root object/array,
+// closed strings and matching []{}, so it accepts what the functions above accept.
+//
+enum { STBJ_VALIDATE_STRICT = 0, STBJ_VALIDATE_LENIENT = 1 };
+
+STBJDEF stbj_index  stbj_validate(const char* buffer, stbj_size len, int flags);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// PADDED BUFFERS
+//
+// Copies len bytes from src into dest followed by STBJ_PADDING zero bytes. dest must
+// hold STBJ_PADDED_SIZE(len) bytes and can be src itself. Returns len or 0 if dest is
+// too small. Required for buffers used with #define STBJ_PADDED_BUFFERS.
+//
+#ifndef STBJ_PADDING
+#define STBJ_PADDING 64
+#endif
+#define STBJ_PADDED_SIZE(len) ((len) + STBJ_PADDING)
+
+STBJDEF stbj_size stbj_pad_buffer(char* dest, stbj_size dest_size, const char* src, stbj_size len);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// CACHE
+//
+// Optional memo for documents that stay in memory and are navigated with the same
+// names and indices again and again. Every lookup by (parent, name) or (parent, index)
+// is stored in caller provided entries, so repeating it is a hash probe instead of a
+// scan. Entries are grouped in buckets of 4 and full buckets evict with CLOCK.
+// Cursors created from a cursor with a cache share it. Only the non reentrant functions
+// use it, the _r ones skip it. The cache is not thread safe, use one per thread, and
+// clear it if the buffer changes.
+//
+// Set shapes to 1 for arrays of records with the same keys in the same order: the
+// offset and position where a name was found in one sibling are tried first in the
+// next one (like hidden classes in JS engines). A key found at that offset is used if
+// it is the member at that position of the object, else the object is scanned.
+//
+typedef struct
+{
+    stbj_size parent;    // offset of the parent array/object
+    stbj_size key;       // index or hash of the name
+    stbj_size found;     // offset + 1 of the value (index) or the name (name), 0 if empty
+    stbj_index position; // position of the name in the object
+    unsigned char flags;
+} stbj_cache_entry;
+
+struct stbj_cache
+{
+    stbj_cache_entry* entries;
+    unsigned int num_entries;
+    unsigned int hand;
+    unsigned int hits;
+    unsigned int misses;
+    int shapes;
+};
+
+// num_entries must be a power of two, 4 or more
+STBJDEF void        stbj_cache_init(stbj_cache* cache, stbj_cache_entry* entries, unsigned int num_entries);
+STBJDEF void        stbj_cache_clear(stbj_cache* cache);
+STBJDEF void        stbj_attach_cache(stbj_cursor* context, stbj_cache* cache);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// DEPTH
+//
+// Scanners keep one bit per open array/object. STBJ_MAX_DEPTH levels (1024 by default,
+// #define it before including this file) fit in STBJ_MAX_DEPTH / 8 bytes of C stack.
+// For deeper documents attach words of your own, num_words words hold num_words * 64
+// levels. Nesting past the limit fails with error 10 instead of being cut short.
+// Like the cache the words are written by every scan, so don't share them between
+// threads. Only the non reentrant functions use them: the _r functions and the threads
+// of stbj_parallel_for always stop at STBJ_MAX_DEPTH.
+// stbj_validate has no cursor and always checks up to STBJ_MAX_DEPTH.
+//
+#ifndef STBJ_MAX_DEPTH
+#define STBJ_MAX_DEPTH 1024
+#endif
+
+struct stbj_depth_stack
+{
+    unsigned long long* words;
+    stbj_size num_words;
+};
+
+STBJDEF void        stbj_attach_depth_stack(stbj_cursor* context, stbj_depth_stack* stack);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// STRUCTURAL INDEX
+//
+// Compact index for big documents that are navigated many times. Built once over the
+// whole buffer of context and attached to cursors like the cache, stbj_find_index,
+// stbj_count_values and the element skipping of columns, field index and parallel for
+// jump over nested values instead of reading them. It is a semi-index in caller memory:
+//    - items: one bit per byte, set on brackets and commas outside strings
+//    - parens: two bits per item, '[' '{' are "((", ',' is ")(" and ']' '}' are "))",
+//      so every value is a balanced pair of parens and skipping it is finding its ')'
+//    - ranks and minimum excess per block of 512 bits, so rank, select and finding a
+//      ')' don't depend on the size of what is skipped
+// That is 1 bit per byte plus 2 bits per item, about 1.5 bits per byte for usual JSON.
+// STBJ_STRUCT_INDEX_SIZE(len) bytes of memory are always enough. Returns the bytes used
+// or 0 on error (9 if memory_size is too small, 3/4/5 if brackets don't match).
+// The index is for buffers that don't change, build it again after editing.
+//
+#define STBJ_STRUCT_INDEX_SIZE(len) ((len) / 2 + 256)
+
+struct stbj_struct_index
+{
+    const char* buffer;
+    stbj_size len;
+    stbj_size num_items;
+    unsigned long long* items;
+    stbj_size* item_ranks;      // items before each block
+    unsigned long long* parens;
+    stbj_size* paren_ranks;     // '(' before each block
+    short* block_min;           // lowest excess inside each block, from its start
+    int* super_min;             // same for groups of 64 blocks
+};
+
+STBJDEF stbj_size stbj_build_struct_index(stbj_cursor* context, stbj_struct_index* index, void* memory, stbj_size memory_size);
+STBJDEF stbj_size stbj_build_struct_index_r(const stbj_cursor* context, stbj_struct_index* index, void* memory, stbj_size memory_size, int* error);
+STBJDEF void        stbj_attach_struct_index(stbj_cursor* context, const stbj_struct_index* index);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// COLUMNS
+//
+// Reads the same names from every object of an array into typed columns, in one pass
+// over the array. Buffers are caller memory with the Apache Arrow layout:
+//    - int64/double: one value per row
+//    - string: max_rows + 1 int32 offsets into bytes, row i is bytes[offsets[i], offsets[i+1])
+//    - validity: (max_rows + 7) / 8 bytes, bit (i % 8) of byte (i / 8) is set if row i is
+//      valid, bits past the last row are 0
+// Missing names, null and values that can't be read as the column type are null. Rows stop
+// at max_rows. Strings that don't fit in bytes are null and set error 9.
+// Returns the number of rows or -1 on error.
+//
+enum stbj_column_type { STBJ_COLUMN_INT64, STBJ_COLUMN_DOUBLE, STBJ_COLUMN_STRING };
+
+typedef struct
+{
+    const char* name;
+    enum stbj_column_type type;
+    void* values;               // long long[max_rows], double[max_rows] or int[max_rows + 1]
+    unsigned char* validity;
+    char* bytes;                // only for strings
+    int bytes_size;
+    int null_count;             // filled by stbj_extract_columns
+} stbj_column;
+
+STBJDEF int         stbj_extract_columns(stbj_cursor* context, stbj_column* columns, int num_columns, int max_rows);
+STBJDEF int         stbj_extract_columns_r(const stbj_cursor* context, stbj_column* columns, int num_columns, int max_rows, int* error);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// FIELD INDEX
+//
+// Hash index from the value of _name_ to the object that holds it, for arrays of
+// objects that are searched by a field many times (an id for example). Values are
+// compared as text, as stbj_read_string_name reads them (up to 255 chars and without
+// trailing whitespace), so 123 and "123" are the same. Slots are caller memory,
+// num_slots must be a power of two and hold the elements with some room to spare
+// (error 9 when more than 3/4 full). Build returns the number of indexed objects or
+// -1 on error. Lookups return the object with that value (the first one if repeated)
+// or a cursor with error 2. The index only reads the buffer, it drops the cache and
+// depth stack of context, so many threads can look up at once.
+//
+typedef struct
+{
+    unsigned int hash;
+    stbj_size offset;    // offset + 1 of the object, 0 if empty
+} stbj_field_slot;
+
+typedef struct
+{
+    stbj_cursor context;
+    const char* name;
+    stbj_field_slot* slots;
+    unsigned int num_slots;
+} stbj_field_index;
+
+STBJDEF int         stbj_build_field_index(stbj_cursor* context, const char* name, stbj_field_index* index, stbj_field_slot* slots, unsigned int num_slots);
+STBJDEF int         stbj_build_field_index_r(const stbj_cursor* context, const char* name, stbj_field_index* index, stbj_field_slot* slots, unsigned int num_slots, int* error);
+STBJDEF stbj_cursor stbj_lookup_field(const stbj_field_index* index, const char* value);
+STBJDEF stbj_cursor stbj_lookup_field_int(const stbj_field_index* index, long long value);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// KEY SEARCH
+//
+// Calls fn for every member named _key_ at any depth inside context, in document
+// order, in a single pass that skips 8 bytes at a time where nothing can change the
+// structure. member is the object positioned at that member, so read it with index 0:
+// stbj_read_int_index_r(member, 0, ...) or stbj_move_cursor_index_r(member, 0, ...).
+// depth is 0 for the members of context itself. Return non zero from fn to stop.
+// Returns the number of members found or -1 on error.
+//
+typedef int (*stbj_key_fn)(const stbj_cursor* member, int depth, void* user_data);
+
+STBJDEF stbj_index  stbj_find_all_key(stbj_cursor* context, const char* key, stbj_key_fn fn, void* user_data);
+STBJDEF stbj_index  stbj_find_all_key_r(const stbj_cursor* context, const char* key, stbj_key_fn fn, void* user_data, int* error);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// MINIFY
+//
+// Removes spaces, tabs and newlines outside strings. out needs len bytes and can be
+// in itself (or use stbj_minify_in_place). Returns the new length. Minify documents
+// once when they arrive and every later scan has fewer bytes to go through.
+//
+STBJDEF stbj_size stbj_minify(const char* in, stbj_size len, char* out);
+STBJDEF stbj_size stbj_minify_in_place(char* buffer, stbj_size len);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// PROJECTION
+//
+// Builds a copy of the object at context with only the members selected by paths, as
+// slices of the original buffer plus the '{', '}' and ',' needed between them, so
+// nothing is copied or formatted. Paths are names joined by dots ("a.b.c"), a '\\'
+// before a dot makes it part of the name ("a\\.b" in C is the member "a.b", never "b"
+// inside "a"). A selected member keeps all its value and only objects can be walked into.
+// stbj_slice has the layout of struct iovec on POSIX, so the result can go straight
+// to writev(). Returns the number of slices or -1 on error (9 when max_slices is not
+// enough, 10 for a path of more than 32 names).
+//
+typedef struct
+{
+    const char* base;
+    size_t len;
+} stbj_slice;
+
+STBJDEF int         stbj_project(stbj_cursor* context, const char** paths, int num_paths, stbj_slice* slices, int max_slices);
+STBJDEF int         stbj_project_r(const stbj_cursor* context, const char** paths, int num_paths, stbj_slice* slices, int max_slices, int* error);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// EDITS
+//
+// Keeps the cache of a document that is edited in place. After replacing old_len bytes
+// at offset with new_len bytes, call it with the root cursor and a copy of the replaced
+// bytes. Only the part of the document from the nearest container the cache knows about
+// to the end of the edit is scanned: entries after the edit are moved, entries of the
+// containers around it that may have changed are dropped and the rest are kept.
+// container is set to the smallest object/array around the edit (can be NULL).
+// Returns 0 if nothing changed outside that container, or 1 if the edit changed the
+// structure of the document (an unclosed bracket or string) and the cache was cleared.
+// A structural index can't be updated, it is detached from context.
+//
+STBJDEF int         stbj_apply_edit(stbj_cursor* context, stbj_size offset, const char* old_bytes, stbj_size old_len,
+                                    stbj_size new_len, stbj_cursor* container);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// DOCUMENT STORE
+//
+// For many small objects kept in memory that repeat the same few keys (one record per
+// message or per line of a log). A dictionary keeps each distinct key once, with dense
+// ids from 0. The store indexes the members of every object added to it as (key id,
+// offset) pairs, so finding a member is an integer compare over the members of one
+// document instead of a scan of its text. Resolve the ids once with stbj_key_id and
+// reuse them for every document.
+// It is a lookup index, not a way to save memory: the buffers are kept as they are and
+// every member adds a stbj_store_entry on top of them.
+//
+// Memory is the caller's. stbj_dict_init splits memory in num_slots hash slots (a power
+// of two, the dictionary is full at 3/4), the offsets of the names and the bytes of the
+// names: STBJ_DICT_SIZE gives the memory for num_slots and name_bytes. Keys are stored
+// and compared as they are in the buffer, escapes included. Interning returns the id
+// of the key or -1 when full.
+// stbj_store_add takes a cursor on an object and returns its document number or -1 on
+// error (9 when the store or the dictionary is full, keys interned before stay). Buffers
+// are not copied and must stay in memory. stbj_store_member returns the object
+// positioned at the member, read it with index 0: stbj_read_int_index(&member, 0, ...),
+// or a cursor with error 2.
+// Adding is not thread safe, lookups only read and can run from many threads.
+//
+#define STBJ_DICT_SIZE(num_slots, name_bytes) ((num_slots) * 8 + ((num_slots) / 4 * 3 + 2) * 8 + (name_bytes))
+
+typedef struct
+{
+    unsigned int hash;
+    int key;                    // id + 1, 0 if empty
+} stbj_dict_slot;
+
+typedef struct
+{
+    stbj_dict_slot* slots;
+    unsigned int num_slots;
+    stbj_size* names;           // offset of each name in bytes, one more for the end of the last
+    char* bytes;
+    stbj_size bytes_size;
+    int num_keys;
+} stbj_dict;
+
+typedef struct
+{
+    int key;                    // id in the dictionary
+    stbj_size offset;           // offset of the '{' or ',' before the member
+} stbj_store_entry;
+
+typedef struct
+{
+    const char* buffer;
+    stbj_size len;
+    stbj_size object;           // offset of the '{'
+    stbj_size first;            // first member in the store
+    int num_members;
+} stbj_store_doc;
+
+typedef struct
+{
+    stbj_dict* dict;
+    stbj_store_doc* docs;
+    int max_docs;
+    int num_docs;
+    stbj_store_entry* members;
+    stbj_size max_members;
+    stbj_size num_members;
+} stbj_store;
+
+// Returns 0 if memory can't hold the slots and offsets
+STBJDEF int         stbj_dict_init(stbj_dict* dict, void* memory, stbj_size memory_size, unsigned int num_slots);
+STBJDEF int         stbj_dict_intern(stbj_dict* dict, const char* name, stbj_size len);
+STBJDEF int         stbj_key_id(const stbj_dict* dict, const char* name);
+STBJDEF const char* stbj_dict_name(const stbj_dict* dict, int key, stbj_size* len);
+
+STBJDEF void        stbj_store_init(stbj_store* store, stbj_dict* dict, stbj_store_doc* docs, int max_docs,
+                                    stbj_store_entry* members, stbj_size max_members);
+STBJDEF int         stbj_store_add(stbj_store* store, stbj_cursor* context);
+STBJDEF int         stbj_store_add_r(stbj_store* store, const stbj_cursor* context, int* error);
+STBJDEF stbj_cursor stbj_store_document(const stbj_store* store, int doc);
+STBJDEF stbj_cursor stbj_store_member(const stbj_store* store, int doc, int key);
+
+#ifdef STBJ_ENABLE_THREADS
+//////////////////////////////////////////////////////////////////////////////
+//
+// PARALLEL FOR (#define STBJ_ENABLE_THREADS before including this file)
+//
+// Calls fn once per element of the array (or member of the object) at context from
+// nthreads threads, 0 means one per core. A quick boundary pass splits the elements in
+// chunks, each thread works on its own chunks and steals from the others when it runs out.
+// element is a cursor on the same array starting at element _index_, so read it with
+// index 0: stbj_read_int_index_r(element, 0, ...) or stbj_move_cursor_index_r(element, 0, ...)
+// fn runs concurrently, copy element before using the non reentrant functions on it.
+// Threads are started on the first call and kept for the next ones; a call made while
+// another one runs (from fn or from another thread) runs on the calling thread only.
+// Returns the number of elements or -1 on error. Needs pthreads (-pthread) or Win32.
+//
+// stbj_pool_shutdown() stops and joins the threads, call it when no parallel for runs
+// (e.g. before unloading a library or at exit). The next parallel for starts them again.
+//
+#ifndef STBJ_MAX_THREADS
+#define STBJ_MAX_THREADS 64
+#endif
+
+typedef void (*stbj_element_fn)(const stbj_cursor* element, stbj_index index, void* user_data);
+
+STBJDEF stbj_index  stbj_parallel_for(stbj_cursor* context, stbj_element_fn fn, void* user_data, int nthreads);
+STBJDEF stbj_index  stbj_parallel_for_r(const stbj_cursor* context, stbj_element_fn fn, void* user_data, int nthreads, int* error);
+STBJDEF void        stbj_pool_shutdown(void);
+#endif // STBJ_ENABLE_THREADS
+
+#ifdef STBJ_ENABLE_TRACE
+//////////////////////////////////////////////////////////////////////////////
+//
+// TRACING (#define STBJ_ENABLE_TRACE before including this file)
+//
+// A user callback is called on entry and exit of every scanning function. On exit
+// it also receives the bytes scanned and the elapsed cycles. Index readers count from
+// the value they read, name and key functions from the cursor to where the last
+// function they called stopped (the end of the value read, or the failed scan).
+// #define STBJ_USDT too to get static probes (provider "stb_json") from <sys/sdt.h>
+// named after the function, e.g. "find_name_entry" and "find_name_return".
+//
+enum stbj_trace_func
+{
+    STBJ_TRACE_LOAD_BUFFER,
+    STBJ_TRACE_COUNT_VALUES,
+    STBJ_TRACE_MOVE_CURSOR_INDEX,
+    STBJ_TRACE_MOVE_CURSOR_NAME,
+    STBJ_TRACE_FIND_INDEX,
+    STBJ_TRACE_FIND_NAME,
+    STBJ_TRACE_READ_INT_INDEX,
+    STBJ_TRACE_READ_INT_NAME,
+    STBJ_TRACE_READ_DOUBLE_INDEX,
+    STBJ_TRACE_READ_DOUBLE_NAME,
+    STBJ_TRACE_READ_STRING_INDEX,
+    STBJ_TRACE_READ_STRING_NAME,
+    STBJ_TRACE_FIND_KEY,
+    STBJ_TRACE_MOVE_CURSOR_KEY,
+    STBJ_TRACE_READ_INT_KEY,
+    STBJ_TRACE_READ_DOUBLE_KEY,
+    STBJ_TRACE_READ_STRING_KEY
+};
+
+typedef struct
+{
+    enum stbj_trace_func func;
+    int leave;                  // 0 on entry, 1 on exit
+    const char* name;           // key name or 0 for index based functions
+    stbj_index index;           // index or -1 for name based functions
+    stbj_size scanned;          // bytes from where the function started to where it stopped (exit only)
+    unsigned long long cycles;  // elapsed cycles (exit only)
+} stbj_trace_event;
+
+typedef void (*stbj_trace_callback)(const stbj_trace_event* event, void* user_data);
+
+// Not thread safe, set it once before parsing
+STBJDEF void        stbj_set_trace_callback(stbj_trace_callback callback, void* user_data);
+#endif // STBJ_ENABLE_TRACE
+
 #ifdef __cplusplus
 }
 #endif
@@ -197,6 +730,113 @@ STBJDEF int			stbj_read_string_name(stbj_cursor* context, const char* name, char
 #define STBJ_EXTERN extern
 #endif
 
+// With padded buffers every scan only stops at '\0' or at its own delimiters
+#ifdef STBJ_PADDED_BUFFERS
+#define STBJ__IN_BOUNDS(max_len) ((void)(max_len), 1)
+#define STBJ__HAS_BYTES(max_len) ((void)(max_len), 1)
+#else
+#define STBJ__IN_BOUNDS(max_len) ((max_len)-- > 0)
+#define STBJ__HAS_BYTES(max_len) ((max_len) > 0)
+#endif
+
+///////////////////////////////////////////////
+//
+//  Tracing
+//
+#ifdef STBJ_ENABLE_TRACE
+
+#ifndef STBJ_CYCLES
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define STBJ_CYCLES() __rdtsc()
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define STBJ_CYCLES() __rdtsc()
+#else
+#define STBJ_CYCLES() 0
+#endif
+#endif
+
+#ifdef STBJ_USDT
+#include <sys/sdt.h>
+#define STBJ__PROBE_ENTER(probe, name, index) STAP_PROBE2(stb_json, probe##_entry, name, index)
+#define STBJ__PROBE_LEAVE(probe, t) STAP_PROBE4(stb_json, probe##_return, (t).event.name, (t).event.index, (t).event.scanned, (t).event.cycles)
+#else
+#define STBJ__PROBE_ENTER(probe, name, index) ((void)0)
+#define STBJ__PROBE_LEAVE(probe, t) ((void)0)
+#endif
+
+typedef struct
+{
+    stbj_trace_event event;
+    const char* start;
+} stbj__trace;
+
+#if defined(__cplusplus)
+#define STBJ__THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define STBJ__THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define STBJ__THREAD_LOCAL _Thread_local
+#else
+#define STBJ__THREAD_LOCAL __thread
+#endif
+
+static stbj_trace_callback stbj__trace_callback = 0;
+static void* stbj__trace_user_data = 0;
+
+// Where the last traced function on this thread stopped, name and key functions end there
+static STBJ__THREAD_LOCAL const char* stbj__trace_end = 0;
+
+STBJDEF void stbj_set_trace_callback(stbj_trace_callback callback, void* user_data)
+{
+    stbj__trace_callback = callback;
+    stbj__trace_user_data = user_data;
+}
+
+static void stbj__trace_enter(stbj__trace* t, enum stbj_trace_func func, const char* name, stbj_index index, const char* start)
+{
+    t->event.func = func;
+    t->event.leave = 0;
+    t->event.name = name;
+    t->event.index = index;
+    t->event.scanned = 0;
+    t->event.cycles = 0;
+    t->start = start;
+    stbj__trace_end = 0;
+
+    if(stbj__trace_callback)
+        stbj__trace_callback(&t->event, stbj__trace_user_data);
+
+    t->event.cycles = STBJ_CYCLES();
+}
+
+static void stbj__trace_leave(stbj__trace* t, const char* end)
+{
+    t->event.cycles = STBJ_CYCLES() - t->event.cycles;
+    t->event.leave = 1;
+    t->event.scanned = (t->start && end > t->start) ? (stbj_size)(end - t->start) : 0;
+    if(end)
+        stbj__trace_end = end;
+
+    if(stbj__trace_callback)
+        stbj__trace_callback(&t->event, stbj__trace_user_data);
+}
+
+#define STBJ__TRACE_ENTER(probe, func, name, index, start) \
+    stbj__trace stbj__t; stbj__trace_enter(&stbj__t, func, name, index, start); STBJ__PROBE_ENTER(probe, name, index)
+#define STBJ__TRACE_START(at) (stbj__t.start = (at))
+#define STBJ__TRACE_LEAVE(probe, end) \
+    do { stbj__trace_leave(&stbj__t, end); STBJ__PROBE_LEAVE(probe, stbj__t); } while(0)
+
+#else
+
+#define STBJ__TRACE_ENTER(probe, func, name, index, start) ((void)0)
+#define STBJ__TRACE_START(at) ((void)0)
+#define STBJ__TRACE_LEAVE(probe, end) ((void)0)
+
+#endif // STBJ_ENABLE_TRACE
+
 ///////////////////////////////////////////////
 //
 //  Error Handling functions
@@ -212,7 +852,12 @@ STBJDEF const char* stbj_get_last_error(const stbj_cursor* context)
 {
     STBJ_ASSERT(context);
 
-    switch(context->error)
+    return stbj_get_error_string(context->error);
+}
+
+STBJDEF const char* stbj_get_error_string(int error)
+{
+    switch(error)
     {
         case 0: return "No error";
         case 1: return "JSON parse error, could not find { or [";
@@ -223,6 +868,8 @@ STBJDEF const char* stbj_get_last_error(const stbj_cursor* context)
         case 6: return "Context must be of type Object";
         case 7: return "JSON error parsing string to number";
         case 8: return "JSON error parsing to string";
+        case 9: return "Column buffer too small";
+        case 10: return "JSON nesting deeper than the depth limit";
     }
 
     return "Unknown error";
@@ -230,140 +877,775 @@ STBJDEF const char* stbj_get_last_error(const stbj_cursor* context)
 
 ///////////////////////////////////////////////////////////
 //
-//  Loading buffers and moving cursors around it
+//  Cache
 //
+#define STBJ__CACHE_WAYS 4
+#define STBJ__CACHE_USED 1  // CLOCK reference bit
+#define STBJ__CACHE_NAME 2  // key is a name hash, not an index
+#define STBJ__CACHE_SHAPE 4 // key is a name hash, found is the offset from any parent
+#define STBJ__CACHE_ANY ((stbj_size)-1) // parent of shape entries
 
-// Creates a cursor to parse on that buffer. 
-// WARNING: Application should to keep the memory available for reading.
-STBJDEF stbj_cursor stbj_load_buffer(const char *buffer, unsigned int len)
+STBJDEF void stbj_cache_init(stbj_cache* cache, stbj_cache_entry* entries, unsigned int num_entries)
 {
-    STBJ_ASSERT(buffer);
-    STBJ_ASSERT(len > 0);
+    STBJ_ASSERT(cache);
+    STBJ_ASSERT(entries);
+    STBJ_ASSERT(num_entries >= STBJ__CACHE_WAYS && (num_entries & (num_entries - 1)) == 0);
 
-    stbj_cursor context;
-    context.len = len;
-    context.buffer = buffer;
-    context.cursor = buffer;
-    context.type = STBJ_ERROR;
-    context.error = 1;
+    cache->entries = entries;
+    cache->num_entries = num_entries;
+    cache->shapes = 0;
+    stbj_cache_clear(cache);
+}
 
-    unsigned int max_len = context.len - (unsigned int)(context.cursor - context.buffer);
+STBJDEF void stbj_cache_clear(stbj_cache* cache)
+{
+    STBJ_ASSERT(cache);
 
-    while(max_len-- > 0 && *context.cursor) 
-    { 
-        switch(*context.cursor)
-        {
-			case ' ': case '\n': case '\r': case '\t': break;
-            case '[': context.type = STBJ_ARRAY; context.error = 0; return context;
-            case '{': context.type = STBJ_OBJECT; context.error = 0; return context;
-            default: return context;
-        }
-        ++context.cursor;
-    }
+    for(unsigned int i = 0; i < cache->num_entries; ++i)
+        cache->entries[i].found = 0;
 
-    return context;
+    cache->hand = 0;
+    cache->hits = 0;
+    cache->misses = 0;
 }
 
-// Count the values at the current cursor context. Many nested arrays/objects will count as one.
-STBJDEF int stbj_count_values(stbj_cursor* context)
+STBJDEF void stbj_attach_cache(stbj_cursor* context, stbj_cache* cache)
 {
     STBJ_ASSERT(context);
-    STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
 
-    context->error = 0;
-    int result = 0;
-    int between_comas = 0;
-    char stack[256];
-    int stack_index = -1;
-    char delimiter = (context->type == STBJ_ARRAY) ? ']' : '}';
+    context->cache = cache;
+}
 
-    const char* cursor = context->cursor;
-    unsigned int max_len = context->len - (unsigned int)(cursor - context->buffer);
+// FNV-1a
+static unsigned int stbj__hash_name(const char* name)
+{
+    unsigned int hash = 2166136261u;
+    while(*name)
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    return hash;
+}
+
+static stbj_cache_entry* stbj__cache_bucket(const stbj_cache* cache, stbj_size parent, stbj_size key, int flags)
+{
+    // the high half of 64 bit offsets is folded in, 32 bit ones don't have any
+    unsigned int hash = ((unsigned int)(parent ^ (parent >> 16 >> 16)) * 2654435761u) ^
+                        ((unsigned int)(key ^ (key >> 16 >> 16)) * 0x85EBCA6Bu) ^ (unsigned int)flags;
+    hash ^= hash >> 15;
+    return cache->entries + (hash & (cache->num_entries - STBJ__CACHE_WAYS));
+}
+
+// Returns the entry for (parent, key) or 0. Names are compared against the buffer
+// so a hash collision is just a miss
+static stbj_cache_entry* stbj__cache_find(stbj_cache* cache, stbj_size parent, stbj_size key, int flags,
+                                          const char* buffer, const char* name)
+{
+    stbj_cache_entry* bucket = stbj__cache_bucket(cache, parent, key, flags);
 
-    while(max_len-- > 0 && *++cursor && stack_index < 256) 
+    for(int i = 0; i < STBJ__CACHE_WAYS; ++i)
     {
-        // Two different logics if we are in a nested array/object or not
-        if(stack_index < 0)
-        {
-            // we are on the same array/object level
-            switch(*cursor)
-            {
-                case '[': case '{': stack[++stack_index] = *cursor; break;
-                case ']': case '}': if(!between_comas && *cursor == delimiter) return ++result; break;
-                case ',': result += !between_comas; break;
-                case '"': between_comas = !between_comas; break;
-            }
-        }
-        else
+        stbj_cache_entry* entry = &bucket[i];
+        if(entry->found == 0 || entry->parent != parent || entry->key != key || (entry->flags & ~STBJ__CACHE_USED) != flags)
+            continue;
+
+        if(name)
         {
-            // we are in a nested array/object, keep consuming chars and record progress in out stack
-            switch(*cursor)
-            {
-                case '[': case '{': stack[++stack_index] = *cursor; break;
-                case ']': 
-                    if(stack[stack_index] == '[') --stack_index; 
-                    else { context->error = 4; return -1; } 
-                break;
-                case '}': 
-                    if(stack[stack_index] == '{') --stack_index; 
-                    else { context->error = 5; return -1; } 
-                break;
-            }
+            const char* cursor = buffer + entry->found - 1;
+            const char* compare_cursor = name;
+            while(*compare_cursor && *compare_cursor == *cursor) { ++compare_cursor; ++cursor; }
+            if(*compare_cursor || *cursor != '"') continue;
         }
+
+        entry->flags |= STBJ__CACHE_USED;
+        return entry;
     }
 
-    context->error = 3;
+    return 0;
+}
+
+static void stbj__cache_store(stbj_cache* cache, stbj_size parent, stbj_size key, int flags, stbj_size found, stbj_index position)
+{
+    stbj_cache_entry* bucket = stbj__cache_bucket(cache, parent, key, flags);
+    stbj_cache_entry* entry = 0;
+
+    for(int i = 0; i < STBJ__CACHE_WAYS && !entry; ++i)
+        if(bucket[i].found == 0) entry = &bucket[i];
+
+    // CLOCK: give used entries a second chance until the hand finds one that is not
+    while(!entry)
+    {
+        stbj_cache_entry* candidate = &bucket[cache->hand++ % STBJ__CACHE_WAYS];
+        if(candidate->flags & STBJ__CACHE_USED) candidate->flags &= ~STBJ__CACHE_USED;
+        else entry = candidate;
+    }
+
+    entry->parent = parent;
+    entry->key = key;
+    entry->found = found + 1;
+    entry->position = position;
+    entry->flags = (unsigned char)flags;
+}
+
+static const char* stbj__skip_whitespace(const char* cursor, const char* end);
+static const char* stbj__close_string(const char* cursor, const char* end);
+static int stbj__string_equals(const char* cursor, const char* close, const char* name);
+static const char* stbj__skip_member_name(const char* cursor, const char* end);
+static const char* stbj__next_element(const stbj_cursor* context, const char* cursor, const char* end, char delimiter, int* error);
+
+// Tries the offset where _name_ was found in a sibling. Returns its position or -1
+static stbj_index stbj__cache_shape(const stbj_cursor* context, unsigned int hash, const char* name)
+{
+    stbj_cache_entry* entry = stbj__cache_find(context->cache, STBJ__CACHE_ANY, hash, STBJ__CACHE_SHAPE, 0, 0);
+    if(!entry)
+        return -1;
+
+    const char* end = context->buffer + context->len;
+    const char* key = context->cursor + entry->found - 1;
+    if(key >= end || *key != '"')
+        return -1;
+
+    // the key must start member _position_ of this object, not one of a nested value:
+    // step over the members before it (the structural index jumps when attached)
+    const char* separator = context->cursor;
+    int error = 0;
+    for(stbj_index i = 0; i < entry->position; ++i)
+    {
+        separator = stbj__next_element(context, separator, key, '}', &error);
+        if(separator == 0 || *separator != ',')
+            return -1;
+    }
+
+    if(stbj__skip_whitespace(separator + 1, key) != key)
+        return -1;
+
+    const char* cursor = key + 1;
+    const char* compare_cursor = name;
+    while(*compare_cursor && cursor < end && *compare_cursor == *cursor) { ++compare_cursor; ++cursor; }
+    if(*compare_cursor || cursor >= end || *cursor != '"')
+        return -1;
+
+    while(++cursor < end && *cursor != ':')
+        if(*cursor != ' ' && *cursor != '\n' && *cursor != '\r' && *cursor != '\t') return -1;
+    if(cursor >= end)
+        return -1;
+
+    // remember it for this object too, so the read after find_name is a hit
+    stbj_size parent = (stbj_size)(context->cursor - context->buffer);
+    stbj__cache_store(context->cache, parent, hash, STBJ__CACHE_NAME, (stbj_size)(key + 1 - context->buffer), entry->position);
+    stbj__cache_store(context->cache, parent, (stbj_size)entry->position, 0, (stbj_size)(cursor + 1 - context->buffer), entry->position);
+
+    return entry->position;
+}
+
+///////////////////////////////////////////////////////////
+//
+//  Depth stack
+//
+#define STBJ__DEPTH_WORDS ((STBJ_MAX_DEPTH + 63) / 64)
+
+typedef struct
+{
+    unsigned long long* words;  // bit set for '{'
+    stbj_size max;
+    stbj_size size;
+} stbj__bit_stack;
+
+STBJDEF void stbj_attach_depth_stack(stbj_cursor* context, stbj_depth_stack* stack)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(!stack || (stack->words && stack->num_words > 0));
+
+    context->depth_stack = stack;
+}
+
+// Uses the words attached to context or _local_, STBJ__DEPTH_WORDS words on the caller's stack
+static void stbj__stack_init(stbj__bit_stack* stack, const stbj_cursor* context, unsigned long long* local)
+{
+    stbj_depth_stack* attached = (context) ? context->depth_stack : 0;
+    stack->words = (attached) ? attached->words : local;
+    stack->max = (attached) ? attached->num_words * 64 : STBJ_MAX_DEPTH;
+    stack->size = 0;
+}
+
+// Opens a level for '[' or '{'. Returns 0 if it's past the limit
+static int stbj__stack_push(stbj__bit_stack* stack, char open)
+{
+    if(stack->size == stack->max)
+        return 0;
+
+    unsigned long long bit = 1ull << (stack->size % 64);
+    if(open == '{') stack->words[stack->size / 64] |= bit;
+    else stack->words[stack->size / 64] &= ~bit;
+    ++stack->size;
+    return 1;
+}
+
+// '[' or '{' of the innermost level, the stack must not be empty
+static char stbj__stack_top(const stbj__bit_stack* stack)
+{
+    stbj_size top = stack->size - 1;
+    return ((stack->words[top / 64] >> (top % 64)) & 1) ? '{' : '[';
+}
+
+// Closes the innermost level if _close_ matches it. Returns 0 if it does not
+static int stbj__stack_pop(stbj__bit_stack* stack, char close)
+{
+    if(stbj__stack_top(stack) != ((close == '}') ? '{' : '['))
+        return 0;
+
+    --stack->size;
+    return 1;
+}
+
+// The _r functions leave the cache and depth stack alone, many threads may be calling
+// them on one cursor
+static stbj_cursor stbj__shared(const stbj_cursor* context)
+{
+    STBJ_ASSERT(context);
+    stbj_cursor shared = *context;
+    shared.cache = 0;
+    shared.depth_stack = 0;
+    return shared;
+}
+
+///////////////////////////////////////////////////////////
+//
+//  Structural index
+//
+#define STBJ__INDEX_BLOCK 512   // bits per block of ranks and excess
+#define STBJ__INDEX_SUPER 64    // blocks per super block
+#define STBJ__INDEX_RANKS(n) ((stbj_size)(((n) * sizeof(stbj_size) + 7) / 8 * 8)) // bytes for n ranks
+
+#if defined(__GNUC__) || defined(__clang__)
+#define stbj__popcount64(w) __builtin_popcountll(w)
+#define stbj__ctz64(w) __builtin_ctzll(w)
+#else
+static int stbj__popcount64(unsigned long long w)
+{
+    w = w - ((w >> 1) & 0x5555555555555555ull);
+    w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((w * 0x0101010101010101ull) >> 56);
+}
+#define stbj__ctz64(w) stbj__popcount64(((w) & (~(w) + 1)) - 1)
+#endif
+
+// Excess (opened minus closed parens) before block
+static long long stbj__index_excess(const stbj_struct_index* index, unsigned long long block)
+{
+    return 2 * (long long)index->paren_ranks[block] - (long long)(block * STBJ__INDEX_BLOCK);
+}
+
+static stbj_size stbj__build_struct_index(const stbj_cursor* context, stbj_struct_index* index, void* memory, stbj_size memory_size, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->buffer);
+    STBJ_ASSERT(index);
+    STBJ_ASSERT(memory);
+    STBJ_ASSERT(error);
+
+    const char* buffer = context->buffer;
+    stbj_size len = context->len;
+    stbj_size num_words = len / 64 + 1;
+    stbj_size num_blocks = (num_words + 7) / 8;
+
+    // items and their ranks go first, the parens after them and their directories at
+    // the end once the number of items is known
+    char* base = (char*)memory;
+    stbj_size used = num_words * 8 + STBJ__INDEX_RANKS(num_blocks + 1);
+    *error = 9;
+    if(memory_size < used)
+        return 0;
+
+    index->buffer = buffer;
+    index->len = len;
+    index->items = (unsigned long long*)base;
+    index->item_ranks = (stbj_size*)(base + num_words * 8);
+    index->parens = (unsigned long long*)(base + used);
+
+    stbj_size max_items = (memory_size - used) / 8 * 32;
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+    stbj_size count = 0;
+
+    stbj__stack_init(&stack, context, words);
+
+    for(stbj_size i = 0; i < num_words; ++i)
+        index->items[i] = 0;
+
+    *error = 3;
+    for(stbj_size i = 0; i < len; ++i)
+    {
+        char c = buffer[i];
+        unsigned long long pair; // first paren in the low bit, 1 is '('
+        switch(c)
+        {
+            case '"':
+                while(++i < len && buffer[i] != '"')
+                    if(buffer[i] == '\\') ++i;
+                if(i >= len) return 0;
+                continue;
+            case ',':
+                if(stack.size == 0) return 0;
+                pair = 2;
+            break;
+            case '[': case '{':
+                if(!stbj__stack_push(&stack, c)) { *error = 10; return 0; }
+                pair = 3;
+            break;
+            case ']': case '}':
+                if(stack.size == 0) return 0;
+                if(!stbj__stack_pop(&stack, c)) { *error = (c == ']') ? 4 : 5; return 0; }
+                pair = 0;
+            break;
+            default: continue;
+        }
+
+        if(count == max_items)
+            { *error = 9; return 0; }
+
+        index->items[i / 64] |= 1ull << (i % 64);
+        if(count % 32 == 0) index->parens[count / 32] = 0;
+        index->parens[count / 32] |= pair << (2 * (count % 32));
+        ++count;
+    }
+
+    if(stack.size)
+        return 0;
+
+    index->num_items = count;
+
+    stbj_size total = 0;
+    for(stbj_size i = 0; i < num_words; ++i)
+    {
+        if(i % 8 == 0) index->item_ranks[i / 8] = total;
+        total += (stbj_size)stbj__popcount64(index->items[i]);
+    }
+    index->item_ranks[num_blocks] = total;
+
+    unsigned long long num_bits = 2ull * count;
+    stbj_size paren_words = (stbj_size)((num_bits + 63) / 64);
+    stbj_size paren_blocks = (paren_words + 7) / 8;
+    stbj_size paren_supers = (paren_blocks + STBJ__INDEX_SUPER - 1) / STBJ__INDEX_SUPER;
+
+    used += paren_words * 8;
+    stbj_size ranks_at = used;
+    used += STBJ__INDEX_RANKS(paren_blocks + 1);
+    stbj_size min_at = used;
+    used += (paren_blocks + 3) / 4 * 8;
+    stbj_size super_at = used;
+    used += (paren_supers + 1) / 2 * 8;
+
+    *error = 9;
+    if(memory_size < used)
+        return 0;
+
+    index->paren_ranks = (stbj_size*)(base + ranks_at);
+    index->block_min = (short*)(base + min_at);
+    index->super_min = (int*)(base + super_at);
+
+    total = 0;
+    for(stbj_size block = 0; block < paren_blocks; ++block)
+    {
+        index->paren_ranks[block] = total;
+
+        int excess = 0;
+        int min_excess = 1;
+        unsigned long long end = (unsigned long long)(block + 1) * STBJ__INDEX_BLOCK;
+        for(unsigned long long bit = (unsigned long long)block * STBJ__INDEX_BLOCK; bit < end && bit < num_bits; ++bit)
+        {
+            int open = (int)((index->parens[bit / 64] >> (bit % 64)) & 1);
+            total += (stbj_size)open;
+            excess += open ? 1 : -1;
+            if(excess < min_excess) min_excess = excess;
+        }
+        index->block_min[block] = (short)min_excess;
+
+        long long relative = stbj__index_excess(index, block) - stbj__index_excess(index, block / STBJ__INDEX_SUPER * STBJ__INDEX_SUPER);
+        if(block % STBJ__INDEX_SUPER == 0 || relative + min_excess < index->super_min[block / STBJ__INDEX_SUPER])
+            index->super_min[block / STBJ__INDEX_SUPER] = (int)(relative + min_excess);
+    }
+    index->paren_ranks[paren_blocks] = total;
+
+    *error = 0;
+    return used;
+}
+
+STBJDEF stbj_size stbj_build_struct_index_r(const stbj_cursor* context, stbj_struct_index* index, void* memory, stbj_size memory_size, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__build_struct_index(&shared, index, memory, memory_size, error);
+}
+
+STBJDEF stbj_size stbj_build_struct_index(stbj_cursor* context, stbj_struct_index* index, void* memory, stbj_size memory_size)
+{
+    int error = 0;
+    stbj_size ret = stbj__build_struct_index(context, index, memory, memory_size, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF void stbj_attach_struct_index(stbj_cursor* context, const stbj_struct_index* index)
+{
+    STBJ_ASSERT(context);
+
+    context->struct_index = index;
+}
+
+// 1 if _at_ is a bracket or comma of the buffer indexed for context
+static int stbj__index_usable(const stbj_cursor* context, const char* at)
+{
+    const stbj_struct_index* index = context->struct_index;
+    if(!index || index->buffer != context->buffer || at < index->buffer || at >= index->buffer + index->len)
+        return 0;
+
+    stbj_size offset = (stbj_size)(at - index->buffer);
+    return (int)((index->items[offset / 64] >> (offset % 64)) & 1);
+}
+
+// Number of items before offset
+static stbj_size stbj__index_rank(const stbj_struct_index* index, stbj_size offset)
+{
+    stbj_size word = offset / 64;
+    stbj_size rank = index->item_ranks[word / 8];
+    for(stbj_size i = word / 8 * 8; i < word; ++i)
+        rank += (stbj_size)stbj__popcount64(index->items[i]);
+
+    return rank + (stbj_size)stbj__popcount64(index->items[word] & ((1ull << (offset % 64)) - 1));
+}
+
+// Offset of item
+static stbj_size stbj__index_select(const stbj_struct_index* index, stbj_size item)
+{
+    stbj_size low = 0;
+    stbj_size high = (index->len / 64 + 1 + 7) / 8;
+    while(high - low > 1)
+    {
+        stbj_size middle = (low + high) / 2;
+        if(index->item_ranks[middle] <= item) low = middle;
+        else high = middle;
+    }
+
+    stbj_size word = low * 8;
+    stbj_size left = item - index->item_ranks[low];
+    for(;;)
+    {
+        unsigned int count = (unsigned int)stbj__popcount64(index->items[word]);
+        if(left < count) break;
+        left -= count;
+        ++word;
+    }
+
+    unsigned long long bits = index->items[word];
+    while(left--) bits &= bits - 1;
+    return word * 64 + (stbj_size)stbj__ctz64(bits);
+}
+
+// Lowest excess and excess after the 4 parens of a nibble, first paren in the low bit
+static const signed char stbj__nibble_min[16] = { -4, -2, -2, 0, -2, 0, -1, 1, -3, -1, -1, 1, -2, 0, -1, 1 };
+static const signed char stbj__nibble_excess[16] = { -4, -2, -2, 0, -2, 0, 0, 2, -2, 0, 0, 2, 0, 2, 2, 4 };
+
+// Walks parens from *at to stop while *excess is above 0, a word or a byte at once when
+// they can't bring it down to 0. Returns 1 with *at on the paren that does
+static int stbj__index_walk(const unsigned long long* parens, unsigned long long* at, unsigned long long stop, long long* excess)
+{
+    unsigned long long bit = *at;
+    long long e = *excess;
+
+    while(bit < stop)
+    {
+        unsigned long long word = parens[bit / 64] >> (bit % 64);
+        if(bit % 64 == 0 && e > 64 && bit + 64 <= stop)
+            { e += 2 * stbj__popcount64(word) - 64; bit += 64; continue; }
+
+        if(bit % 8 == 0 && bit + 8 <= stop)
+        {
+            int low = (int)(word & 15);
+            int high = (int)((word >> 4) & 15);
+            int min = stbj__nibble_min[low];
+            if(stbj__nibble_excess[low] + stbj__nibble_min[high] < min)
+                min = stbj__nibble_excess[low] + stbj__nibble_min[high];
+
+            if(e + min > 0)
+                { e += stbj__nibble_excess[low] + stbj__nibble_excess[high]; bit += 8; continue; }
+        }
+
+        e += (word & 1) ? 1 : -1;
+        if(e == 0) { *at = bit; return 1; }
+        ++bit;
+    }
+
+    *at = bit;
+    *excess = e;
+    return 0;
+}
+
+// Returns the ')' that closes the '(' at bit, or ~0ull
+static unsigned long long stbj__index_close(const stbj_struct_index* index, unsigned long long bit)
+{
+    unsigned long long num_bits = 2ull * index->num_items;
+    unsigned long long num_blocks = (num_bits + STBJ__INDEX_BLOCK - 1) / STBJ__INDEX_BLOCK;
+    unsigned long long at = bit + 1;
+    long long excess = 1;
+
+    // the rest of its block, then blocks and super blocks that can reach it by their minimum
+    unsigned long long block = at / STBJ__INDEX_BLOCK;
+    unsigned long long stop = (block + 1) * STBJ__INDEX_BLOCK;
+    if(stbj__index_walk(index->parens, &at, (stop < num_bits) ? stop : num_bits, &excess))
+        return at;
+
+    long long target = stbj__index_excess(index, ++block) - excess;
+    for(;;)
+    {
+        while(block < num_blocks && block % STBJ__INDEX_SUPER == 0 &&
+              stbj__index_excess(index, block) + index->super_min[block / STBJ__INDEX_SUPER] > target)
+            block += STBJ__INDEX_SUPER;
+
+        if(block >= num_blocks)
+            return ~0ull;
+
+        if(stbj__index_excess(index, block) + index->block_min[block] <= target)
+            break;
+        ++block;
+    }
+
+    at = block * STBJ__INDEX_BLOCK;
+    excess = stbj__index_excess(index, block) - target;
+    stop = at + STBJ__INDEX_BLOCK;
+    return stbj__index_walk(index->parens, &at, (stop < num_bits) ? stop : num_bits, &excess) ? at : ~0ull;
+}
+
+// Paren that opens the element after the separator at offset
+static unsigned long long stbj__index_element(const stbj_struct_index* index, stbj_size offset)
+{
+    return 2ull * stbj__index_rank(index, offset) + 1;
+}
+
+// Returns the separator before element _index_ of the array/object at offset, 0 if there is none
+static const char* stbj__index_find(const stbj_struct_index* index, stbj_size offset, stbj_index element)
+{
+    unsigned long long bit = stbj__index_element(index, offset);
+    for(stbj_index i = 0; i < element; ++i)
+    {
+        // elements close on the first paren of ',' or ']', a '(' next means another one
+        unsigned long long close = stbj__index_close(index, bit);
+        if(close == ~0ull || !((index->parens[(close + 1) / 64] >> ((close + 1) % 64)) & 1))
+            return 0;
+        bit = close + 1;
+    }
+
+    return index->buffer + stbj__index_select(index, (stbj_size)(bit / 2));
+}
+
+// Number of values of the array/object at offset or -1
+static stbj_index stbj__index_count(const stbj_struct_index* index, stbj_size offset)
+{
+    unsigned long long bit = stbj__index_element(index, offset);
+    for(stbj_index count = 1;; ++count)
+    {
+        unsigned long long close = stbj__index_close(index, bit);
+        if(close == ~0ull)
+            return -1;
+        if(!((index->parens[(close + 1) / 64] >> ((close + 1) % 64)) & 1))
+            return count;
+        bit = close + 1;
+    }
+}
+
+///////////////////////////////////////////////
+//
+//  Loading buffers and moving cursors around it
+//
+
+STBJDEF stbj_size stbj_pad_buffer(char* dest, stbj_size dest_size, const char* src, stbj_size len)
+{
+    STBJ_ASSERT(dest);
+    STBJ_ASSERT(src);
+
+    if(dest_size < STBJ_PADDED_SIZE(len))
+        return 0;
+
+    if(dest != src)
+        for(stbj_size i = 0; i < len; ++i)
+            dest[i] = src[i];
+
+    for(unsigned int i = 0; i < STBJ_PADDING; ++i)
+        dest[len + i] = 0;
+
+    return len;
+}
+
+// Creates a cursor to parse on that buffer. 
+// WARNING: Application should to keep the memory available for reading.
+STBJDEF stbj_cursor stbj_load_buffer(const char *buffer, stbj_size len)
+{
+    STBJ_ASSERT(buffer);
+    STBJ_ASSERT(len > 0);
+    STBJ__TRACE_ENTER(load_buffer, STBJ_TRACE_LOAD_BUFFER, 0, -1, buffer);
+
+    stbj_cursor context;
+    context.len = len;
+    context.buffer = buffer;
+    context.cursor = buffer;
+    context.type = STBJ_ERROR;
+    context.error = 1;
+    context.cache = 0;
+    context.struct_index = 0;
+    context.depth_stack = 0;
+
+    stbj_size max_len = context.len - (stbj_size)(context.cursor - context.buffer);
+
+    while(STBJ__IN_BOUNDS(max_len) && *context.cursor) 
+    { 
+        switch(*context.cursor)
+        {
+			case ' ': case '\n': case '\r': case '\t': break;
+            case '[': context.type = STBJ_ARRAY; context.error = 0; STBJ__TRACE_LEAVE(load_buffer, context.cursor); return context;
+            case '{': context.type = STBJ_OBJECT; context.error = 0; STBJ__TRACE_LEAVE(load_buffer, context.cursor); return context;
+            default: STBJ__TRACE_LEAVE(load_buffer, context.cursor); return context;
+        }
+        ++context.cursor;
+    }
+
+    STBJ__TRACE_LEAVE(load_buffer, context.cursor);
+    return context;
+}
+
+// Count the values at the current cursor context. Many nested arrays/objects will count as one.
+static stbj_index stbj__count_values(const stbj_cursor* context, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(count_values, STBJ_TRACE_COUNT_VALUES, 0, -1, context->cursor);
+
+    if(stbj__index_usable(context, context->cursor))
+    {
+        stbj_index count = stbj__index_count(context->struct_index, (stbj_size)(context->cursor - context->buffer));
+        *error = (count < 0) ? 3 : 0;
+        STBJ__TRACE_LEAVE(count_values, context->cursor);
+        return count;
+    }
+
+    *error = 0;
+    stbj_index result = 0;
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+    char delimiter = (context->type == STBJ_ARRAY) ? ']' : '}';
+
+    const char* cursor = context->cursor;
+    const char* end = context->buffer + context->len;
+    stbj_size max_len = context->len - (stbj_size)(cursor - context->buffer);
+    stbj__stack_init(&stack, context, words);
+
+    while(STBJ__IN_BOUNDS(max_len) && *++cursor)
+    {
+        // strings are skipped whole at any level, brackets and commas inside don't count
+        if(*cursor == '"')
+        {
+            const char* close = stbj__close_string(cursor, end);
+            cursor = (close) ? close : end;
+            if(!close) break;
+            max_len = (stbj_size)(end - cursor);
+            continue;
+        }
+
+        // Two different logics if we are in a nested array/object or not
+        if(stack.size == 0)
+        {
+            // we are on the same array/object level
+            switch(*cursor)
+            {
+                case '[': case '{': stbj__stack_push(&stack, *cursor); break;
+                case ']': case '}': 
+                    if(*cursor == delimiter) { STBJ__TRACE_LEAVE(count_values, cursor); return ++result; }
+                break;
+                case ',': ++result; break;
+            }
+        }
+        else
+        {
+            // we are in a nested array/object, keep consuming chars and record progress in out stack
+            switch(*cursor)
+            {
+                case '[': case '{':
+                    if(!stbj__stack_push(&stack, *cursor)) { *error = 10; STBJ__TRACE_LEAVE(count_values, cursor); return -1; }
+                break;
+                case ']': case '}':
+                    if(!stbj__stack_pop(&stack, *cursor)) { *error = (*cursor == ']') ? 4 : 5; STBJ__TRACE_LEAVE(count_values, cursor); return -1; }
+                break;
+            }
+        }
+    }
+
+    *error = 3;
+    STBJ__TRACE_LEAVE(count_values, cursor);
     return -1;
 }
 
+static const char* stbj__find_index(const stbj_cursor* context, stbj_index index, int* error);
+static stbj_index stbj__find_name(const stbj_cursor* context, const char* name, int* error);
+
 // Returns a new cursor to begin parsing at index. Use it to parse inside an array or object
-STBJDEF stbj_cursor stbj_move_cursor_index(stbj_cursor* context, int index)
+static stbj_cursor stbj__move_cursor_index(const stbj_cursor* context, stbj_index index, int* error)
 {
     STBJ_ASSERT(context);
     STBJ_ASSERT(context->cursor);
     STBJ_ASSERT(context->type != STBJ_ERROR);
     STBJ_ASSERT(index >= 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(move_cursor_index, STBJ_TRACE_MOVE_CURSOR_INDEX, 0, index, 0);
 
     stbj_cursor ret;
     ret.type = STBJ_ERROR;
     ret.len = context->len;
     ret.buffer = context->buffer;
-    ret.cursor = stbj_find_index(context, index);
+    ret.cursor = stbj__find_index(context, index, error);
     ret.error = 1;
+    ret.cache = context->cache;
+    ret.struct_index = context->struct_index;
+    ret.depth_stack = context->depth_stack;
+    STBJ__TRACE_START(ret.cursor);
 
     if(ret.cursor != 0)
     {
-        unsigned int max_len = context->len - (unsigned int)(ret.cursor - context->buffer);
+        stbj_size max_len = context->len - (stbj_size)(ret.cursor - context->buffer);
 
         // iterate chars
-        while(max_len-- > 0 && *ret.cursor) 
+        while(STBJ__IN_BOUNDS(max_len) && *ret.cursor) 
         { 
             switch(*ret.cursor)
             {
 				case ' ': case '\n': case '\r': case '\t': break;
-                case '[': ret.type = STBJ_ARRAY; ret.error = 0; return ret;
-                case '{': ret.type = STBJ_OBJECT; ret.error = 0; return ret;
-                default: return ret;
+                case '[': ret.type = STBJ_ARRAY; ret.error = 0; STBJ__TRACE_LEAVE(move_cursor_index, ret.cursor); return ret;
+                case '{': ret.type = STBJ_OBJECT; ret.error = 0; STBJ__TRACE_LEAVE(move_cursor_index, ret.cursor); return ret;
+                default: STBJ__TRACE_LEAVE(move_cursor_index, ret.cursor); return ret;
             }
             ++ret.cursor;
         }
     }
 
+    STBJ__TRACE_LEAVE(move_cursor_index, ret.cursor);
     return ret; 
 }
 
 // Returns a new cursor to begin parsing at _name_. Use it to parse inside an array or object
-STBJDEF stbj_cursor stbj_move_cursor_name(stbj_cursor* context, const char* name)
+static stbj_cursor stbj__move_cursor_name(const stbj_cursor* context, const char* name, int* error)
 {
     STBJ_ASSERT(context);
     STBJ_ASSERT(context->cursor);
     STBJ_ASSERT(context->type != STBJ_ERROR);
     STBJ_ASSERT(name);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(move_cursor_name, STBJ_TRACE_MOVE_CURSOR_NAME, name, -1, context->cursor);
 
-    int pos = stbj_find_name(context, name);
+    stbj_index pos = stbj__find_name(context, name, error);
     if (pos >= 0) 
-        return stbj_move_cursor_index(context, pos);
+    {
+        stbj_cursor found = stbj__move_cursor_index(context, pos, error);
+        STBJ__TRACE_LEAVE(move_cursor_name, stbj__trace_end);
+        return found;
+    }
 
     stbj_cursor ret;
     ret.type = STBJ_ERROR;
@@ -371,51 +1653,218 @@ STBJDEF stbj_cursor stbj_move_cursor_name(stbj_cursor* context, const char* name
     ret.buffer = 0;
     ret.cursor = 0;
     ret.error = 2;
+    ret.cache = context->cache;
+    ret.struct_index = context->struct_index;
+    ret.depth_stack = context->depth_stack;
 
+    STBJ__TRACE_LEAVE(move_cursor_name, stbj__trace_end);
     return ret;
 }
 
 // This function is for internal use only: Return a pointer to the value at index
-STBJDEF const char* stbj_find_index(stbj_cursor* context, int index)
+static const char* stbj__find_index(const stbj_cursor* context, stbj_index index, int* error)
 {
     STBJ_ASSERT(context);
     STBJ_ASSERT(context->cursor);
     STBJ_ASSERT(context->type != STBJ_ERROR);
     STBJ_ASSERT(index >= 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(find_index, STBJ_TRACE_FIND_INDEX, 0, index, context->cursor);
 
-    context->error = 3;
-    int result = 0;
-    int between_comas = 0;
-    char stack[256];
-    int stack_index = -1;
-    char delimiter = (context->type == STBJ_ARRAY) ? ']' : '}';
-
-    const char* cursor = context->cursor;
-    unsigned int max_len = context->len - (unsigned int)(cursor - context->buffer);
-
-    while(max_len-- > 0 && *++cursor && stack_index < 256) 
+    stbj_size parent = (stbj_size)(context->cursor - context->buffer);
+    if(context->cache)
     {
-        if(result == index)
+        stbj_cache_entry* entry = stbj__cache_find(context->cache, parent, (stbj_size)index, 0, 0, 0);
+        if(entry)
         {
-            context->error = 0;
+            ++context->cache->hits;
+            *error = 0;
+            STBJ__TRACE_LEAVE(find_index, context->cursor);
+            return context->buffer + entry->found - 1;
+        }
+        ++context->cache->misses;
+    }
+
+    if(stbj__index_usable(context, context->cursor))
+    {
+        const char* cursor = stbj__index_find(context->struct_index, parent, index);
+        *error = 3;
+        if(cursor)
+        {
+            *error = 0;
+            ++cursor;
+
+            // if object skip the name and its ':'
+            if(context->type == STBJ_OBJECT)
+                cursor = stbj__skip_member_name(cursor, context->buffer + context->len);
+
+            if(context->cache)
+                stbj__cache_store(context->cache, parent, (stbj_size)index, 0, (stbj_size)(cursor - context->buffer), index);
+        }
+
+        STBJ__TRACE_LEAVE(find_index, cursor);
+        return cursor;
+    }
+
+    *error = 3;
+    stbj_index result = 0;
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+    char delimiter = (context->type == STBJ_ARRAY) ? ']' : '}';
+
+    const char* cursor = context->cursor;
+    const char* end = context->buffer + context->len;
+    stbj_size max_len = context->len - (stbj_size)(cursor - context->buffer);
+    stbj__stack_init(&stack, context, words);
+
+    while(STBJ__IN_BOUNDS(max_len) && *++cursor)
+    {
+        if(result == index)
+        {
+            *error = 0;
 
-            // if object just consume chars until ':'
+            // if object skip the name and its ':'
             if(context->type == STBJ_OBJECT)
-                while(max_len-- > 0 && *cursor && *cursor++ != ':');
+                cursor = stbj__skip_member_name(cursor, end);
+
+            if(context->cache)
+                stbj__cache_store(context->cache, parent, (stbj_size)index, 0, (stbj_size)(cursor - context->buffer), index);
 
+            STBJ__TRACE_LEAVE(find_index, cursor);
             return cursor;
         }
 
+        // strings are skipped whole at any level, brackets and commas inside don't count
+        if(*cursor == '"')
+        {
+            const char* close = stbj__close_string(cursor, end);
+            cursor = (close) ? close : end;
+            if(!close) break;
+            max_len = (stbj_size)(end - cursor);
+            continue;
+        }
+
+        // Two different logics if we are in a nested array/object or not
+        if(stack.size == 0)
+        {
+            // we are on the same array/object level
+            switch(*cursor)
+            {
+                case '[': case '{': stbj__stack_push(&stack, *cursor); break;
+                case ']': case '}': 
+                    if(*cursor == delimiter) { STBJ__TRACE_LEAVE(find_index, cursor); return 0; }
+                break;
+                case ',': ++result; break;
+            }
+        }
+        else
+        {
+            // we are in a nested array/object, keep consuming chars and record progress in our stack
+            switch(*cursor)
+            {
+                case '[': case '{':
+                    if(!stbj__stack_push(&stack, *cursor)) { *error = 10; STBJ__TRACE_LEAVE(find_index, cursor); return 0; }
+                break;
+                case ']': case '}':
+                    if(!stbj__stack_pop(&stack, *cursor)) { *error = (*cursor == ']') ? 4 : 5; STBJ__TRACE_LEAVE(find_index, cursor); return 0; }
+                break;
+            }
+        }
+    }
+
+    STBJ__TRACE_LEAVE(find_index, cursor);
+    return 0;
+}
+
+// This function is for internal use only: Returns a pointer at the value after _name_
+static stbj_index stbj__find_name(const stbj_cursor* context, const char* name, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(name);
+    STBJ_ASSERT(error);
+
+    STBJ__TRACE_ENTER(find_name, STBJ_TRACE_FIND_NAME, name, -1, context->cursor);
+
+    *error = 6;
+    if(context->type == STBJ_ARRAY)
+    {
+        STBJ__TRACE_LEAVE(find_name, 0);
+        return -1;
+    }
+
+    stbj_size parent = (stbj_size)(context->cursor - context->buffer);
+    unsigned int hash = 0;
+    if(context->cache)
+    {
+        hash = stbj__hash_name(name);
+        stbj_cache_entry* entry = stbj__cache_find(context->cache, parent, hash, STBJ__CACHE_NAME, context->buffer, name);
+        stbj_index position = (entry) ? entry->position : (context->cache->shapes) ? stbj__cache_shape(context, hash, name) : -1;
+        if(position >= 0)
+        {
+            ++context->cache->hits;
+            *error = 0;
+            STBJ__TRACE_LEAVE(find_name, context->cursor);
+            return position;
+        }
+        ++context->cache->misses;
+    }
+
+    *error = 0;
+    stbj_index result = 0;
+    int in_name = 1;    // the next string is a member name, not a value
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+
+    const char* cursor = context->cursor;
+    const char* end = context->buffer + context->len;
+    stbj_size max_len = context->len - (stbj_size)(cursor - context->buffer);
+    stbj__stack_init(&stack, context, words);
+
+    while(STBJ__IN_BOUNDS(max_len) && *++cursor)
+    {
+        // strings are skipped whole at any level, only whole member names match
+        if(*cursor == '"')
+        {
+            const char* close = stbj__close_string(cursor, end);
+            if(!close)
+            {
+                *error = 8;
+                STBJ__TRACE_LEAVE(find_name, end);
+                return -1;
+            }
+
+            if(stack.size == 0 && in_name && stbj__string_equals(cursor + 1, close, name))
+            {
+                if(context->cache)
+                {
+                    stbj__cache_store(context->cache, parent, hash, STBJ__CACHE_NAME, (stbj_size)(cursor + 1 - context->buffer), result);
+                    if(context->cache->shapes)
+                        stbj__cache_store(context->cache, STBJ__CACHE_ANY, hash, STBJ__CACHE_SHAPE, (stbj_size)(cursor - context->cursor), result);
+                }
+
+                STBJ__TRACE_LEAVE(find_name, close);
+                return result;
+            }
+
+            in_name = 0;
+            cursor = close;
+            max_len = (stbj_size)(end - cursor);
+            continue;
+        }
+
         // Two different logics if we are in a nested array/object or not
-        if(stack_index < 0)
+        if(stack.size == 0)
         {
             // we are on the same array/object level
             switch(*cursor)
             {
-                case '[': case '{': stack[++stack_index] = *cursor; break;
-                case ']': case '}': if(!between_comas && *cursor == delimiter) return 0; break;
-                case ',': result += !between_comas; break;
-                case '"': between_comas = !between_comas; break;
+                case '[': case '{': stbj__stack_push(&stack, *cursor); in_name = 0; break;
+                case ']': *error = 4; STBJ__TRACE_LEAVE(find_name, cursor); return -1;
+                case '}': *error = 5; STBJ__TRACE_LEAVE(find_name, cursor); return -1;
+                case ',': ++result; in_name = 1; break;
+                case ':': in_name = 0; break;
             }
         }
         else
@@ -423,573 +1872,2993 @@ STBJDEF const char* stbj_find_index(stbj_cursor* context, int index)
             // we are in a nested array/object, keep consuming chars and record progress in our stack
             switch(*cursor)
             {
-                case '[': case '{': stack[++stack_index] = *cursor; break;
-                case ']': 
-                    if(stack[stack_index] == '[') --stack_index; 
-                    else { context->error = 4; return 0; }
+                case '[': case '{':
+                    if(!stbj__stack_push(&stack, *cursor)) { *error = 10; STBJ__TRACE_LEAVE(find_name, cursor); return -1; }
                 break;
-                case '}': 
-                    if(stack[stack_index] == '{') --stack_index;
-                    else { context->error = 5; return 0; }
+                case ']': case '}':
+                    if(!stbj__stack_pop(&stack, *cursor)) { *error = (*cursor == ']') ? 4 : 5; STBJ__TRACE_LEAVE(find_name, cursor); return -1; }
                 break;
             }
         }
     }
 
-    return 0;
+    *error = 2;
+    STBJ__TRACE_LEAVE(find_name, cursor);
+    return -1;
+}
+
+///////////////////////////////////////////////
+//
+//  Value state machine shared by all read functions
+//
+//  Every byte is mapped to a class and the next state is a lookup on
+//  [state][class], so the hot loop has no per character branches.
+//
+
+enum stbj__value_classes
+{
+    STBJ__C_OTHER, STBJ__C_WS, STBJ__C_QUOTE, STBJ__C_QUOTE_IN, STBJ__C_MINUS, STBJ__C_PLUS, STBJ__C_DOT,
+    STBJ__C_DIGIT, STBJ__C_COMMA, STBJ__C_CLOSE_ARRAY, STBJ__C_CLOSE_OBJECT, STBJ__C_CLOSE_OWN, STBJ__C_CLOSE_OTHER,
+    STBJ__C_OPEN, STBJ__C_BACKSLASH, STBJ__C_SLASH, STBJ__C_HEX,
+    STBJ__C_T, STBJ__C_R, STBJ__C_U, STBJ__C_E, STBJ__C_F, STBJ__C_A, STBJ__C_L, STBJ__C_S, STBJ__C_N, STBJ__C_B,
+    STBJ__C_E_UPPER,
+    STBJ__NUM_CLASSES
+};
+
+enum stbj__value_states
+{
+    STBJ__S_FINISH,
+    STBJ__S_ERROR,
+    STBJ__S_AFTER,          // value parsed, wait until we end the element
+    STBJ__S_BEFORE_NUM,     // int/double: before encountering any value of meaning
+    STBJ__S_INT,            // 123
+    STBJ__S_FRAC,           // 123.45
+    STBJ__S_TRUE_R, STBJ__S_TRUE_U, STBJ__S_TRUE_E,
+    STBJ__S_FALSE_A, STBJ__S_FALSE_L, STBJ__S_FALSE_S, STBJ__S_FALSE_E,
+    STBJ__S_NULL_U, STBJ__S_NULL_L1, STBJ__S_NULL_L2,
+    STBJ__S_BEFORE_STR,     // string: before encountering any value of meaning
+    STBJ__S_STRING,         // "hello world"
+    STBJ__S_BARE,           // hello world (no quotes)
+    STBJ__S_ESCAPE,         // \n \r \b ...
+    STBJ__S_HEX1, STBJ__S_HEX2, STBJ__S_HEX3, STBJ__S_HEX4, // \uFAFA
+    STBJ__S_EXP_START,      // 1e
+    STBJ__S_EXP_SIGN,       // 1e-
+    STBJ__S_EXP,            // 1e-5
+    STBJ__NUM_STATES
+};
+
+#define STBJ__STATE_MASK 0x1F
+#define STBJ__A_COPY     0x20 // copy the char to the string buffer
+#define STBJ__A_ESCAPE   0x40 // copy the escaped char to the string buffer
+
+static const unsigned char stbj__char_class[256] =
+{
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  0,  0,  1,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     1,  0,  2,  0,  0,  0,  0,  0,  0,  0,  0,  5,  8,  4,  6, 15,
+     7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  0,  0,  0,  0,  0,  0,
+     0, 16, 16, 16, 16, 27, 16,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 13, 14,  9,  0,  0,
+     0, 22, 26, 16, 16, 20, 21,  0,  0,  0,  0,  0, 23,  0, 25,  0,
+     0,  0, 18, 24, 17, 19,  0,  0,  0,  0,  0, 13,  0, 10,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+// Rows follow stbj__value_states and columns stbj__value_classes. Values are the next
+// state, plus STBJ__A_COPY/STBJ__A_ESCAPE when the char goes to the string buffer
+static const unsigned char stbj__value_transitions[STBJ__NUM_STATES][STBJ__NUM_CLASSES] =
+{
+    {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }, // finish
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1 }, // error
+    {   1,   2,   1,   2,   1,   1,   1,   1,   0,   1,   1,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1 }, // after
+    {   1,   3,   1,   0,   4,   4,   5,   4,   0,   1,   1,   0,   1,   1,   1,   1,   1,   6,   1,   1,   1,   9,   1,   1,   1,  13,   1,   1 }, // before_num
+    {   1,   2,   1,   2,   1,   1,   5,   4,   0,   1,   1,   0,   1,   1,   1,   1,   1,   1,   1,   1,  24,   1,   1,   1,   1,   1,   1,  24 }, // int
+    {   1,   2,   1,   2,   1,   1,   1,   5,   0,   1,   1,   0,   1,   1,   1,   1,   1,   1,   1,   1,  24,   1,   1,   1,   1,   1,   1,  24 }, // frac
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   7,   1,   1,   1,   1,   1,   1,   1,   1,   1 }, // true_r
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   8,   1,   1,   1,   1,   1,   1,   1,   1 }, // true_u
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   1,   1,   1,   1,   1,   1,   1 }, // true_e
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,  10,   1,   1,   1,   1,   1 }, // false_a
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,  11,   1,   1,   1,   1 }, // false_l
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,  12,   1,   1,   1 }, // false_s
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   1,   1,   1,   1,   1,   1,   1 }, // false_e
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,  14,   1,   1,   1,   1,   1,   1,   1,   1 }, // null_u
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,  15,   1,   1,   1,   1 }, // null_l1
+    {   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   1,   1,   1,   1 }, // null_l2
+    {  50,  16,   1,   1,  50,  50,  50,  50,   0,   1,   1,   0,   1,   1,   1,  50,  50,  50,  50,  50,  50,  50,  50,  50,  50,  13,  50,  50 }, // before_str
+    {  49,  49,  49,   2,  49,  49,  49,  49,  49,  49,  49,  49,  49,  49,  19,  49,  49,  49,  49,  49,  49,  49,  49,  49,  49,  49,  49,  49 }, // string
+    {  50,  50,   1,   1,  50,  50,  50,  50,   0,   1,   1,   0,   1,   1,   1,  50,  50,  50,  50,  50,  50,  50,  50,  50,  50,  50,  50,  50 }, // bare
+    {   0,   0,   0,  81,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  81,  81,   0,  81,  81,  20,   0,  81,   0,   0,   0,  81,  81,   0 }, // escape
+    {   0,   0,   0,   0,   0,   0,   0,  21,   0,   0,   0,   0,   0,   0,   0,   0,  21,   0,   0,   0,  21,  21,  21,   0,   0,   0,  21,  21 }, // hex1
+    {   0,   0,   0,   0,   0,   0,   0,  22,   0,   0,   0,   0,   0,   0,   0,   0,  22,   0,   0,   0,  22,  22,  22,   0,   0,   0,  22,  22 }, // hex2
+    {   0,   0,   0,   0,   0,   0,   0,  23,   0,   0,   0,   0,   0,   0,   0,   0,  23,   0,   0,   0,  23,  23,  23,   0,   0,   0,  23,  23 }, // hex3
+    {   0,   0,   0,   0,   0,   0,   0,  17,   0,   0,   0,   0,   0,   0,   0,   0,  17,   0,   0,   0,  17,  17,  17,   0,   0,   0,  17,  17 }, // hex4
+    {   1,   1,   1,   1,  25,  25,   1,  26,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1 }, // exp_start
+    {   1,   1,   1,   1,   1,   1,   1,  26,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1 }, // exp_sign
+    {   1,   2,   1,   2,   1,   1,   1,  26,   0,   1,   1,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1 }  // exp
+};
+
+// Maps the char after a '\' to the char it represents
+static char stbj__escaped_char(char c)
+{
+    switch(c)
+    {
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+    }
+    return c; // " \ /
+}
+
+// Skips whitespace and an opening '"' before a value, returns if we found the quote.
+// Numbers also skip whitespace after the quote: " 123"
+static int stbj__skip_to_value(const char** cursor, stbj_size* max_len, int skip_after_quote)
+{
+    int quoted = 0;
+
+    while(STBJ__HAS_BYTES(*max_len) && stbj__char_class[(unsigned char)**cursor] == STBJ__C_WS) 
+        { ++*cursor; --*max_len; }
+
+    if(STBJ__HAS_BYTES(*max_len) && **cursor == '"')
+    {
+        quoted = 1;
+        ++*cursor; --*max_len;
+
+        while(skip_after_quote && STBJ__HAS_BYTES(*max_len) && stbj__char_class[(unsigned char)**cursor] == STBJ__C_WS) 
+            { ++*cursor; --*max_len; }
+    }
+
+    return quoted;
+}
+
+// The meaning of '"', ']' and '}' depends on the value and its container, indexed by
+// [quoted][context->type == STBJ_ARRAY]
+static const unsigned char stbj__value_remap[2][2][STBJ__NUM_CLASSES] =
+{
+    {
+        { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 11, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 }, // object
+        { 0, 1, 2, 3, 4, 5, 6, 7, 8, 11, 12, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 }  // array
+    },
+    {
+        { 0, 1, 3, 3, 4, 5, 6, 7, 8, 12, 11, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 }, // object, quoted
+        { 0, 1, 3, 3, 4, 5, 6, 7, 8, 11, 12, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 }  // array, quoted
+    }
+};
+
+// Runs the state machine from _at_ until the value ends. Copied chars go to buffer (if any).
+static int stbj__run_value(const stbj_cursor* context, const char** at, stbj_size max_len, int state, int quoted,
+                           char* buffer, int buffer_size, int* buffer_index)
+{
+    const unsigned char* remap = stbj__value_remap[quoted != 0][context->type == STBJ_ARRAY];
+    const char* cursor = *at;
+
+    while(STBJ__IN_BOUNDS(max_len) && *cursor && state > STBJ__S_ERROR) 
+    {
+        unsigned char next = stbj__value_transitions[state][remap[stbj__char_class[(unsigned char)*cursor]]];
+        state = next & STBJ__STATE_MASK;
+
+        if(next & (STBJ__A_COPY | STBJ__A_ESCAPE))
+        {
+            if(*buffer_index >= buffer_size - 1) { state = STBJ__S_FINISH; break; }
+            buffer[(*buffer_index)++] = (next & STBJ__A_COPY) ? *cursor : stbj__escaped_char(*cursor);
+        }
+
+        ++cursor;
+    }
+
+    *at = cursor;
+    return state;
+}
+
+// A number as the machine read it: value = mantissa * 10^exponent
+typedef struct
+{
+    unsigned long long mantissa;    // first 19 significant digits
+    int exponent;                   // digits past the 19th, fraction and exponent part
+    int negative;
+    char literal;                   // 't', 'f' or 'n' for true, false and null, else 0
+} stbj__number;
+
+// Runs the number machine at _at_ and builds number on the way, so the digits are read
+// once. Returns where the value starts or 0 if there is no value.
+static const char* stbj__scan_number(const stbj_cursor* context, const char** at, stbj__number* number, int* error)
+{
+    stbj_size max_len = context->len - (stbj_size)(*at - context->buffer);
+    int quoted = stbj__skip_to_value(at, &max_len, 1);
+    const unsigned char* remap = stbj__value_remap[quoted != 0][context->type == STBJ_ARRAY];
+    const char* value = *at;
+    const char* cursor = value;
+    int state = STBJ__S_BEFORE_NUM;
+    int exponent_sign = 1, exponent = 0;
+
+    number->mantissa = 0;
+    number->exponent = 0;
+    number->negative = 0;
+
+    while(STBJ__IN_BOUNDS(max_len) && *cursor && state > STBJ__S_ERROR) 
+    {
+        unsigned char char_class = remap[stbj__char_class[(unsigned char)*cursor]];
+        state = stbj__value_transitions[state][char_class] & STBJ__STATE_MASK;
+
+        if(char_class == STBJ__C_DIGIT)
+        {
+            int digit = *cursor - '0';
+            if(state == STBJ__S_EXP)
+                exponent = (exponent < 10000) ? (10 * exponent) + digit : exponent;
+            else if(number->mantissa < 1000000000000000000ull)
+            {
+                number->mantissa = (10 * number->mantissa) + (unsigned long long)digit;
+                number->exponent -= (state == STBJ__S_FRAC);
+            }
+            else
+                number->exponent += (state == STBJ__S_INT);
+        }
+        else if(char_class == STBJ__C_MINUS)
+        {
+            if(state == STBJ__S_EXP_SIGN) exponent_sign = -1;
+            else number->negative = 1;
+        }
+
+        ++cursor;
+    }
+
+    *at = cursor;
+    number->exponent += exponent_sign * exponent;
+
+    // a buffer that ends right after 'e' or the exponent sign ends the machine early
+    if(state == STBJ__S_ERROR || state == STBJ__S_EXP_START || state == STBJ__S_EXP_SIGN)
+    {
+        *error = 7;
+        return 0;
+    }
+
+    if(value == cursor)
+        return 0;
+
+    number->literal = 0;
+    switch(*value)
+    {
+        case 't': case 'f': case 'n':
+            number->literal = *value;
+            return value;
+        case '-': case '+': case '.':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return value;
+    }
+
+    return 0;
+}
+
+static const double stbj__powers_of_ten[23] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Exact when the mantissa fits in 53 bits and the exponent is within 22 (both are exact
+// doubles, one operation rounds once), other values are scaled by steps of 1e22 and can
+// be an ulp off.
+static double stbj__number_to_double(const stbj__number* number)
+{
+    if(number->literal)
+        return (number->literal == 't') ? 1.0 : 0.0;
+
+    int exponent = number->exponent;
+    double result = (double)number->mantissa;
+    if(number->mantissa != 0)
+    {
+        if(number->mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+        {
+            // nothing with 19 digits survives 10^400 either way
+            exponent = (exponent > 400) ? 400 : (exponent < -400) ? -400 : exponent;
+            for(; exponent > 22; exponent -= 22) result *= 1e22;
+            for(; exponent < -22; exponent += 22) result /= 1e22;
+        }
+        result = (exponent < 0) ? result / stbj__powers_of_ten[-exponent] : result * stbj__powers_of_ten[exponent];
+    }
+
+    return (number->negative) ? -result : result; 
+}
+
+// Fractions truncated toward zero. Returns 0 if the value does not fit in [min, max]
+static int stbj__number_to_integer(const stbj__number* number, long long min, long long max, long long* result)
+{
+    if(number->literal)
+    {
+        *result = (number->literal == 't');
+        return 1;
+    }
+
+    unsigned long long magnitude = number->mantissa;
+    int exponent = number->exponent;
+
+    for(; exponent < 0 && magnitude != 0; ++exponent)
+        magnitude /= 10;
+    for(; exponent > 0 && magnitude != 0; --exponent)
+    {
+        if(magnitude > ~0ull / 10)
+            return 0;
+        magnitude *= 10;
+    }
+
+    if(number->negative ? (magnitude > 0ull - (unsigned long long)min) : (magnitude > (unsigned long long)max))
+        return 0;
+
+    *result = (number->negative) ? (long long)(0ull - magnitude) : (long long)magnitude;
+    return 1;
+}
+
+///////////////////////////////////////////////
+//
+//  Core parsing functions
+//
+
+// Try parsing an integer value at index. If unable, return default_value.
+static int stbj__read_int_index(const stbj_cursor* context, stbj_index index, int default_value, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(index >= 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_int_index, STBJ_TRACE_READ_INT_INDEX, 0, index, 0);
+
+    const char* cursor = stbj__find_index(context, index, error);
+
+    if(!cursor)
+    {
+        STBJ__TRACE_LEAVE(read_int_index, 0);
+        return default_value; // error num already set by get_element()
+    }
+    STBJ__TRACE_START(cursor);
+
+    *error = 0;
+    stbj__number number;
+    const char* value = stbj__scan_number(context, &cursor, &number, error);
+    STBJ__TRACE_LEAVE(read_int_index, cursor);
+
+    if(!value)
+        return default_value;
+
+    long long result;
+    if(!stbj__number_to_integer(&number, -2147483647 - 1, 2147483647, &result))
+    {
+        *error = 7;
+        return default_value;
+    }
+
+    return (int)result;
+}
+
+// Try parsing an integer value at _name_. If unable, return default_value.
+static int stbj__read_int_name(const stbj_cursor* context, const char* name, int default_value, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(name);
+    STBJ_ASSERT(error);
+
+    STBJ__TRACE_ENTER(read_int_name, STBJ_TRACE_READ_INT_NAME, name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_name(context, name, error);
+    int ret = (pos >= 0) ? stbj__read_int_index(context, pos, default_value, error) : default_value;
+
+    STBJ__TRACE_LEAVE(read_int_name, stbj__trace_end);
+    return ret;
+}
+
+// Try parsing a double value at index. If unable, return default_value.
+static double stbj__read_double_index(const stbj_cursor* context, stbj_index index, double default_value, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(index >= 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_double_index, STBJ_TRACE_READ_DOUBLE_INDEX, 0, index, 0);
+
+    const char* cursor = stbj__find_index(context, index, error);
+
+    if(!cursor)
+    {
+        STBJ__TRACE_LEAVE(read_double_index, 0);
+        return default_value; // error num already set by get_element()
+    }
+    STBJ__TRACE_START(cursor);
+
+    *error = 0;
+    stbj__number number;
+    const char* value = stbj__scan_number(context, &cursor, &number, error);
+    STBJ__TRACE_LEAVE(read_double_index, cursor);
+
+    if(!value)
+        return default_value;
+
+    return stbj__number_to_double(&number);
+}
+
+// Try parsing a double value at _name_. If unable, return default_value.
+static double stbj__read_double_name(const stbj_cursor* context, const char* name, double default_value, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(name);
+    STBJ_ASSERT(error);
+
+    STBJ__TRACE_ENTER(read_double_name, STBJ_TRACE_READ_DOUBLE_NAME, name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_name(context, name, error);
+    double ret = (pos >= 0) ? stbj__read_double_index(context, pos, default_value, error) : default_value;
+
+    STBJ__TRACE_LEAVE(read_double_name, stbj__trace_end);
+    return ret;
+}
+
+// Try parsing a string at index and fill provided buffer. If unable, fill the buffer with default_value.
+static int stbj__read_string_index(const stbj_cursor* context, stbj_index index, char* buffer, int buffer_size, const char* default_value, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(index >= 0);
+    STBJ_ASSERT(buffer);
+    STBJ_ASSERT(buffer_size > 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_string_index, STBJ_TRACE_READ_STRING_INDEX, 0, index, 0);
+
+    const char* cursor = stbj__find_index(context, index, error);
+    int buffer_index = 0;
+
+    if(cursor)
+    {
+        STBJ__TRACE_START(cursor);
+
+        *error = 0;
+        stbj_size max_len = context->len - (stbj_size)(cursor - context->buffer);
+        int quoted = stbj__skip_to_value(&cursor, &max_len, 0);
+        int state = (quoted) ? STBJ__S_STRING : STBJ__S_BEFORE_STR;
+
+        // TODO: \uFFFF values are validated but ignored (unicode)
+        if(stbj__run_value(context, &cursor, max_len, state, quoted, buffer, buffer_size, &buffer_index) == STBJ__S_ERROR)
+        {
+            *error = 8; 
+            STBJ__TRACE_LEAVE(read_string_index, cursor);
+            return 0;
+        }
+    }
+
+    // if we did not wrote anything, strcpy default value into buffer
+    if(buffer_index == 0 && default_value != 0)
+        while((buffer[buffer_index++] = *default_value++) && buffer_index < (buffer_size-1));
+
+    buffer[buffer_index] = 0;
+    STBJ__TRACE_LEAVE(read_string_index, cursor);
+    return buffer_index; 
+}
+
+// Try parsing a string at _name_ and fill provided buffer. If unable, fill the buffer with default_value.
+static int stbj__read_string_name(const stbj_cursor* context, const char* name, char* buffer, int buffer_size, const char* default_value, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(name);
+    STBJ_ASSERT(buffer);
+    STBJ_ASSERT(buffer_size > 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_string_name, STBJ_TRACE_READ_STRING_NAME, name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_name(context, name, error);
+    if (pos >= 0) 
+    {
+        int ret = stbj__read_string_index(context, pos, buffer, buffer_size, default_value, error);
+        STBJ__TRACE_LEAVE(read_string_name, stbj__trace_end);
+        return ret;
+    }
+    else
+    {
+        int buffer_index = 0;
+        while((buffer[buffer_index++] = *default_value++) && buffer_index < (buffer_size-1));
+    }
+    STBJ__TRACE_LEAVE(read_string_name, stbj__trace_end);
+    return 0;
+}
+
+///////////////////////////////////////////////
+//
+//  Reentrant versions, they work on a copy of the cursor without the cache and depth stack
+//
+
+STBJDEF stbj_index stbj_count_values_r(const stbj_cursor* context, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__count_values(&shared, error);
+}
+
+STBJDEF stbj_cursor stbj_move_cursor_index_r(const stbj_cursor* context, stbj_index index, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    stbj_cursor ret = stbj__move_cursor_index(&shared, index, error);
+    ret.cache = context->cache;
+    ret.depth_stack = context->depth_stack;
+    return ret;
+}
+
+STBJDEF stbj_cursor stbj_move_cursor_name_r(const stbj_cursor* context, const char* name, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    stbj_cursor ret = stbj__move_cursor_name(&shared, name, error);
+    ret.cache = context->cache;
+    ret.depth_stack = context->depth_stack;
+    return ret;
+}
+
+STBJDEF const char* stbj_find_index_r(const stbj_cursor* context, stbj_index index, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__find_index(&shared, index, error);
+}
+
+STBJDEF stbj_index stbj_find_name_r(const stbj_cursor* context, const char* name, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__find_name(&shared, name, error);
+}
+
+STBJDEF int stbj_read_int_index_r(const stbj_cursor* context, stbj_index index, int default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_int_index(&shared, index, default_value, error);
+}
+
+STBJDEF int stbj_read_int_name_r(const stbj_cursor* context, const char* name, int default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_int_name(&shared, name, default_value, error);
+}
+
+STBJDEF double stbj_read_double_index_r(const stbj_cursor* context, stbj_index index, double default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_double_index(&shared, index, default_value, error);
+}
+
+STBJDEF double stbj_read_double_name_r(const stbj_cursor* context, const char* name, double default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_double_name(&shared, name, default_value, error);
+}
+
+STBJDEF int stbj_read_string_index_r(const stbj_cursor* context, stbj_index index, char* buffer, int buffer_size, const char* default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_string_index(&shared, index, buffer, buffer_size, default_value, error);
+}
+
+STBJDEF int stbj_read_string_name_r(const stbj_cursor* context, const char* name, char* buffer, int buffer_size, const char* default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_string_name(&shared, name, buffer, buffer_size, default_value, error);
+}
+
+///////////////////////////////////////////////
+//
+//  Non reentrant versions, they keep the last error in the cursor
+//
+
+STBJDEF stbj_index stbj_count_values(stbj_cursor* context)
+{
+    int error = 0;
+    stbj_index ret = stbj__count_values(context, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF stbj_cursor stbj_move_cursor_index(stbj_cursor* context, stbj_index index)
+{
+    int error = 0;
+    stbj_cursor ret = stbj__move_cursor_index(context, index, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF stbj_cursor stbj_move_cursor_name(stbj_cursor* context, const char* name)
+{
+    int error = 0;
+    stbj_cursor ret = stbj__move_cursor_name(context, name, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF const char* stbj_find_index(stbj_cursor* context, stbj_index index)
+{
+    int error = 0;
+    const char* ret = stbj__find_index(context, index, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF stbj_index stbj_find_name(stbj_cursor* context, const char* name)
+{
+    int error = 0;
+    stbj_index ret = stbj__find_name(context, name, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF int stbj_read_int_index(stbj_cursor* context, stbj_index index, int default_value)
+{
+    int error = 0;
+    int ret = stbj__read_int_index(context, index, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF int stbj_read_int_name(stbj_cursor* context, const char* name, int default_value)
+{
+    int error = 0;
+    int ret = stbj__read_int_name(context, name, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF double stbj_read_double_index(stbj_cursor* context, stbj_index index, double default_value)
+{
+    int error = 0;
+    double ret = stbj__read_double_index(context, index, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF double stbj_read_double_name(stbj_cursor* context, const char* name, double default_value)
+{
+    int error = 0;
+    double ret = stbj__read_double_name(context, name, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF int stbj_read_string_index(stbj_cursor* context, stbj_index index, char* buffer, int buffer_size, const char* default_value)
+{
+    int error = 0;
+    int ret = stbj__read_string_index(context, index, buffer, buffer_size, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF int stbj_read_string_name(stbj_cursor* context, const char* name, char* buffer, int buffer_size, const char* default_value)
+{
+    int error = 0;
+    int ret = stbj__read_string_name(context, name, buffer, buffer_size, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+///////////////////////////////////////////////
+//
+//  Validation
+//
+
+// SWAR helpers: test 8 bytes at a time without any SIMD intrinsics
+#define STBJ__ONES  0x0101010101010101ULL
+#define STBJ__HIGHS 0x8080808080808080ULL
+#define STBJ__HAS_ZERO(w) (((w) - STBJ__ONES) & ~(w) & STBJ__HIGHS)
+#define STBJ__HAS_BYTE(w, c) STBJ__HAS_ZERO((w) ^ (STBJ__ONES * (unsigned char)(c)))
+
+// little endian load of 8 bytes, compilers turn it into a single mov
+static unsigned long long stbj__load64(const char* p)
+{
+    const unsigned char* b = (const unsigned char*)p;
+    return (unsigned long long)b[0]       | (unsigned long long)b[1] << 8  | 
+           (unsigned long long)b[2] << 16 | (unsigned long long)b[3] << 24 |
+           (unsigned long long)b[4] << 32 | (unsigned long long)b[5] << 40 | 
+           (unsigned long long)b[6] << 48 | (unsigned long long)b[7] << 56;
+}
+
+// Skips plain string chars (not '"', '\\', control or non ASCII) 8 bytes at a time
+static const char* stbj__skip_plain_string(const char* cursor, const char* end)
+{
+#ifdef STBJ_PADDED_BUFFERS
+    // padding makes over reading safe, the '\0' after the document stops us
+    (void)end;
+    for(;;)
+#else
+    while(end - cursor >= 8)
+#endif
+    {
+        unsigned long long w = stbj__load64(cursor);
+        if(STBJ__HAS_BYTE(w, '"') | STBJ__HAS_BYTE(w, '\\') | 
+           ((w - STBJ__ONES * 0x20) & ~w & STBJ__HIGHS) | (w & STBJ__HIGHS))
+            break;
+        cursor += 8;
+    }
+    return cursor;
+}
+
+static const char* stbj__skip_whitespace(const char* cursor, const char* end)
+{
+    while(cursor < end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t'))
+        ++cursor;
+    return cursor;
+}
+
+// Returns the '"' that closes the string opened at cursor, escapes skipped, or 0
+static const char* stbj__close_string(const char* cursor, const char* end)
+{
+    for(++cursor;;)
+    {
+        cursor = stbj__skip_plain_string(cursor, end);
+        if(cursor >= end || !*cursor)
+            return 0;
+        if(*cursor == '"')
+            return cursor;
+        cursor += (*cursor == '\\') ? 2 : 1;
+    }
+}
+
+// 1 if the chars from cursor to close are name, escapes compared as written
+static int stbj__string_equals(const char* cursor, const char* close, const char* name)
+{
+    while(cursor < close && *name == *cursor)
+        ++cursor, ++name;
+    return cursor == close && *name == 0;
+}
+
+// Returns the char after the ':' that follows the member name at cursor, the name
+// itself can hold ':'. Returns end (or the '\0') if there is none
+static const char* stbj__skip_member_name(const char* cursor, const char* end)
+{
+    while(cursor < end && *cursor && *cursor != ':')
+    {
+        if(*cursor == '"' && !(cursor = stbj__close_string(cursor, end)))
+            return end;
+        ++cursor;
+    }
+    return (cursor < end && *cursor == ':') ? cursor + 1 : cursor;
+}
+
+// Returns the end of a well formed UTF-8 sequence starting at cursor or 0
+static const char* stbj__validate_utf8(const char* cursor, const char* end)
+{
+    unsigned char c = (unsigned char)*cursor;
+    unsigned char lo = 0x80, hi = 0xBF;
+    int count;
+
+    if(c < 0x80) return cursor + 1;
+    else if(c >= 0xC2 && c <= 0xDF) count = 1;
+    else if(c >= 0xE0 && c <= 0xEF) { count = 2; if(c == 0xE0) lo = 0xA0; if(c == 0xED) hi = 0x9F; }
+    else if(c >= 0xF0 && c <= 0xF4) { count = 3; if(c == 0xF0) lo = 0x90; if(c == 0xF4) hi = 0x8F; }
+    else return 0;
+
+    if(end - cursor <= count) return 0;
+
+    for(int i = 1; i <= count; ++i)
+    {
+        c = (unsigned char)cursor[i];
+        if(c < lo || c > hi) return 0;
+        lo = 0x80; hi = 0xBF;
+    }
+
+    return cursor + count + 1;
+}
+
+// cursor is at the opening '"'. Returns the position after the closing '"'.
+// On error returns 0 and leaves the offending position at *error_at
+static const char* stbj__validate_string(const char* cursor, const char* end, int strict, const char** error_at)
+{
+    ++cursor;
+
+    while(cursor < end)
+    {
+        cursor = stbj__skip_plain_string(cursor, end);
+        if(cursor >= end) break;
+
+        unsigned char c = (unsigned char)*cursor;
+
+        if(c == '"') 
+            return cursor + 1;
+
+        if(c == '\\')
+        {
+            if(++cursor >= end) break;
+
+            if(strict)
+            {
+                switch(*cursor)
+                {
+                    case '"': case '\\': case '/': case 'b':
+                    case 'f': case 'n': case 'r': case 't': break;
+                    case 'u':
+                    {
+                        for(int i = 0; i < 4; ++i)
+                        {
+                            char h = (++cursor < end) ? *cursor : 0;
+                            if(!((h >= '0' && h <= '9') || (h >= 'a' && h <= 'f') || (h >= 'A' && h <= 'F')))
+                                { *error_at = cursor; return 0; }
+                        }
+                    } break;
+                    default: *error_at = cursor; return 0;
+                }
+            }
+            ++cursor;
+        }
+        else if(c == 0 || (strict && c < 0x20))
+        {
+            *error_at = cursor; 
+            return 0;
+        }
+        else if(strict && c >= 0x80)
+        {
+            const char* next = stbj__validate_utf8(cursor, end);
+            if(!next) { *error_at = cursor; return 0; }
+            cursor = next;
+        }
+        else
+            ++cursor;
+    }
+
+    *error_at = end;
+    return 0;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static const char* stbj__validate_number(const char* cursor, const char* end)
+{
+    if(cursor < end && *cursor == '-') ++cursor;
+
+    if(cursor < end && *cursor == '0') ++cursor;
+    else if(cursor < end && *cursor >= '1' && *cursor <= '9')
+        while(++cursor < end && *cursor >= '0' && *cursor <= '9');
+    else return 0;
+
+    if(cursor < end && *cursor == '.')
+    {
+        if(++cursor >= end || *cursor < '0' || *cursor > '9') return 0;
+        while(++cursor < end && *cursor >= '0' && *cursor <= '9');
+    }
+
+    if(cursor < end && (*cursor == 'e' || *cursor == 'E'))
+    {
+        if(++cursor < end && (*cursor == '+' || *cursor == '-')) ++cursor;
+        if(cursor >= end || *cursor < '0' || *cursor > '9') return 0;
+        while(++cursor < end && *cursor >= '0' && *cursor <= '9');
+    }
+
+    return cursor;
+}
+
+static const char* stbj__validate_literal(const char* cursor, const char* end, const char* literal)
+{
+    while(*literal)
+        if(cursor >= end || *cursor++ != *literal++) return 0;
+    return cursor;
+}
+
+// Only what the scanners need: strings closed and matching brackets until the root closes
+static stbj_index stbj__validate_lenient(const char* buffer, const char* cursor, const char* end)
+{
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+    const char* error_at = 0;
+
+    stbj__stack_init(&stack, 0, words);
+
+    while(cursor < end && *cursor)
+    {
+        switch(*cursor)
+        {
+            case '"':
+                cursor = stbj__validate_string(cursor, end, 0, &error_at);
+                if(!cursor) return (stbj_index)(error_at - buffer);
+                continue;
+            case '[': case '{':
+                if(!stbj__stack_push(&stack, *cursor)) return (stbj_index)(cursor - buffer);
+                break;
+            case ']': case '}':
+                if(stack.size == 0 || !stbj__stack_pop(&stack, *cursor)) return (stbj_index)(cursor - buffer);
+                if(stack.size == 0) return -1;
+                break;
+        }
+        ++cursor;
+    }
+
+    return (stbj_index)(cursor - buffer);
+}
+
+STBJDEF stbj_index stbj_validate(const char* buffer, stbj_size len, int flags)
+{
+    STBJ_ASSERT(buffer);
+
+    enum validate_states
+    {
+        value,              // any value
+        value_or_close,     // any value or ]
+        key,                // "key"
+        key_or_close,       // "key" or }
+        colon,              // :
+        next                // , ] } or end of document
+    } state = value;
+
+    const char* end = buffer + len;
+    const char* cursor = stbj__skip_whitespace(buffer, end);
+    const char* error_at = 0;
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+
+    stbj__stack_init(&stack, 0, words);
+
+    // same as stbj_load_buffer: root must be an object or an array
+    if(cursor >= end || (*cursor != '{' && *cursor != '['))
+        return (stbj_index)(cursor - buffer);
+
+    if(flags & STBJ_VALIDATE_LENIENT)
+        return stbj__validate_lenient(buffer, cursor, end);
+
+    for(;;)
+    {
+        cursor = stbj__skip_whitespace(cursor, end);
+
+        // a trailing '\0' is accepted as the end of the document
+        if(cursor >= end || *cursor == 0)
+            return (state == next && stack.size == 0) ? -1 : (stbj_index)(cursor - buffer);
+
+        const char* c = cursor;
+
+        switch(state)
+        {
+            case value_or_close:
+                if(*c == ']') { stbj__stack_pop(&stack, *c); state = next; ++cursor; break; }
+                // fall through
+            case value:
+            {
+                switch(*c)
+                {
+                    case '[': case '{':
+                        if(!stbj__stack_push(&stack, *c)) return (stbj_index)(c - buffer);
+                        state = (*c == '[') ? value_or_close : key_or_close;
+                        ++cursor;
+                        continue;
+                    case '"': cursor = stbj__validate_string(c, end, 1, &error_at); break;
+                    case 't': cursor = stbj__validate_literal(c, end, "true"); break;
+                    case 'f': cursor = stbj__validate_literal(c, end, "false"); break;
+                    case 'n': cursor = stbj__validate_literal(c, end, "null"); break;
+                    default: cursor = stbj__validate_number(c, end); break;
+                }
+
+                if(!cursor) return (stbj_index)(((error_at) ? error_at : c) - buffer);
+                state = next;
+            } break;
+
+            case key_or_close:
+                if(*c == '}') { stbj__stack_pop(&stack, *c); state = next; ++cursor; break; }
+                // fall through
+            case key:
+            {
+                if(*c != '"') return (stbj_index)(c - buffer);
+                cursor = stbj__validate_string(c, end, 1, &error_at);
+                if(!cursor) return (stbj_index)(error_at - buffer);
+                state = colon;
+            } break;
+
+            case colon:
+            {
+                if(*c != ':') return (stbj_index)(c - buffer);
+                ++cursor;
+                state = value;
+            } break;
+
+            case next:
+            {
+                if(stack.size == 0) return (stbj_index)(c - buffer); // garbage after root
+
+                switch(*c)
+                {
+                    case ',': state = (stbj__stack_top(&stack) == '[') ? value : key; break;
+                    case ']': case '}': if(!stbj__stack_pop(&stack, *c)) return (stbj_index)(c - buffer); break;
+                    default: return (stbj_index)(c - buffer);
+                }
+                ++cursor;
+            } break;
+        }
+    }
+}
+///////////////////////////////////////////////
+//
+//  Keys
+//
+
+STBJDEF stbj_key stbj_make_key(const char* name)
+{
+    STBJ_ASSERT(name);
+
+    stbj_key key;
+    key.name = name;
+    key.len = 0;
+    key.hash = stbj__hash_name(name);
+    key.prefix = 0;
+    while(name[key.len])
+    {
+        if(key.len < 8)
+            key.prefix |= (unsigned long long)(unsigned char)name[key.len] << (8 * key.len);
+        ++key.len;
+    }
+    return key;
+}
+
+// bytes of an 8 byte load that belong to the key
+static unsigned long long stbj__key_mask(const stbj_key* key)
+{
+    return (key->len >= 8) ? ~0ULL : (1ULL << (8 * key->len)) - 1;
+}
+
+// 1 if the member name that starts at _at_ (just after its '"') is key
+static int stbj__key_equals(const stbj_key* key, unsigned long long mask, const char* at, const char* end)
+{
+    if(end - at <= (ptrdiff_t)key->len || at[key->len] != '"')
+        return 0;
+
+    stbj_size i = 0;
+    if(end - at >= 8)
+    {
+        if((stbj__load64(at) & mask) != key->prefix)
+            return 0;
+        i = (key->len < 8) ? key->len : 8;
+    }
+    for(; i < key->len; ++i)
+        if(at[i] != key->name[i])
+            return 0;
+    return 1;
+}
+
+// Same as stbj_find_name_r but strings are skipped whole and only member names are compared
+static stbj_index stbj__find_key(const stbj_cursor* context, const stbj_key* key, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(key && key->name);
+    STBJ_ASSERT(error);
+
+    STBJ__TRACE_ENTER(find_key, STBJ_TRACE_FIND_KEY, key->name, -1, context->cursor);
+
+    *error = 6;
+    if(context->type == STBJ_ARRAY)
+    {
+        STBJ__TRACE_LEAVE(find_key, 0);
+        return -1;
+    }
+
+    stbj_size parent = (stbj_size)(context->cursor - context->buffer);
+    if(context->cache)
+    {
+        stbj_cache_entry* entry = stbj__cache_find(context->cache, parent, key->hash, STBJ__CACHE_NAME, context->buffer, key->name);
+        stbj_index position = (entry) ? entry->position : (context->cache->shapes) ? stbj__cache_shape(context, key->hash, key->name) : -1;
+        if(position >= 0)
+        {
+            ++context->cache->hits;
+            *error = 0;
+            STBJ__TRACE_LEAVE(find_key, context->cursor);
+            return position;
+        }
+        ++context->cache->misses;
+    }
+
+    *error = 0;
+    stbj_index result = 0;
+    int expect_name = 1;
+    unsigned long long mask = stbj__key_mask(key);
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+
+    const char* cursor = context->cursor;
+    const char* end = context->buffer + context->len;
+    stbj_size max_len = context->len - (stbj_size)(cursor - context->buffer);
+    stbj__stack_init(&stack, context, words);
+
+    while(STBJ__IN_BOUNDS(max_len) && *++cursor)
+    {
+        if(stack.size == 0)
+        {
+            switch(*cursor)
+            {
+                case '[': case '{': stbj__stack_push(&stack, *cursor); break;
+                case ']': *error = 4; STBJ__TRACE_LEAVE(find_key, cursor); return -1;
+                case '}': *error = 5; STBJ__TRACE_LEAVE(find_key, cursor); return -1;
+                case ',': ++result; expect_name = 1; break;
+                case '"':
+                    if(expect_name && stbj__key_equals(key, mask, cursor + 1, end))
+                    {
+                        if(context->cache)
+                        {
+                            stbj__cache_store(context->cache, parent, key->hash, STBJ__CACHE_NAME, (stbj_size)(cursor + 1 - context->buffer), result);
+                            if(context->cache->shapes)
+                                stbj__cache_store(context->cache, STBJ__CACHE_ANY, key->hash, STBJ__CACHE_SHAPE, (stbj_size)(cursor - context->cursor), result);
+                        }
+
+                        STBJ__TRACE_LEAVE(find_key, cursor);
+                        return result;
+                    }
+                    expect_name = 0;
+
+                    // jump to the closing quote, escapes skipped like stbj_find_name_r does
+                    cursor = stbj__close_string(cursor, end);
+                    if(!cursor)
+                    {
+                        *error = 8;
+                        STBJ__TRACE_LEAVE(find_key, end);
+                        return -1;
+                    }
+                    max_len = (stbj_size)(end - cursor);
+                break;
+            }
+        }
+        else
+        {
+            switch(*cursor)
+            {
+                case '"':
+                    cursor = stbj__close_string(cursor, end);
+                    if(!cursor) { *error = 8; STBJ__TRACE_LEAVE(find_key, end); return -1; }
+                    max_len = (stbj_size)(end - cursor);
+                break;
+                case '[': case '{':
+                    if(!stbj__stack_push(&stack, *cursor)) { *error = 10; STBJ__TRACE_LEAVE(find_key, cursor); return -1; }
+                break;
+                case ']': case '}':
+                    if(!stbj__stack_pop(&stack, *cursor)) { *error = (*cursor == ']') ? 4 : 5; STBJ__TRACE_LEAVE(find_key, cursor); return -1; }
+                break;
+            }
+        }
+    }
+
+    *error = 2;
+    STBJ__TRACE_LEAVE(find_key, cursor);
+    return -1;
+}
+
+static stbj_cursor stbj__move_cursor_key(const stbj_cursor* context, const stbj_key* key, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(key);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(move_cursor_key, STBJ_TRACE_MOVE_CURSOR_KEY, key->name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_key(context, key, error);
+    if (pos >= 0) 
+    {
+        stbj_cursor found = stbj__move_cursor_index(context, pos, error);
+        STBJ__TRACE_LEAVE(move_cursor_key, stbj__trace_end);
+        return found;
+    }
+
+    stbj_cursor ret;
+    ret.type = STBJ_ERROR;
+    ret.len = 0;
+    ret.buffer = 0;
+    ret.cursor = 0;
+    ret.error = 2;
+    ret.cache = context->cache;
+    ret.struct_index = context->struct_index;
+    ret.depth_stack = context->depth_stack;
+
+    STBJ__TRACE_LEAVE(move_cursor_key, stbj__trace_end);
+    return ret;
+}
+
+static int stbj__read_int_key(const stbj_cursor* context, const stbj_key* key, int default_value, int* error)
+{
+    STBJ_ASSERT(key);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_int_key, STBJ_TRACE_READ_INT_KEY, key->name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_key(context, key, error);
+    int ret = (pos >= 0) ? stbj__read_int_index(context, pos, default_value, error) : default_value;
+
+    STBJ__TRACE_LEAVE(read_int_key, stbj__trace_end);
+    return ret;
+}
+
+static double stbj__read_double_key(const stbj_cursor* context, const stbj_key* key, double default_value, int* error)
+{
+    STBJ_ASSERT(key);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_double_key, STBJ_TRACE_READ_DOUBLE_KEY, key->name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_key(context, key, error);
+    double ret = (pos >= 0) ? stbj__read_double_index(context, pos, default_value, error) : default_value;
+
+    STBJ__TRACE_LEAVE(read_double_key, stbj__trace_end);
+    return ret;
+}
+
+static int stbj__read_string_key(const stbj_cursor* context, const stbj_key* key, char* buffer, int buffer_size, const char* default_value, int* error)
+{
+    STBJ_ASSERT(key);
+    STBJ_ASSERT(buffer);
+    STBJ_ASSERT(buffer_size > 0);
+    STBJ_ASSERT(error);
+    STBJ__TRACE_ENTER(read_string_key, STBJ_TRACE_READ_STRING_KEY, key->name, -1, context->cursor);
+
+    stbj_index pos = stbj__find_key(context, key, error);
+    if (pos >= 0) 
+    {
+        int ret = stbj__read_string_index(context, pos, buffer, buffer_size, default_value, error);
+        STBJ__TRACE_LEAVE(read_string_key, stbj__trace_end);
+        return ret;
+    }
+    else
+    {
+        int buffer_index = 0;
+        while((buffer[buffer_index++] = *default_value++) && buffer_index < (buffer_size-1));
+    }
+    STBJ__TRACE_LEAVE(read_string_key, stbj__trace_end);
+    return 0;
+}
+
+STBJDEF stbj_cursor stbj_move_cursor_key_r(const stbj_cursor* context, const stbj_key* key, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    stbj_cursor ret = stbj__move_cursor_key(&shared, key, error);
+    ret.cache = context->cache;
+    ret.depth_stack = context->depth_stack;
+    return ret;
+}
+
+STBJDEF stbj_index stbj_find_key_r(const stbj_cursor* context, const stbj_key* key, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__find_key(&shared, key, error);
+}
+
+STBJDEF int stbj_read_int_key_r(const stbj_cursor* context, const stbj_key* key, int default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_int_key(&shared, key, default_value, error);
+}
+
+STBJDEF double stbj_read_double_key_r(const stbj_cursor* context, const stbj_key* key, double default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_double_key(&shared, key, default_value, error);
+}
+
+STBJDEF int stbj_read_string_key_r(const stbj_cursor* context, const stbj_key* key, char* buffer, int buffer_size, const char* default_value, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__read_string_key(&shared, key, buffer, buffer_size, default_value, error);
+}
+
+STBJDEF stbj_cursor stbj_move_cursor_key(stbj_cursor* context, const stbj_key* key)
+{
+    int error = 0;
+    stbj_cursor ret = stbj__move_cursor_key(context, key, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF stbj_index stbj_find_key(stbj_cursor* context, const stbj_key* key)
+{
+    int error = 0;
+    stbj_index ret = stbj__find_key(context, key, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF int stbj_read_int_key(stbj_cursor* context, const stbj_key* key, int default_value)
+{
+    int error = 0;
+    int ret = stbj__read_int_key(context, key, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF double stbj_read_double_key(stbj_cursor* context, const stbj_key* key, double default_value)
+{
+    int error = 0;
+    double ret = stbj__read_double_key(context, key, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF int stbj_read_string_key(stbj_cursor* context, const stbj_key* key, char* buffer, int buffer_size, const char* default_value)
+{
+    int error = 0;
+    int ret = stbj__read_string_key(context, key, buffer, buffer_size, default_value, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+///////////////////////////////////////////////
+//
+//  Columns
+//
+// Skips the element after the separator at cursor. Returns the ',' or closing bracket
+// that ends it or 0 on error
+static const char* stbj__skip_element(const stbj_cursor* context, const char* cursor, const char* end, char delimiter, int* error)
+{
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+    int in_string = 0;
+
+    stbj__stack_init(&stack, context, words);
+
+    while(++cursor < end && *cursor)
+    {
+        if(in_string)
+        {
+            if(*cursor == '\\') ++cursor;
+            else if(*cursor == '"') in_string = 0;
+            continue;
+        }
+
+        switch(*cursor)
+        {
+            case '"': in_string = 1; break;
+            case ',': if(stack.size == 0) return cursor; break;
+            case '[': case '{':
+                if(!stbj__stack_push(&stack, *cursor)) { *error = 10; return 0; }
+            break;
+            case ']': case '}':
+                if(stack.size == 0) { if(delimiter == *cursor) return cursor; *error = 3; return 0; }
+                if(!stbj__stack_pop(&stack, *cursor)) { *error = (*cursor == ']') ? 4 : 5; return 0; }
+            break;
+        }
+    }
+
+    *error = 3;
+    return 0;
+}
+
+// stbj__skip_element through the structural index of context when it has one
+static const char* stbj__next_element(const stbj_cursor* context, const char* cursor, const char* end, char delimiter, int* error)
+{
+    if(stbj__index_usable(context, cursor))
+    {
+        const stbj_struct_index* index = context->struct_index;
+        unsigned long long close = stbj__index_close(index, stbj__index_element(index, (stbj_size)(cursor - index->buffer)));
+        if(close != ~0ull)
+        {
+            const char* next = index->buffer + stbj__index_select(index, (stbj_size)(close / 2));
+            if(next < end && (*next == ',' || *next == delimiter))
+                return next;
+        }
+    }
+
+    // no index or a wrong delimiter, let the scan find the error
+    return stbj__skip_element(context, cursor, end, delimiter, error);
+}
+
+// Reads the value at _at_ into row _row_ of column. Returns 0 if it did not fit
+static int stbj__read_column(const stbj_cursor* object, const char* at, stbj_column* column, int row)
+{
+    int error = 0;
+
+    if(column->type == STBJ_COLUMN_STRING)
+    {
+        int* offsets = (int*)column->values;
+        stbj_size max_len = object->len - (stbj_size)(at - object->buffer);
+        int quoted = stbj__skip_to_value(&at, &max_len, 0);
+        if(!quoted && STBJ__HAS_BYTES(max_len) && *at == 'n')
+            return 1; // null
+
+        // one spare byte tells a full buffer from a string that fits exactly
+        int buffer_index = 0;
+        int state = stbj__run_value(object, &at, max_len, (quoted) ? STBJ__S_STRING : STBJ__S_BEFORE_STR, quoted,
+                                    column->bytes + offsets[row], column->bytes_size - offsets[row], &buffer_index);
+
+        if(state == STBJ__S_ERROR)
+            return 1;
+        if(buffer_index >= column->bytes_size - offsets[row] - 1)
+            return 0;
+
+        offsets[row + 1] = offsets[row] + buffer_index;
+    }
+    else
+    {
+        stbj__number number;
+        const char* value = stbj__scan_number(object, &at, &number, &error);
+        if(!value || number.literal == 'n')
+            return 1;
+
+        if(column->type == STBJ_COLUMN_DOUBLE)
+            ((double*)column->values)[row] = stbj__number_to_double(&number);
+        else if(!stbj__number_to_integer(&number, -9223372036854775807ll - 1, 9223372036854775807ll,
+                                         &((long long*)column->values)[row]))
+            return 1; // out of range, the row stays invalid
+    }
+
+    column->validity[row >> 3] |= (unsigned char)(1 << (row & 7));
+    return 1;
+}
+
+// Walks the members of the object at _at_ once. Returns the closing '}' or 0 on error
+static const char* stbj__read_columns_row(const stbj_cursor* object, const char* at, stbj_column* columns, int num_columns, 
+                                          int row, int* error)
+{
+    const char* end = object->buffer + object->len;
+    const char* separator = at;
+    int guess = 0;
+
+    for(;;)
+    {
+        const char* next = stbj__next_element(object, separator, end, '}', error);
+        if(!next)
+            return 0;
+
+        const char* key = stbj__skip_whitespace(separator + 1, next);
+        if(key < next && *key == '"')
+        {
+            const char* key_end = ++key;
+            while(key_end < next && *key_end != '"')
+                key_end += (*key_end == '\\') ? 2 : 1;
+
+            // records usually have their keys in the same order as the columns
+            for(int i = 0; i < num_columns; ++i)
+            {
+                int c = (guess + i) % num_columns;
+                const char* name = columns[c].name;
+                const char* compare_cursor = key;
+
+                while(compare_cursor < key_end && *name == *compare_cursor) { ++name; ++compare_cursor; }
+                if(*name || compare_cursor != key_end)
+                    continue;
+
+                guess = c + 1;
+                if(columns[c].validity[row >> 3] & (1 << (row & 7)))
+                    break; // repeated name, the first one wins
+
+                const char* value = stbj__skip_whitespace(key_end + 1, next);
+                if(value < next && *value == ':' && !stbj__read_column(object, value + 1, &columns[c], row))
+                    *error = 9;
+                break;
+            }
+        }
+
+        if(*next != ',')
+            return next;
+        separator = next;
+    }
+}
+
+static int stbj__extract_columns(const stbj_cursor* context, stbj_column* columns, int num_columns, int max_rows, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type == STBJ_ARRAY);
+    STBJ_ASSERT(columns);
+    STBJ_ASSERT(num_columns > 0);
+    STBJ_ASSERT(error);
+
+    *error = 0;
+
+    for(int c = 0; c < num_columns; ++c)
+    {
+        STBJ_ASSERT(columns[c].name);
+        STBJ_ASSERT(columns[c].values);
+        STBJ_ASSERT(columns[c].validity);
+        STBJ_ASSERT(columns[c].type != STBJ_COLUMN_STRING || columns[c].bytes);
+
+        columns[c].null_count = 0;
+        if(columns[c].type == STBJ_COLUMN_STRING)
+            ((int*)columns[c].values)[0] = 0;
+    }
+
+    stbj_cursor object = *context;
+    object.type = STBJ_OBJECT;
+
+    const char* end = context->buffer + context->len;
+    const char* separator = context->cursor;
+    int rows = 0;
+
+    while(rows < max_rows)
+    {
+        const char* element = stbj__skip_whitespace(separator + 1, end);
+        const char* next;
+
+        // [] has no rows
+        if(rows == 0 && element < end && *element == ']')
+            break;
+
+        for(int c = 0; c < num_columns; ++c)
+        {
+            if((rows & 7) == 0)
+                columns[c].validity[rows >> 3] = 0;   // bits past the last row stay 0
+            if(columns[c].type == STBJ_COLUMN_STRING)
+                ((int*)columns[c].values)[rows + 1] = ((int*)columns[c].values)[rows];
+            else if(columns[c].type == STBJ_COLUMN_DOUBLE)
+                ((double*)columns[c].values)[rows] = 0.0;
+            else
+                ((long long*)columns[c].values)[rows] = 0;
+        }
+
+        if(element < end && *element == '{')
+        {
+            // the element ends at its '}', the separator is right after it
+            next = stbj__read_columns_row(&object, element, columns, num_columns, rows, error);
+            if(next)
+                next = stbj__skip_whitespace(next + 1, end);
+            if(next && (next >= end || (*next != ',' && *next != ']')))
+                { *error = 3; next = 0; }
+        }
+        else
+            next = stbj__next_element(context, separator, end, ']', error);
+
+        if(!next)
+            return -1;
+
+        for(int c = 0; c < num_columns; ++c)
+            columns[c].null_count += !(columns[c].validity[rows >> 3] & (1 << (rows & 7)));
+
+        ++rows;
+        if(*next != ',')
+            break;
+        separator = next;
+    }
+
+    return rows;
+}
+
+STBJDEF int stbj_extract_columns_r(const stbj_cursor* context, stbj_column* columns, int num_columns, int max_rows, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__extract_columns(&shared, columns, num_columns, max_rows, error);
+}
+
+STBJDEF int stbj_extract_columns(stbj_cursor* context, stbj_column* columns, int num_columns, int max_rows)
+{
+    int error = 0;
+    int ret = stbj__extract_columns(context, columns, num_columns, max_rows, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+///////////////////////////////////////////////
+//
+//  Iteration
+//
+
+STBJDEF void stbj_iterator_init(const stbj_cursor* context, stbj_iterator* it)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(it);
+
+    it->element = *context;
+    it->name = 0;
+    it->name_len = 0;
+    it->index = -1;
+    it->next = context->cursor;
+}
+
+static int stbj__iterate(const stbj_cursor* context, stbj_iterator* it, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(it);
+    STBJ_ASSERT(error);
+
+    *error = 0;
+    if(it->index >= 0 && *it->next != ',')
+        return 0;
+
+    const char* separator = it->next;
+    const char* end = context->buffer + context->len;
+    char delimiter = (context->type == STBJ_ARRAY) ? ']' : '}';
+    const char* next = stbj__next_element(context, separator, end, delimiter, error);
+    if(!next)
+        return 0;
+
+    it->next = next;
+    if(it->index < 0 && *next == delimiter && stbj__skip_whitespace(separator + 1, next) == next)
+        return 0; // [] or {}
+
+    ++it->index;
+
+    // read at index 0 from the separator, without the cache or index of the parent
+    it->element = *context;
+    it->element.cursor = separator;
+    it->element.error = 0;
+    it->element.cache = 0;
+    it->element.struct_index = 0;
+
+    it->name = 0;
+    it->name_len = 0;
+    if(context->type == STBJ_OBJECT)
+    {
+        const char* key = stbj__skip_whitespace(separator + 1, next);
+        if(key < next && *key == '"')
+        {
+            const char* key_end = ++key;
+            while(key_end < next && *key_end != '"')
+                key_end += (*key_end == '\\') ? 2 : 1;
+
+            it->name = key;
+            it->name_len = (stbj_size)(key_end - key);
+        }
+    }
+
+    return 1;
+}
+
+STBJDEF int stbj_iterate_r(const stbj_cursor* context, stbj_iterator* it, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__iterate(&shared, it, error);
+}
+
+STBJDEF int stbj_iterate(stbj_cursor* context, stbj_iterator* it)
+{
+    int error = 0;
+    int ret = stbj__iterate(context, it, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+///////////////////////////////////////////////
+//
+//  Field index
+//
+#define STBJ__FIELD_SIZE 256
+
+// Reads the value of index->name in the object at offset. Returns 0 if it has none
+static int stbj__read_field(const stbj_field_index* index, stbj_size offset, char* value, stbj_cursor* object)
+{
+    int error = 0;
+
+    *object = index->context;
+    object->type = STBJ_OBJECT;
+    object->cursor = index->context.buffer + offset;
+    object->error = 0;
+
+    stbj_index pos = stbj__find_name(object, index->name, &error);
+    if(pos < 0)
+        return 0;
+
+    int len = stbj__read_string_index(object, pos, value, STBJ__FIELD_SIZE, 0, &error);
+
+    // unquoted values keep the whitespace before the next ',' or '}'
+    while(len > 0 && stbj__char_class[(unsigned char)value[len - 1]] == STBJ__C_WS)
+        value[--len] = 0;
+
+    return (error == 0);
+}
+
+static int stbj__build_field_index(const stbj_cursor* context, const char* name, stbj_field_index* index, stbj_field_slot* slots, unsigned int num_slots, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type == STBJ_ARRAY);
+    STBJ_ASSERT(name);
+    STBJ_ASSERT(index);
+    STBJ_ASSERT(slots);
+    STBJ_ASSERT(num_slots > 0 && (num_slots & (num_slots - 1)) == 0);
+    STBJ_ASSERT(error);
+
+    *error = 0;
+    index->context = *context;
+    index->context.cache = 0; // lookups may run on many threads
+    index->context.depth_stack = 0;
+    index->name = name;
+    index->slots = slots;
+    index->num_slots = num_slots;
+
+    for(unsigned int i = 0; i < num_slots; ++i)
+        slots[i].offset = 0;
+
+    const char* end = context->buffer + context->len;
+    const char* separator = context->cursor;
+    unsigned int used = 0;
+    char value[STBJ__FIELD_SIZE];
+    stbj_cursor object;
+
+    for(;;)
+    {
+        const char* next = stbj__next_element(context, separator, end, ']', error);
+        if(!next)
+            return -1;
+
+        const char* element = stbj__skip_whitespace(separator + 1, next);
+        stbj_size offset = (stbj_size)(element - context->buffer);
+
+        if(element < next && *element == '{' && stbj__read_field(index, offset, value, &object))
+        {
+            if(used >= num_slots - num_slots / 4)
+            {
+                *error = 9;
+                return -1;
+            }
+
+            unsigned int hash = stbj__hash_name(value);
+            unsigned int slot = hash & (num_slots - 1);
+            while(slots[slot].offset)
+                slot = (slot + 1) & (num_slots - 1);
+
+            slots[slot].hash = hash;
+            slots[slot].offset = offset + 1;
+            ++used;
+        }
+
+        if(*next != ',')
+            return (int)used;
+        separator = next;
+    }
+}
+
+STBJDEF int stbj_build_field_index_r(const stbj_cursor* context, const char* name, stbj_field_index* index, stbj_field_slot* slots, unsigned int num_slots, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__build_field_index(&shared, name, index, slots, num_slots, error);
+}
+
+STBJDEF int stbj_build_field_index(stbj_cursor* context, const char* name, stbj_field_index* index, stbj_field_slot* slots, unsigned int num_slots)
+{
+    int error = 0;
+    int ret = stbj__build_field_index(context, name, index, slots, num_slots, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF stbj_cursor stbj_lookup_field(const stbj_field_index* index, const char* value)
+{
+    STBJ_ASSERT(index);
+    STBJ_ASSERT(index->slots);
+    STBJ_ASSERT(value);
+
+    unsigned int hash = stbj__hash_name(value);
+    unsigned int slot = hash & (index->num_slots - 1);
+    char found[STBJ__FIELD_SIZE];
+    stbj_cursor object;
+
+    // equal hashes are checked against the buffer
+    for(; index->slots[slot].offset; slot = (slot + 1) & (index->num_slots - 1))
+    {
+        if(index->slots[slot].hash != hash)
+            continue;
+
+        if(stbj__read_field(index, index->slots[slot].offset - 1, found, &object))
+        {
+            const char* compare_cursor = value;
+            const char* found_cursor = found;
+            while(*compare_cursor && *compare_cursor == *found_cursor) { ++compare_cursor; ++found_cursor; }
+            if(*compare_cursor == *found_cursor)
+                return object;
+        }
+    }
+
+    object = index->context;
+    object.type = STBJ_ERROR;
+    object.cursor = 0;
+    object.error = 2;
+    return object;
+}
+
+STBJDEF stbj_cursor stbj_lookup_field_int(const stbj_field_index* index, long long value)
+{
+    char text[24];
+    char* cursor = text + sizeof(text);
+    unsigned long long magnitude = (value < 0) ? 0ull - (unsigned long long)value : (unsigned long long)value;
+
+    *--cursor = 0;
+    do { *--cursor = (char)('0' + magnitude % 10); magnitude /= 10; } while(magnitude);
+    if(value < 0)
+        *--cursor = '-';
+
+    return stbj_lookup_field(index, cursor);
+}
+
+///////////////////////////////////////////////
+//
+//  Key search
+//
+
+// Any '"', '[', ']', '{' or '}' in the word. Setting bit 5 turns '[' into '{' and ']' into '}'
+#define STBJ__HAS_STRUCTURAL(w) \
+    (STBJ__HAS_BYTE(w, '"') | STBJ__HAS_BYTE((w) | (STBJ__ONES * 0x20), '{') | STBJ__HAS_BYTE((w) | (STBJ__ONES * 0x20), '}'))
+
+static stbj_index stbj__find_all_key(const stbj_cursor* context, const char* key, stbj_key_fn fn, void* user_data, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(key);
+    STBJ_ASSERT(fn);
+    STBJ_ASSERT(error);
+
+    *error = 0;
+    int key_len = 0;
+    while(key[key_len]) ++key_len;
+
+    const char* end = context->buffer + context->len;
+    const char* cursor = context->cursor;
+    unsigned long long words[STBJ__DEPTH_WORDS];
+    stbj__bit_stack stack;
+    stbj_index hits = 0;
+
+    stbj__stack_init(&stack, context, words);
+    stbj__stack_push(&stack, *cursor);
+
+    while(++cursor < end && *cursor)
+    {
+        while(end - cursor >= 8 && !STBJ__HAS_STRUCTURAL(stbj__load64(cursor)))
+            cursor += 8;
+
+        while(cursor < end && *cursor && *cursor != '"' && *cursor != '[' && *cursor != ']' && *cursor != '{' && *cursor != '}')
+            ++cursor;
+
+        if(cursor >= end || *cursor == 0)
+            break;
+
+        switch(*cursor)
+        {
+            case '[': case '{':
+                if(!stbj__stack_push(&stack, *cursor)) { *error = 10; return -1; }
+            break;
+            case ']': case '}':
+                if(!stbj__stack_pop(&stack, *cursor)) { *error = (*cursor == ']') ? 4 : 5; return -1; }
+                if(stack.size == 0) return hits;
+            break;
+            case '"':
+            {
+                // string contents only stop at '"' and '\\'
+                const char* start = ++cursor;
+                for(;;)
+                {
+                    while(end - cursor >= 8 && !(STBJ__HAS_BYTE(stbj__load64(cursor), '"') | STBJ__HAS_BYTE(stbj__load64(cursor), '\\')))
+                        cursor += 8;
+                    while(cursor < end && *cursor && *cursor != '"' && *cursor != '\\')
+                        ++cursor;
+                    if(cursor >= end || *cursor != '\\')
+                        break;
+                    cursor += 2;
+                }
+
+                if(cursor >= end || *cursor == 0)
+                    { *error = 3; return -1; }
+
+                if(stbj__stack_top(&stack) != '{' || cursor - start != key_len)
+                    break;
+
+                int i = 0;
+                while(i < key_len && start[i] == key[i]) ++i;
+                if(i < key_len)
+                    break;
+
+                // a key is followed by ':' and follows the '{' or a ','
+                const char* colon = stbj__skip_whitespace(cursor + 1, end);
+                const char* separator = start - 2;
+                while(separator > context->buffer && stbj__char_class[(unsigned char)*separator] == STBJ__C_WS)
+                    --separator;
+
+                if(colon >= end || *colon != ':' || (*separator != '{' && *separator != ','))
+                    break;
+
+                stbj_cursor member = *context;
+                member.type = STBJ_OBJECT;
+                member.cursor = separator;
+                member.error = 0;
+
+                ++hits;
+                if(fn(&member, (int)stack.size - 1, user_data))
+                    return hits;
+            } break;
+        }
+    }
+
+    *error = 3;
+    return -1;
+}
+
+STBJDEF stbj_index stbj_find_all_key_r(const stbj_cursor* context, const char* key, stbj_key_fn fn, void* user_data, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__find_all_key(&shared, key, fn, user_data, error);
+}
+
+STBJDEF stbj_index stbj_find_all_key(stbj_cursor* context, const char* key, stbj_key_fn fn, void* user_data)
+{
+    int error = 0;
+    stbj_index ret = stbj__find_all_key(context, key, fn, user_data, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+///////////////////////////////////////////////
+//
+//  Minify
+//
+
+// Any byte <= ' ', covers the 4 whitespace chars
+#define STBJ__HAS_SPACE(w) (((w) - STBJ__ONES * 0x21) & ~(w) & STBJ__HIGHS)
+
+// compilers merge it into a single 8 byte store
+static void stbj__store64(char* p, unsigned long long w)
+{
+    p[0] = (char)w;         p[1] = (char)(w >> 8);
+    p[2] = (char)(w >> 16); p[3] = (char)(w >> 24);
+    p[4] = (char)(w >> 32); p[5] = (char)(w >> 40);
+    p[6] = (char)(w >> 48); p[7] = (char)(w >> 56);
+}
+
+STBJDEF stbj_size stbj_minify(const char* in, stbj_size len, char* out)
+{
+    STBJ_ASSERT(in);
+    STBJ_ASSERT(out);
+
+    const char* cursor = in;
+    const char* end = in + len;
+    char* dest = out;
+
+    // dest never goes ahead of cursor, so in place works: every word is read before it is written
+    while(cursor < end)
+    {
+        // outside strings: words with no whitespace are copied as they are, the others are
+        // compressed without branches, writing every byte but only moving over the ones we keep
+        while(end - cursor >= 8)
+        {
+            unsigned long long w = stbj__load64(cursor);
+            if(STBJ__HAS_BYTE(w, '"'))
+                break;
+
+            if(!STBJ__HAS_SPACE(w))
+            {
+                stbj__store64(dest, w);
+                dest += 8;
+            }
+            else if(w != STBJ__ONES * ' ') // only spaces is indentation, nothing to keep
+            {
+                for(int i = 0; i < 8; ++i)
+                {
+                    char c = (char)(w >> (i * 8));
+                    *dest = c;
+                    dest += (c != ' ') & (c != '\n') & (c != '\r') & (c != '\t');
+                }
+            }
+            cursor += 8;
+        }
+
+        while(cursor < end && *cursor != '"')
+        {
+            char c = *cursor++;
+            if(c != ' ' && c != '\n' && c != '\r' && c != '\t')
+                *dest++ = c;
+        }
+
+        if(cursor >= end || *cursor != '"')
+            continue;
+
+        // strings are copied up to the closing '"'
+        *dest++ = *cursor++;
+        while(cursor < end)
+        {
+            while(end - cursor >= 8)
+            {
+                unsigned long long w = stbj__load64(cursor);
+                if(STBJ__HAS_BYTE(w, '"') | STBJ__HAS_BYTE(w, '\\'))
+                    break;
+                stbj__store64(dest, w);
+                dest += 8;
+                cursor += 8;
+            }
+
+            if(cursor >= end)
+                break;
+
+            char c = *cursor++;
+            *dest++ = c;
+            if(c == '"')
+                break;
+            if(c == '\\' && cursor < end)
+                *dest++ = *cursor++;
+        }
+    }
+
+    return (stbj_size)(dest - out);
+}
+
+STBJDEF stbj_size stbj_minify_in_place(char* buffer, stbj_size len)
+{
+    return stbj_minify(buffer, len, buffer);
+}
+
+///////////////////////////////////////////////
+//
+//  Projection
+//
+#define STBJ__PROJECT_DEPTH 32
+
+typedef struct
+{
+    const stbj_cursor* context;
+    const char* end;
+    const char** paths;
+    int num_paths;
+    stbj_slice* slices;
+    int max_slices;
+    int num_slices;
+    const char* keys[STBJ__PROJECT_DEPTH];  // names from the root to the current object
+    int key_lens[STBJ__PROJECT_DEPTH];
+    int* error;
+} stbj__projection;
+
+static int stbj__emit(stbj__projection* p, const char* base, size_t len)
+{
+    if(p->num_slices >= p->max_slices)
+    {
+        *p->error = 9;
+        return 0;
+    }
+
+    p->slices[p->num_slices].base = base;
+    p->slices[p->num_slices].len = len;
+    ++p->num_slices;
+    return 1;
+}
+
+// Compares the name at the start of *path with name, a '\\' before a '.' keeps it in the
+// name. On a match *path moves to the '.' or the 0 after the name
+static int stbj__path_name_equals(const char** path, const char* name, int len)
+{
+    const char* at = *path;
+    for(int j = 0; j < len; ++j)
+    {
+        if(at[0] == '\\' && at[1] == '.') ++at;
+        else if(*at == '.' || *at == 0) return 0;
+        if(*at++ != name[j]) return 0;
+    }
+
+    if(*at != '.' && *at != 0)
+        return 0;
+    *path = at;
+    return 1;
+}
+
+// Number of names in path
+static int stbj__path_depth(const char* path)
+{
+    int depth = 1;
+    for(; *path; ++path)
+    {
+        if(path[0] == '\\' && path[1] == '.') ++path;
+        else if(*path == '.') ++depth;
+    }
+    return depth;
+}
+
+// 0 if no path selects _key_, 1 if one selects it all, 2 if some path goes inside it
+static int stbj__project_match(const stbj__projection* p, int depth, const char* key, int key_len)
+{
+    int match = 0;
+
+    for(int i = 0; i < p->num_paths; ++i)
+    {
+        const char* path = p->paths[i];
+        int level = 0;
+
+        for(; level <= depth; ++level)
+        {
+            const char* name = (level < depth) ? p->keys[level] : key;
+            int len = (level < depth) ? p->key_lens[level] : key_len;
+
+            if(!stbj__path_name_equals(&path, name, len))
+                break;
+            if(level < depth && *path++ != '.')
+                break;
+        }
+
+        if(level <= depth)
+            continue;
+
+        if(*path == 0)
+            return 1;
+        match = 2;
+    }
+
+    return match;
+}
+
+// Walks the members of the object at _object_. Returns its closing '}' or 0 on error
+static const char* stbj__project_object(stbj__projection* p, const char* object, int depth)
+{
+    const char* separator = object;
+    int emitted = 0;
+
+    for(;;)
+    {
+        const char* key = stbj__skip_whitespace(separator + 1, p->end);
+        if(key < p->end && *key == '}' && separator == object)
+            return key;
+
+        if(key >= p->end || *key != '"')
+            { *p->error = 3; return 0; }
+
+        const char* key_end = key + 1;
+        while(key_end < p->end && *key_end != '"')
+            key_end += (*key_end == '\\') ? 2 : 1;
+
+        const char* value = stbj__skip_whitespace(key_end + 1, p->end);
+        if(value >= p->end || *value != ':')
+            { *p->error = 3; return 0; }
+        value = stbj__skip_whitespace(value + 1, p->end);
+
+        int key_len = (int)(key_end - key - 1);
+        int match = (depth < STBJ__PROJECT_DEPTH) ? stbj__project_match(p, depth, key + 1, key_len) : 0;
+        const char* next;
+
+        if(match == 2 && value < p->end && *value == '{')
+        {
+            // "name": { goes out now and is taken back if nothing inside is selected
+            int saved = p->num_slices;
+            if((emitted && !stbj__emit(p, ",", 1)) || !stbj__emit(p, key, (size_t)(value + 1 - key)))
+                return 0;
+
+            int before = p->num_slices;
+            p->keys[depth] = key + 1;
+            p->key_lens[depth] = key_len;
+
+            const char* close = stbj__project_object(p, value, depth + 1);
+            if(!close)
+                return 0;
+
+            if(p->num_slices == before)
+                p->num_slices = saved;
+            else if(!stbj__emit(p, "}", 1))
+                return 0;
+            else
+                emitted = 1;
+
+            next = stbj__skip_whitespace(close + 1, p->end);
+            if(next >= p->end || (*next != ',' && *next != '}'))
+                { *p->error = 3; return 0; }
+        }
+        else
+        {
+            next = stbj__skip_element(p->context, separator, p->end, '}', p->error);
+            if(!next)
+                return 0;
+
+            if(match == 1)
+            {
+                const char* value_end = next;
+                while(value_end > value && stbj__char_class[(unsigned char)value_end[-1]] == STBJ__C_WS)
+                    --value_end;
+
+                if((emitted && !stbj__emit(p, ",", 1)) || !stbj__emit(p, key, (size_t)(value_end - key)))
+                    return 0;
+                emitted = 1;
+            }
+        }
+
+        if(*next == '}')
+            return next;
+        separator = next;
+    }
+}
+
+static int stbj__project(const stbj_cursor* context, const char** paths, int num_paths, stbj_slice* slices, int max_slices, int* error)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(paths || num_paths == 0);
+    STBJ_ASSERT(slices);
+    STBJ_ASSERT(error);
+
+    *error = 6;
+    if(context->type != STBJ_OBJECT)
+        return -1;
+
+    // deeper paths could never match, better to say so than to leave them out
+    *error = 10;
+    for(int i = 0; i < num_paths; ++i)
+        if(stbj__path_depth(paths[i]) > STBJ__PROJECT_DEPTH)
+            return -1;
+
+    *error = 0;
+
+    stbj__projection p;
+    p.context = context;
+    p.end = context->buffer + context->len;
+    p.paths = paths;
+    p.num_paths = num_paths;
+    p.slices = slices;
+    p.max_slices = max_slices;
+    p.num_slices = 0;
+    p.error = error;
+
+    if(!stbj__emit(&p, "{", 1) || !stbj__project_object(&p, context->cursor, 0) || !stbj__emit(&p, "}", 1))
+        return -1;
+
+    return p.num_slices;
+}
+
+STBJDEF int stbj_project_r(const stbj_cursor* context, const char** paths, int num_paths, stbj_slice* slices, int max_slices, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__project(&shared, paths, num_paths, slices, max_slices, error);
+}
+
+STBJDEF int stbj_project(stbj_cursor* context, const char** paths, int num_paths, stbj_slice* slices, int max_slices)
+{
+    int error = 0;
+    int ret = stbj__project(context, paths, num_paths, slices, max_slices, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+///////////////////////////////////////////////
+//
+//  Edits
+//
+#define STBJ__EDIT_DEPTH 256
+
+typedef struct
+{
+    int depth;
+    int min_depth;
+    int in_string;
+    int escaped;
+} stbj__edit_state;
+
+// Follows brackets and strings from _cursor_ to _end_, pushing the offsets of the open
+// containers if stack is not 0. Stops at the bracket that closes depth 1 and returns it,
+// or returns 0 if the stack is full
+static const char* stbj__edit_scan(stbj__edit_state* state, const char* cursor, const char* end,
+                                   stbj_size* stack, const char* buffer)
+{
+    for(; cursor < end; ++cursor)
+    {
+        if(state->in_string)
+        {
+            if(state->escaped) state->escaped = 0;
+            else if(*cursor == '\\') state->escaped = 1;
+            else if(*cursor == '"') state->in_string = 0;
+            continue;
+        }
+
+        switch(*cursor)
+        {
+            case '"': state->in_string = 1; break;
+            case '[': case '{':
+                if(stack)
+                {
+                    if(state->depth >= STBJ__EDIT_DEPTH) return 0;
+                    stack[state->depth] = (stbj_size)(cursor - buffer);
+                }
+                ++state->depth;
+                break;
+            case ']': case '}':
+                if(--state->depth < state->min_depth) state->min_depth = state->depth;
+                if(state->depth == 0) return cursor;
+                break;
+        }
+    }
+
+    return end;
+}
+
+STBJDEF int stbj_apply_edit(stbj_cursor* context, stbj_size offset, const char* old_bytes, stbj_size old_len,
+                            stbj_size new_len, stbj_cursor* container)
+{
+    STBJ_ASSERT(context);
+    STBJ_ASSERT(context->cursor);
+    STBJ_ASSERT(context->type != STBJ_ERROR);
+    STBJ_ASSERT(old_bytes || old_len == 0);
+    STBJ_ASSERT(offset > (stbj_size)(context->cursor - context->buffer));
+    STBJ_ASSERT(offset + old_len <= context->len);
+
+    const char* buffer = context->buffer;
+    stbj_size root = (stbj_size)(context->cursor - buffer);
+    stbj_size old_end = offset + old_len;
+    stbj_size limit = offset;
+    stbj_size stack[STBJ__EDIT_DEPTH];
+    int changed = 1;
+    int outer = 0;
+    int inner = 0;
+
+    context->len = context->len - old_len + new_len;
+    context->error = 0;
+    context->struct_index = 0;
+
+    // try the nearest container before the edit first, then the ones before it
+    for(;;)
+    {
+        stbj_size start = root;
+        if(context->cache)
+            for(unsigned int i = 0; i < context->cache->num_entries; ++i)
+            {
+                const stbj_cache_entry* entry = &context->cache->entries[i];
+                if(entry->found && !(entry->flags & STBJ__CACHE_SHAPE) && entry->parent > start && entry->parent < limit &&
+                   (buffer[entry->parent] == '{' || buffer[entry->parent] == '['))
+                    start = entry->parent;
+            }
+
+        stbj__edit_state state = { 1, 1, 0, 0 };
+        stack[0] = start;
+
+        const char* stop = stbj__edit_scan(&state, buffer + start + 1, buffer + offset, stack, buffer);
+        if(!stop)
+            break;
+
+        if(stop == buffer + offset)
+        {
+            // the old and the new bytes must leave the scanner in the same state
+            stbj__edit_state old_state = state;
+            stbj__edit_state new_state = state;
+            stbj__edit_scan(&old_state, old_bytes, old_bytes + old_len, 0, 0);
+            stbj__edit_scan(&new_state, buffer + offset, buffer + offset + new_len, 0, 0);
+
+            if(old_state.depth != new_state.depth || old_state.in_string != new_state.in_string ||
+               old_state.escaped != new_state.escaped)
+                break;
+
+            int min_depth = (old_state.min_depth < new_state.min_depth) ? old_state.min_depth : new_state.min_depth;
+            if(min_depth > 0)
+            {
+                changed = 0;
+                outer = min_depth - 1;
+                inner = state.depth;
+                break;
+            }
+        }
+
+        if(start == root)
+            break;
+        limit = start;
+    }
+
+    if(changed)
+    {
+        if(context->cache)
+            stbj_cache_clear(context->cache);
+
+        if(container)
+            *container = *context;
+
+        return 1;
+    }
+
+    if(context->cache)
+    {
+        for(unsigned int i = 0; i < context->cache->num_entries; ++i)
+        {
+            stbj_cache_entry* entry = &context->cache->entries[i];
+            if(!entry->found || (entry->flags & STBJ__CACHE_SHAPE))
+                continue;
+
+            // containers open at the edit may have new members after it
+            int open = 0;
+            for(int d = outer; d < inner && !open; ++d)
+                open = (entry->parent == stack[d]);
+
+            stbj_size found = entry->found - 1;
+            if((entry->parent >= offset && entry->parent < old_end) || (found >= offset && found < old_end) ||
+               (open && found >= offset))
+            {
+                entry->found = 0;
+                continue;
+            }
+
+            if(entry->parent >= old_end) entry->parent = entry->parent - old_len + new_len;
+            if(found >= old_end) entry->found = entry->found - old_len + new_len;
+        }
+    }
+
+    if(container)
+    {
+        *container = *context;
+        container->cursor = buffer + stack[outer];
+        container->type = (*container->cursor == '{') ? STBJ_OBJECT : STBJ_ARRAY;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////
+//
+//  Document store
+//
+static unsigned int stbj__hash_bytes(const char* bytes, stbj_size len)
+{
+    unsigned int hash = 2166136261u;
+    for(stbj_size i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char)bytes[i]) * 16777619u;
+    return hash;
+}
+
+// Slot of the key or the empty slot where it goes
+static stbj_dict_slot* stbj__dict_slot(const stbj_dict* dict, const char* name, stbj_size len, unsigned int hash)
+{
+    unsigned int slot = hash & (dict->num_slots - 1);
+    for(; dict->slots[slot].key; slot = (slot + 1) & (dict->num_slots - 1))
+    {
+        if(dict->slots[slot].hash != hash)
+            continue;
+
+        int id = dict->slots[slot].key - 1;
+        const char* bytes = dict->bytes + dict->names[id];
+        if(dict->names[id + 1] - dict->names[id] != len)
+            continue;
+
+        stbj_size i = 0;
+        while(i < len && bytes[i] == name[i]) ++i;
+        if(i == len)
+            break;
+    }
+
+    return &dict->slots[slot];
+}
+
+STBJDEF int stbj_dict_init(stbj_dict* dict, void* memory, stbj_size memory_size, unsigned int num_slots)
+{
+    STBJ_ASSERT(dict);
+    STBJ_ASSERT(memory);
+    STBJ_ASSERT(num_slots >= 4 && (num_slots & (num_slots - 1)) == 0);
+
+    stbj_size names_at = num_slots * (stbj_size)sizeof(stbj_dict_slot);
+    stbj_size bytes_at = names_at + (stbj_size)(((num_slots / 4 * 3 + 1) * sizeof(stbj_size) + 7) / 8 * 8);
+    if(memory_size < bytes_at)
+        return 0;
+
+    dict->slots = (stbj_dict_slot*)memory;
+    dict->num_slots = num_slots;
+    dict->names = (stbj_size*)((char*)memory + names_at);
+    dict->bytes = (char*)memory + bytes_at;
+    dict->bytes_size = memory_size - bytes_at;
+    dict->num_keys = 0;
+    dict->names[0] = 0;
+
+    for(unsigned int i = 0; i < num_slots; ++i)
+        dict->slots[i].key = 0;
+
+    return 1;
+}
+
+STBJDEF int stbj_dict_intern(stbj_dict* dict, const char* name, stbj_size len)
+{
+    STBJ_ASSERT(dict);
+    STBJ_ASSERT(name);
+
+    unsigned int hash = stbj__hash_bytes(name, len);
+    stbj_dict_slot* slot = stbj__dict_slot(dict, name, len, hash);
+    if(slot->key)
+        return slot->key - 1;
+
+    stbj_size at = dict->names[dict->num_keys];
+    if((unsigned int)dict->num_keys >= dict->num_slots / 4 * 3 || dict->bytes_size - at < len)
+        return -1;
+
+    for(stbj_size i = 0; i < len; ++i)
+        dict->bytes[at + i] = name[i];
+
+    dict->names[dict->num_keys + 1] = at + len;
+    slot->hash = hash;
+    slot->key = ++dict->num_keys;
+    return slot->key - 1;
+}
+
+STBJDEF int stbj_key_id(const stbj_dict* dict, const char* name)
+{
+    STBJ_ASSERT(dict);
+    STBJ_ASSERT(name);
+
+    stbj_size len = 0;
+    while(name[len]) ++len;
+
+    return stbj__dict_slot(dict, name, len, stbj__hash_bytes(name, len))->key - 1;
+}
+
+STBJDEF const char* stbj_dict_name(const stbj_dict* dict, int key, stbj_size* len)
+{
+    STBJ_ASSERT(dict);
+    STBJ_ASSERT(key >= 0 && key < dict->num_keys);
+
+    if(len) *len = dict->names[key + 1] - dict->names[key];
+    return dict->bytes + dict->names[key];
+}
+
+STBJDEF void stbj_store_init(stbj_store* store, stbj_dict* dict, stbj_store_doc* docs, int max_docs,
+                             stbj_store_entry* members, stbj_size max_members)
+{
+    STBJ_ASSERT(store);
+    STBJ_ASSERT(dict);
+    STBJ_ASSERT(docs);
+    STBJ_ASSERT(members);
+
+    store->dict = dict;
+    store->docs = docs;
+    store->max_docs = max_docs;
+    store->num_docs = 0;
+    store->members = members;
+    store->max_members = max_members;
+    store->num_members = 0;
+}
+
+// Appends the members of the object at context. Returns 0 on error
+static int stbj__store_members(stbj_store* store, const stbj_cursor* context, int* error)
+{
+    const char* end = context->buffer + context->len;
+    const char* separator = context->cursor;
+
+    // {} has no members
+    const char* key = stbj__skip_whitespace(separator + 1, end);
+    if(key < end && *key == '}')
+        return 1;
+
+    for(;;)
+    {
+        key = stbj__skip_whitespace(separator + 1, end);
+        if(key >= end || *key != '"')
+            { *error = 3; return 0; }
+
+        const char* key_end = key + 1;
+        while(key_end < end && *key_end != '"')
+            key_end += (*key_end == '\\') ? 2 : 1;
+        if(key_end >= end)
+            { *error = 8; return 0; }
+
+        const char* next = stbj__next_element(context, separator, end, '}', error);
+        if(!next)
+            return 0;
+
+        int id = stbj_dict_intern(store->dict, key + 1, (stbj_size)(key_end - key - 1));
+        if(id < 0 || store->num_members == store->max_members)
+            { *error = 9; return 0; }
+
+        store->members[store->num_members].key = id;
+        store->members[store->num_members].offset = (stbj_size)(separator - context->buffer);
+        ++store->num_members;
+
+        if(*next == '}')
+            return 1;
+        separator = next;
+    }
 }
 
-// This function is for internal use only: Returns a pointer at the value after _name_
-STBJDEF int stbj_find_name(stbj_cursor* context, const char* name)
+static int stbj__store_add(stbj_store* store, const stbj_cursor* context, int* error)
 {
+    STBJ_ASSERT(store);
     STBJ_ASSERT(context);
     STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(name);
+    STBJ_ASSERT(error);
 
-    context->error = 6;
-    if(context->type == STBJ_ARRAY)
+    *error = 6;
+    if(context->type != STBJ_OBJECT)
         return -1;
 
-    context->error = 0;
-    int result = 0;
-    int between_comas = 0;
-    char stack[256];
-    int stack_index = -1;
+    *error = 9;
+    if(store->num_docs == store->max_docs)
+        return -1;
 
-    const char* cursor = context->cursor;
-    const char* compare_cursor = name;
-    unsigned int max_len = context->len - (unsigned int)(cursor - context->buffer);
+    *error = 0;
+    stbj_size first = store->num_members;
+    if(!stbj__store_members(store, context, error))
+    {
+        store->num_members = first;
+        return -1;
+    }
 
-    while(max_len-- > 0 && *++cursor && stack_index < 256) 
+    stbj_store_doc* doc = &store->docs[store->num_docs];
+    doc->buffer = context->buffer;
+    doc->len = context->len;
+    doc->object = (stbj_size)(context->cursor - context->buffer);
+    doc->first = first;
+    doc->num_members = (int)(store->num_members - first);
+    return store->num_docs++;
+}
+
+STBJDEF int stbj_store_add_r(stbj_store* store, const stbj_cursor* context, int* error)
+{
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__store_add(store, &shared, error);
+}
+
+STBJDEF int stbj_store_add(stbj_store* store, stbj_cursor* context)
+{
+    int error = 0;
+    int ret = stbj__store_add(store, context, &error);
+    context->error = (char)error;
+    return ret;
+}
+
+STBJDEF stbj_cursor stbj_store_document(const stbj_store* store, int doc)
+{
+    STBJ_ASSERT(store);
+    STBJ_ASSERT(doc >= 0 && doc < store->num_docs);
+
+    const stbj_store_doc* d = &store->docs[doc];
+    stbj_cursor object;
+    object.type = STBJ_OBJECT;
+    object.len = d->len;
+    object.buffer = d->buffer;
+    object.cursor = d->buffer + d->object;
+    object.error = 0;
+    object.cache = 0;
+    object.struct_index = 0;
+    object.depth_stack = 0;
+    return object;
+}
+
+STBJDEF stbj_cursor stbj_store_member(const stbj_store* store, int doc, int key)
+{
+    stbj_cursor member = stbj_store_document(store, doc);
+
+    const stbj_store_entry* members = store->members + store->docs[doc].first;
+    for(int i = 0; i < store->docs[doc].num_members; ++i)
     {
-        // Two different logics if we are in a nested array/object or not
-        if(stack_index < 0)
+        if(members[i].key == key)
         {
-            // we are on the same array/object level
-            switch(*cursor)
-            {
-                case '[': case '{': stack[++stack_index] = *cursor; break;
-                case ']': if(!between_comas) { context->error = 4; return -1; } break;
-                case '}': if(!between_comas) { context->error = 5; return -1; } break; 
-                case ',': result += !between_comas; break;
-                case '"': between_comas = !between_comas; break;
-                default:
-                    if(between_comas && *compare_cursor == *cursor)
-                        { if(*++compare_cursor == 0 && *(cursor+1) == '"') return result; }
-                    else
-                        compare_cursor = name;
-                    break;
-            }
-        }
-        else
-        {
-            // we are in a nested array/object, keep consuming chars and record progress in our stack
-            switch(*cursor)
-            {
-                case '[': case '{': stack[++stack_index] = *cursor; break;
-                case ']': 
-                    if(stack[stack_index] == '[') --stack_index; 
-                    else { context->error = 4; return -1; }
-                break;
-                case '}': 
-                    if(stack[stack_index] == '{') --stack_index; 
-                    else { context->error = 5; return -1; }  
-                break;
-            }
+            member.cursor = member.buffer + members[i].offset;
+            return member;
         }
     }
 
-    context->error = 2;
-    return -1;
+    member.type = STBJ_ERROR;
+    member.cursor = 0;
+    member.error = 2;
+    return member;
 }
 
+#ifdef STBJ_ENABLE_THREADS
 ///////////////////////////////////////////////
 //
-//  Core parsing functions
+//  Parallel for
 //
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE stbj__thread;
+typedef SRWLOCK stbj__mutex;
+typedef CONDITION_VARIABLE stbj__cond;
+#define STBJ__MUTEX_INIT       SRWLOCK_INIT
+#define STBJ__COND_INIT        CONDITION_VARIABLE_INIT
+#define stbj__mutex_init(m)    InitializeSRWLock(m)
+#define stbj__mutex_destroy(m) ((void)(m))
+#define stbj__mutex_lock(m)    AcquireSRWLockExclusive(m)
+#define stbj__mutex_unlock(m)  ReleaseSRWLockExclusive(m)
+#define stbj__cond_wait(c, m)  SleepConditionVariableSRW(c, m, INFINITE, 0)
+#define stbj__cond_wake(c)     WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t stbj__thread;
+typedef pthread_mutex_t stbj__mutex;
+typedef pthread_cond_t stbj__cond;
+#define STBJ__MUTEX_INIT       PTHREAD_MUTEX_INITIALIZER
+#define STBJ__COND_INIT        PTHREAD_COND_INITIALIZER
+#define stbj__mutex_init(m)    pthread_mutex_init(m, 0)
+#define stbj__mutex_destroy(m) pthread_mutex_destroy(m)
+#define stbj__mutex_lock(m)    pthread_mutex_lock(m)
+#define stbj__mutex_unlock(m)  pthread_mutex_unlock(m)
+#define stbj__cond_wait(c, m)  pthread_cond_wait(c, m)
+#define stbj__cond_wake(c)     pthread_cond_broadcast(c)
+#endif
 
-// Try parsing an integer value at index. If unable, return default_value.
-STBJDEF int stbj_read_int_index(stbj_cursor* context, int index, int default_value)
+#define STBJ__CHUNKS_PER_THREAD 8
+#define STBJ__MAX_CHUNKS (STBJ_MAX_THREADS * STBJ__CHUNKS_PER_THREAD)
+
+typedef struct
 {
-    STBJ_ASSERT(context);
-    STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(index >= 0);
+    const char* start;  // separator before the first element: '[', '{' or ','
+    stbj_index index;   // index of the first element
+} stbj__chunk;
 
-    const char* cursor = stbj_find_index(context, index);
+// Chunks owned by one thread: the owner takes from lo, thieves take from hi
+typedef struct
+{
+    stbj__mutex lock;
+    int lo;
+    int hi;
+} stbj__deque;
 
-    if(!cursor)
-        return default_value; // error num already set by get_element()
+typedef struct
+{
+    const stbj_cursor* context;
+    const char* end;
+    char delimiter;
+    stbj_element_fn fn;
+    void* user_data;
+    int num_threads;
+    int num_chunks;
+    stbj__chunk chunks[STBJ__MAX_CHUNKS + 1];
+    stbj__deque deques[STBJ_MAX_THREADS];
+} stbj__job;
+
+// Threads are started on first use and then sleep until the next job, thread i works on
+// a job when i < job->num_threads. The caller of stbj_parallel_for is always thread 0
+static struct
+{
+    stbj__mutex lock;
+    stbj__cond wake;     // a new job was posted
+    stbj__cond done;     // a thread finished its part of the job
+    int started;         // threads 1..started are running
+    int busy;            // a parallel for is running, others run on their own thread
+    unsigned generation; // bumped on every job
+    stbj__job* job;
+    int active;          // threads still working on job
+    int stopping;        // stbj_pool_shutdown is waiting for the threads to return
+    stbj__thread threads[STBJ_MAX_THREADS];
+} stbj__pool = { STBJ__MUTEX_INIT, STBJ__COND_INIT, STBJ__COND_INIT, 0, 0, 0, 0, 0, 0, { 0 } };
 
-    enum parse_states
+// Own chunks first, then steal from the back of the others
+static int stbj__take_chunk(stbj__job* job, int id)
+{
+    for(int i = 0; i < job->num_threads; ++i)
     {
-        before_value,
-        at_num_value,       // 123
-        at_special_value,   // true/false/null
-        after_value,
-        finish,
-        error
-    } state = before_value;
+        int victim = (id + i) % job->num_threads;
+        stbj__deque* deque = &job->deques[victim];
+        int chunk = -1;
 
-    context->error = 0;
-    unsigned int max_len = context->len - (unsigned int)(cursor - context->buffer);
-    int between_comas = 0;
-    int sign = 1;
-    int result = 0;
-    int have_result = 0;
-    int past_dot = 0;
-    char special[] = "rue\0ull\0alse";
-    char* c_special = &special[0];
+        stbj__mutex_lock(&deque->lock);
+        if(deque->lo < deque->hi)
+            chunk = (victim == id) ? deque->lo++ : --deque->hi;
+        stbj__mutex_unlock(&deque->lock);
+
+        if(chunk >= 0)
+            return chunk;
+    }
+
+    return -1;
+}
 
-    while(max_len-- > 0 && *cursor && state != finish) 
+static void stbj__run_worker(stbj__job* job, int id)
+{
+    int chunk;
+    int error = 0;
+
+    while((chunk = stbj__take_chunk(job, id)) >= 0)
     {
-        switch(state)
+        stbj_cursor element = *job->context;
+        element.cursor = job->chunks[chunk].start;
+        element.error = 0;
+        element.cache = 0; // caches are not thread safe
+        element.depth_stack = 0; // neither are depth stacks
+
+        for(stbj_index index = job->chunks[chunk].index; index < job->chunks[chunk + 1].index; ++index)
         {
-            case before_value:
-            {
-                // Parsing done before encountering any value of meaning -----------------
-                switch(*cursor)
-                {
-					case ' ': case '\n': case '\r': case '\t': break;
-                    case '.': --cursor; have_result = 1; state = at_num_value; break;
-                    case '"': if(between_comas++) state = finish; break;
-                    case '-': sign = -1; // fall to next option
-                    case '+': state = at_num_value; have_result = 1; break;
-                    case '0': case '1': case '2': case '3': case '4':
-                    case '5': case '6': case '7': case '8': case '9': 
-                        result = *cursor - '0'; state = at_num_value; have_result = 1; break;
-                    case 't': state = at_special_value; have_result = 1; result = 1; break;
-                    case 'f': c_special += 8; state = at_special_value; have_result = 1;  break;
-                    case 'n': c_special += 4; state = at_special_value; have_result = 1;  break;
-                    default: --cursor; state = after_value; break;
-                }
+            job->fn(&element, index, job->user_data);
+            element.cursor = stbj__next_element(&element, element.cursor, job->end, job->delimiter, &error);
+        }
+    }
+}
 
-            } break;
+static void stbj__pool_thread(int id)
+{
+    unsigned seen = 0;
 
-            case at_num_value:
-            {
-                // Parsing on a number ---------------------------------------------------
-                switch(*cursor)
-                {
-                    case '.': if(past_dot++) state = error; break;
-                    case '0': case '1': case '2': case '3': case '4':
-                    case '5': case '6': case '7': case '8': case '9':
-                        if(!past_dot) result = (10 * result) + (*cursor - '0'); break;
-                    default: --cursor; state = after_value; break;
-                }
-            } break;
+    stbj__mutex_lock(&stbj__pool.lock);
+    for(;;)
+    {
+        while(stbj__pool.generation == seen)
+            stbj__cond_wait(&stbj__pool.wake, &stbj__pool.lock);
+        seen = stbj__pool.generation;
 
-            case at_special_value:
-            {
-                // Parsing on a special token (true/false/null) --------------------------
-                switch(*cursor)
-                {
-                    case 'r': case 'u':
-                    case 'a': case 's':
-                        if(*cursor != *c_special++) state = error; break;
-                    case 'e':
-                        state = (*cursor != *c_special) ? error : after_value; break;
-                    case 'l':
-                    {
-                        if(*cursor != *c_special++)
-                            state = error;
-                        else 
-                            if(*c_special == 0) state = after_value;
-                    } break;
-                    default: state = error; break;
-                }
-            } break;
+        if(stbj__pool.stopping)
+            break;
 
-            // We are finish parsing, wait until we end the element ----------------------
-            case after_value:
-            {
-                switch(*cursor)
-                {
-					case ' ': case '\n': case '\r': case '\t': break;
-                    case '"': state = (between_comas) ? after_value : error; break;
-                    case ',': state = finish; break;
-                    case ']': state = (context->type == STBJ_ARRAY) ? finish : error; break;
-                    case '}': state = (context->type == STBJ_OBJECT) ? finish : error; break;
-                    default: state = error; break;
-                }
-            } break;
+        stbj__job* job = stbj__pool.job;
+        if(job == 0 || id >= job->num_threads)
+            continue;
 
-            case finish: case error: default: STBJ_ASSERT(0 && "this should never happen!"); break;
-        }
+        stbj__mutex_unlock(&stbj__pool.lock);
+        stbj__run_worker(job, id);
+        stbj__mutex_lock(&stbj__pool.lock);
 
-        // corner case where the error case is not evaluated at the end of max_len ...
-        if(state == error)
-        {
-            context->error = 7; 
-            return default_value;
-        }
-        
-        ++cursor;
+        if(--stbj__pool.active == 0)
+            stbj__cond_wake(&stbj__pool.done);
     }
+    stbj__mutex_unlock(&stbj__pool.lock);
+}
 
-    return (have_result) ? result * sign : default_value;
+#ifdef _WIN32
+static DWORD WINAPI stbj__thread_main(LPVOID arg)
+{
+    stbj__pool_thread((int)(size_t)arg);
+    return 0;
+}
+#else
+static void* stbj__thread_main(void* arg)
+{
+    stbj__pool_thread((int)(size_t)arg);
+    return 0;
 }
+#endif
 
-// Try parsing an integer value at _name_. If unable, return default_value.
-STBJDEF int stbj_read_int_name(stbj_cursor* context, const char* name, int default_value)
+// Called with the pool locked
+static void stbj__start_threads(int count)
 {
-    STBJ_ASSERT(context);
-    STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(name);
+    while(stbj__pool.started < count)
+    {
+        void* arg = (void*)(size_t)(stbj__pool.started + 1);
+        stbj__thread* thread = &stbj__pool.threads[stbj__pool.started];
+#ifdef _WIN32
+        *thread = CreateThread(0, 0, stbj__thread_main, arg, 0, 0);
+        if(*thread == 0) break;
+#else
+        if(pthread_create(thread, 0, stbj__thread_main, arg) != 0) break;
+#endif
+        ++stbj__pool.started;
+    }
+}
 
-    int pos = stbj_find_name(context, name);
-    return (pos >= 0) ? stbj_read_int_index(context, pos, default_value) : default_value;
+static int stbj__num_cores(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cores > 0) ? (int)cores : 1;
+#endif
 }
 
-// Try parsing a double value at index. If unable, return default_value.
-STBJDEF double stbj_read_double_index(stbj_cursor* context, int index, double default_value)
+static stbj_index stbj__parallel_for(const stbj_cursor* context, stbj_element_fn fn, void* user_data, int nthreads, int* error)
 {
     STBJ_ASSERT(context);
     STBJ_ASSERT(context->cursor);
     STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(index >= 0);
+    STBJ_ASSERT(fn);
+    STBJ_ASSERT(error);
 
-    const char* cursor = stbj_find_index(context, index);
+    *error = 0;
 
-    if(!cursor)
-        return default_value; // error num already set by get_element()
+    stbj__job job;
+    job.context = context;
+    job.end = context->buffer + context->len;
+    job.delimiter = (context->type == STBJ_ARRAY) ? ']' : '}';
+    job.fn = fn;
+    job.user_data = user_data;
+    job.num_chunks = 0;
 
-    enum parse_states
-    {
-        before_value,
-        at_num_value,       // 123
-        at_special_value,   // true/false/null
-        after_value,
-        finish,
-        error
-    } state = before_value;
+    // Boundary pass: remember the start of every _stride_ elements. When we run out of
+    // chunks drop every other one and double the stride, so a single pass is enough
+    stbj_index count = 0;
+    stbj_index stride = 1;
+    const char* cursor = context->cursor;
+    const char* next;
 
-    context->error = 0;
-    unsigned int max_len = context->len - (unsigned int)(cursor - context->buffer);
-    int between_comas = 0;
-    double sign = 1.0;
-    double result = 0.0;
-    int have_result = 0;
-    double decimal = 1.0;
-    int past_dot = 0;
-    char special[] = "rue\0ull\0alse";
-    char* c_special = &special[0];
-
-    while(max_len-- > 0 && *cursor && state != finish) 
+    while((next = stbj__next_element(context, cursor, job.end, job.delimiter, error)) != 0)
     {
-        switch(state)
-        {
-            case before_value:
-            {
-                // Parsing done before encountering any value of meaning -----------------
-                switch(*cursor)
-                {
-					case ' ': case '\n': case '\r': case '\t': break;
-                    case '"': if(between_comas++) state = finish; break;
-                    case '-': sign = -1.0; // fall to next option
-                    case '+': state = at_num_value; have_result = 1; break;
-                    case '.': past_dot = 1; state = at_num_value; have_result = 1; break;
-                    case '0': case '1': case '2': case '3': case '4':
-                    case '5': case '6': case '7': case '8': case '9': 
-                        result = *cursor - '0'; state = at_num_value; have_result = 1; break;
-                    case 't': state = at_special_value; have_result = 1; result = 1; break;
-                    case 'f': c_special += 8; state = at_special_value; have_result = 1;  break;
-                    case 'n': c_special += 4; state = at_special_value; have_result = 1;  break;
-                    default: --cursor; state = after_value; break;
-                }
-
-            } break;
+        // [] and {} have no elements
+        if(count == 0 && *next != ',' && stbj__skip_whitespace(cursor + 1, next) == next)
+            break;
 
-            case at_num_value:
-            {
-                // Parsing on a number ---------------------------------------------------
-                switch(*cursor)
-                {
-                    case '.': if(past_dot++) state = error; break;
-                    case '0': case '1': case '2': case '3': case '4':
-                    case '5': case '6': case '7': case '8': case '9':
-                        result = (10 * result) + (*cursor - '0');
-                        if(past_dot) decimal *= 10.0;
-                    break;
-                    default: --cursor; state = after_value; break;
-                }
-            } break;
-
-            case at_special_value:
+        if(count % stride == 0)
+        {
+            if(job.num_chunks == STBJ__MAX_CHUNKS)
             {
-                // Parsing on a special token (true/false/null) --------------------------
-                switch(*cursor)
-                {
-                    case 'r': case 'u':
-                    case 'a': case 's':
-                        if(*cursor != *c_special++) state = error; break;
-                    case 'e':
-                        state = (*cursor != *c_special) ? error : after_value; break;
-                    case 'l':
-                    {
-                        if(*cursor != *c_special++)
-                            state = error;
-                        else 
-                            if(*c_special == 0) state = after_value;
-                    } break;
-                    default: state = error; break;
-                }
-            } break;
+                for(int i = 0; i < STBJ__MAX_CHUNKS / 2; ++i)
+                    job.chunks[i] = job.chunks[i * 2];
+                job.num_chunks = STBJ__MAX_CHUNKS / 2;
+                stride *= 2;
+            }
 
-            // We are finish parsing, wait until we end the element ----------------------
-            case after_value:
+            if(count % stride == 0)
             {
-                switch(*cursor)
-                {
-					case ' ': case '\n': case '\r': case '\t': break;
-                    case '"': state = (between_comas) ? after_value : error; break;
-                    case ',': state = finish; break;
-                    case ']': state = (context->type == STBJ_ARRAY) ? finish : error; break;
-                    case '}': state = (context->type == STBJ_OBJECT) ? finish : error; break;
-                    default: state = error; break;
-                }
-            } break;
-
-            case finish: case error: default: STBJ_ASSERT(0 && "this should never happen!"); break;
+                job.chunks[job.num_chunks].start = cursor;
+                job.chunks[job.num_chunks++].index = count;
+            }
         }
 
-        // corner case where the error case is not evaluated at the end of max_len ...
-        if(state == error)
-        {
-            context->error = 7; 
-            return default_value;
-        }
-        
-        ++cursor;
+        ++count;
+        if(*next != ',') break;
+        cursor = next;
     }
 
-    return (have_result) ? ((result/decimal) * sign) : default_value; 
-}
-
-// Try parsing a double value at _name_. If unable, return default_value.
-STBJDEF double stbj_read_double_name(stbj_cursor* context, const char* name, double default_value)
-{
-    STBJ_ASSERT(context);
-    STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(name);
+    if(next == 0)
+        return -1;
 
-    int pos = stbj_find_name(context, name);
-    return (pos >= 0) ? stbj_read_double_index(context, pos, default_value) : default_value;
-}
+    job.chunks[job.num_chunks].start = 0;
+    job.chunks[job.num_chunks].index = count;
 
-// Try parsing a string at index and fill provided buffer. If unable, fill the buffer with default_value.
-STBJDEF int stbj_read_string_index(stbj_cursor* context, int index, char* buffer, int buffer_size, const char* default_value)
-{
-    STBJ_ASSERT(context);
-    STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(index >= 0);
-    STBJ_ASSERT(buffer);
-    STBJ_ASSERT(buffer_size > 0);
+    if(count == 0)
+        return 0;
 
-    const char* cursor = stbj_find_index(context, index);
-    int buffer_index = 0;
+    if(nthreads <= 0) nthreads = stbj__num_cores();
+    if(nthreads > STBJ_MAX_THREADS) nthreads = STBJ_MAX_THREADS;
+    if(nthreads > job.num_chunks) nthreads = job.num_chunks;
 
-    if(!cursor)
+    // One job at a time uses the pool, nested or concurrent calls run on their own thread
+    int shared = 0;
+    if(nthreads > 1)
     {
-        // TODO check if we can avoid replicating this code
-        if(default_value != 0)
-            while((buffer[buffer_index++] = *default_value++) && buffer_index < (buffer_size-1));
-        buffer[buffer_index] = 0;
-        return buffer_index;
+        stbj__mutex_lock(&stbj__pool.lock);
+        shared = !stbj__pool.busy;
+        stbj__pool.busy = 1;
+        stbj__mutex_unlock(&stbj__pool.lock);
     }
+    if(!shared) nthreads = 1;
+    job.num_threads = nthreads;
 
-    enum parse_states
+    for(int i = 0; i < nthreads; ++i)
     {
-        before_value,
-        at_string_value,    // hellot world
-        at_special_value,   // true/false/null
-		at_scape_character,	// \n \r \b ...
-		at_hex_value,		// \uFAFA
-        after_value,
-        finish,
-        error
-    } state = before_value;
-
-    context->error = 0;
-    unsigned int max_len = context->len - (unsigned int)(cursor - context->buffer);
-    int between_comas = 0;
-	int hex = 0;
-	int hex_count = 0;
-    char special[] = "ull";
-    char* c_special = &special[0];
+        stbj__mutex_init(&job.deques[i].lock);
+        job.deques[i].lo = i * job.num_chunks / nthreads;
+        job.deques[i].hi = (i + 1) * job.num_chunks / nthreads;
+    }
 
-    while(max_len-- > 0 && *cursor && state != finish) 
+    // If a thread fails to start its chunks get stolen
+    if(shared)
     {
-        switch(state)
-        {
-            case before_value:
-            {
-                // Parsing done before encountering any value of meaning -----------------
-                switch(*cursor)
-                {
-					case ' ': case '\n': case '\r': case '\t': break;
-                    case '"': between_comas = 1; state = at_string_value; break;
-                    case 'n': state = at_special_value; break;
-                    case '[': case '{': case ']': case '}': case ',': 
-                              --cursor; state = after_value; break;
-                    default: --cursor; state = at_string_value; break;
-                }
-
-            } break;
+        stbj__mutex_lock(&stbj__pool.lock);
+        stbj__start_threads(nthreads - 1);
+        stbj__pool.active = (stbj__pool.started < nthreads - 1) ? stbj__pool.started : nthreads - 1;
+        stbj__pool.job = &job;
+        ++stbj__pool.generation;
+        stbj__cond_wake(&stbj__pool.wake);
+        stbj__mutex_unlock(&stbj__pool.lock);
+    }
 
-            case at_string_value:
-            {
-                // Parsing on a string ---------------------------------------------------
-                switch(*cursor)
-                {
-					case '\\': state = at_scape_character;
-                    case '"': --cursor; state = after_value; break;
-                    case '[': case '{': case ']': case '}': case ',': 
-                        if(!between_comas) { --cursor; state = after_value; } break;
-                    default: 
-                        if(buffer_index < buffer_size-1) 
-                            buffer[buffer_index++] = *cursor; 
-                        else
-                            state = finish;
-                        break;
-                }
+    stbj__run_worker(&job, 0);
 
-            } break;
+    if(shared)
+    {
+        stbj__mutex_lock(&stbj__pool.lock);
+        while(stbj__pool.active > 0)
+            stbj__cond_wait(&stbj__pool.done, &stbj__pool.lock);
+        stbj__pool.job = 0;
+        stbj__pool.busy = 0;
+        stbj__mutex_unlock(&stbj__pool.lock);
+    }
 
-			case at_scape_character:
-			{
-				// Parsing scape characters like \n or \" -------------------------------------------
-				char c = 0;
-
-				switch (*cursor)
-				{
-					case '\\': c = '\\'; break;
-					case '/': c = '/'; break;
-					case '"': c = '"'; break;
-					case 'b': c = '\b';  break;
-					case 'n': c = '\n';  break;
-					case 'r': c = '\r';  break;
-					case 't': c = '\t';  break;
-					case 'f': c = '\f';  break;
-					case 'u': state = at_hex_value; break;
-					default: state = finish;  break;
-				}
-
-				if (state == at_scape_character && buffer_index < buffer_size - 1)
-				{
-					buffer[buffer_index++] = c;
-					state = at_string_value;
-				}
-			} break;
-
-			case at_hex_value:
-			{
-				// Parsing scape characters like \uFFFF ---------------------------------------------
-				char byte = 0;
-
-				switch (*cursor)
-				{
-                    case '0': case '1': case '2': case '3': case '4':
-                    case '5': case '6': case '7': case '8': case '9':
-						byte = *cursor - '0'; break;
-
-					case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
-						byte = 10 + (*cursor - 'a'); break;
-
-					case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
-						byte = 10 + (*cursor - 'A'); break;
-
-					default: state = finish;  break;
-				}
-
-				hex = (hex << 4) | (byte & 0xF);
-
-				if (state != finish && ++hex_count >= 4)
-				{
-					//buffer[buffer_index++] = hex; // TODO: unicode
-					hex_count = 0;
-					state = at_string_value;
-				}
-
-			} break;
-
-            case at_special_value:
-            {
-                // Parsing on a special token (null) ------------------------------------
-                switch(*cursor)
-                {
-                    case 'u':
-                        if(*cursor != *c_special++) state = error; break;
-                    case 'l':
-                    {
-                        if(*cursor != *c_special++)
-                            state = error;
-                        else 
-                            if(*c_special == 0) state = after_value;
-                    } break;
-                    default: state = error; break;
-                }
-            } break;
+    for(int i = 0; i < nthreads; ++i)
+        stbj__mutex_destroy(&job.deques[i].lock);
 
-            // We are finish parsing, wait until we end the element ----------------------
-            case after_value:
-            {
-                switch(*cursor)
-                {
-					case ' ': case '\n': case '\r': case '\t': break;
-                    case '"': state = (between_comas) ? after_value : error; break;
-                    case ',': state = finish; break;
-                    case ']': state = (context->type == STBJ_ARRAY) ? finish : error; break;
-                    case '}': state = (context->type == STBJ_OBJECT) ? finish : error; break;
-                    default: state = error; break;
-                }
-            } break;
+    return count;
+}
 
-            case finish: case error: default: STBJ_ASSERT(0 && "this should never happen!"); break;
-        }
+STBJDEF void stbj_pool_shutdown(void)
+{
+    stbj__mutex_lock(&stbj__pool.lock);
+    STBJ_ASSERT(!stbj__pool.busy);
+    int started = stbj__pool.started;
+    stbj__pool.stopping = 1;
+    ++stbj__pool.generation;
+    stbj__cond_wake(&stbj__pool.wake);
+    stbj__mutex_unlock(&stbj__pool.lock);
 
-        // corner case where the error case is not evaluated at the end of max_len ...
-        if(state == error)
-        {
-            context->error = 8; 
-            return 0;
-        }
-        
-        ++cursor;
+    for(int i = 0; i < started; ++i)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(stbj__pool.threads[i], INFINITE);
+        CloseHandle(stbj__pool.threads[i]);
+#else
+        pthread_join(stbj__pool.threads[i], 0);
+#endif
     }
 
-    // if we did not wrote anything, strcpy default value into buffer
-    if(buffer_index == 0 && default_value != 0)
-        while((buffer[buffer_index++] = *default_value++) && buffer_index < (buffer_size-1));
-
-    buffer[buffer_index] = 0;
-    return buffer_index; 
+    stbj__mutex_lock(&stbj__pool.lock);
+    stbj__pool.started = 0;
+    stbj__pool.stopping = 0;
+    stbj__mutex_unlock(&stbj__pool.lock);
 }
 
-// Try parsing a string at _name_ and fill provided buffer. If unable, fill the buffer with default_value.
-STBJDEF int stbj_read_string_name(stbj_cursor* context, const char* name, char* buffer, int buffer_size, const char* default_value)
+STBJDEF stbj_index stbj_parallel_for_r(const stbj_cursor* context, stbj_element_fn fn, void* user_data, int nthreads, int* error)
 {
-    STBJ_ASSERT(context);
-    STBJ_ASSERT(context->cursor);
-    STBJ_ASSERT(context->type != STBJ_ERROR);
-    STBJ_ASSERT(name);
-    STBJ_ASSERT(buffer);
-    STBJ_ASSERT(buffer_size > 0);
+    stbj_cursor shared = stbj__shared(context);
+    return stbj__parallel_for(&shared, fn, user_data, nthreads, error);
+}
 
-    int pos = stbj_find_name(context, name);
-    if (pos >= 0) 
-        return stbj_read_string_index(context, pos, buffer,buffer_size, default_value);
-    else
-    {
-        int buffer_index = 0;
-        while((buffer[buffer_index++] = *default_value++) && buffer_index < (buffer_size-1));
-    }
-    return 0;
+STBJDEF stbj_index stbj_parallel_for(stbj_cursor* context, stbj_element_fn fn, void* user_data, int nthreads)
+{
+    int error = 0;
+    stbj_index ret = stbj__parallel_for(context, fn, user_data, nthreads, &error);
+    context->error = (char)error;
+    return ret;
 }
+#endif // STBJ_ENABLE_THREADS
 #endif // STB_JSON_IMPLEMENTATION
 
 /*
@@ -1006,6 +4875,47 @@ STBJDEF int stbj_read_string_name(stbj_cursor* context, const char* name, char*
               Handling of newline and carriage return chars
       0.6     (2019-07-23)
               Parsing scape characters, ignore hex values
+      0.7     (2026-10-19)
+              Optional tracing callback and USDT probes (STBJ_ENABLE_TRACE)
+      0.8     (2026-10-19)
+              stbj_validate() with strict and lenient modes
+      0.9     (2026-10-19)
+              Table driven state machine shared by all read functions
+              Fixed scape characters and ,[]{} inside strings
+      0.10    (2026-10-19)
+              Padded buffers mode without bounds checks (STBJ_PADDED_BUFFERS)
+      0.11    (2026-10-19)
+              Reentrant _r versions with const cursors for concurrent readers
+      0.12    (2026-10-19)
+              stbj_parallel_for() over array elements on a thread pool (STBJ_ENABLE_THREADS)
+      0.13    (2026-10-19)
+              Optional lookup cache with CLOCK eviction in caller memory
+      0.14    (2026-10-19)
+              Shape cache for arrays of same shaped objects
+      0.15    (2026-10-19)
+              stbj_extract_columns() into Arrow style columns
+      0.16    (2026-10-19)
+              Field index to find objects of an array by a field value
+      0.17    (2026-10-19)
+              stbj_find_all_key() to find a key at any depth
+      0.18    (2026-10-19)
+              stbj_minify() removes whitespace outside strings
+      0.19    (2026-10-19)
+              stbj_project() keeps some members as slices of the buffer
+      0.20    (2026-10-19)
+              stbj_apply_edit() updates the cache after editing the buffer
+      0.21    (2026-10-19)
+              structural index for find_index, count_values and skipping elements
+      0.22    (2026-10-19)
+              stbj_size/stbj_index types, STBJ_LARGE_DOCUMENTS for documents over 4 GB
+      0.23    (2026-10-19)
+              bit stacks for nesting, STBJ_MAX_DEPTH and stbj_attach_depth_stack()
+      0.24    (2026-10-19)
+              document store with a shared key dictionary, stbj_key_id()
+      0.25    (2026-10-19)
+              pre-hashed keys, stbj_make_key() and the _key functions
+      0.26    (2026-10-19)
+              one pass iteration over elements and members, stbj_iterate()
 */
 
 
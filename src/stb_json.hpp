@@ -11,44 +11,959 @@
 #define STB_JSON_IMPLEMENTATION
 #include "stb_json.h"
 
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define STBJ_CPP17 1
+#else
+#define STBJ_CPP17 0
+#endif
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define STBJ_CPP20 1
+#else
+#define STBJ_CPP20 0
+#endif
+
+#if STBJ_CPP17 && defined(__has_include)
+#if __has_include(<memory_resource>)
+#define STBJ_PMR 1
+#include <memory_resource>
+#endif
+#endif
+#ifndef STBJ_PMR
+#define STBJ_PMR 0
+#endif
+
+#if STBJ_CPP20
+#include <type_traits>
+
+// Member name known at compile time: "id"_k or just "id" as a template argument.
+// Length, hash and prefix are computed by the compiler, same values as stbj_make_key
+template<stbj_size N> struct stbj_fixed_key
+{
+    char name[N];
+    stbj_size len = N - 1;
+    unsigned int hash = 2166136261u;
+    unsigned long long prefix = 0;
+
+    constexpr stbj_fixed_key(const char (&str)[N]) : name()
+    {
+        for(stbj_size i = 0; i < N; ++i) name[i] = str[i];
+        for(stbj_size i = 0; i < len; ++i)
+        {
+            hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+            if(i < 8) prefix |= (unsigned long long)(unsigned char)name[i] << (8 * i);
+        }
+    }
+};
+
+template<stbj_fixed_key K> constexpr auto operator""_k() { return K; }
+
+// One stbj_key per name, baked into the binary
+template<stbj_fixed_key K> inline constexpr stbj_key stbj_key_of = { K.name, K.len, K.hash, K.prefix };
+#endif
+
+#if STBJ_PMR
+class stbj_dom;
+#endif
+
 class stb_json
 {
     public:
-        stb_json(const char* buffer, unsigned int buffer_length) { context = stbj_load_buffer(buffer, buffer_length); }
+        stb_json(const char* buffer, stbj_size buffer_length) { context = stbj_load_buffer(buffer, buffer_length); }
         stb_json(const stbj_cursor& context) : context(context) {}
 
         // Parsing methods ------------
-        void GetString(const char* field_name, char* dest_buffer, int dest_size, const char* default_value = "?") const
+        // They keep the last error in the object (GetError) and fill the attached cache, so
+        // they are not const. Threads reading the same document need a copy each, or the
+        // const Decode and Materialize that do not write anything.
+        void GetString(const char* field_name, char* dest_buffer, int dest_size, const char* default_value = "?")
         { stbj_read_string_name(&context, field_name, dest_buffer, dest_size, default_value); }
 
-        void GetString(int index, char* dest_buffer, int dest_size, const char* default_value = "?") const
+        void GetString(int index, char* dest_buffer, int dest_size, const char* default_value = "?")
         { stbj_read_string_index(&context, index, dest_buffer, dest_size, default_value); }
 
-        int GetInt(const char* field_name, int default_value = 0) const
+        void GetString(const stbj_key& key, char* dest_buffer, int dest_size, const char* default_value = "?")
+        { stbj_read_string_key(&context, &key, dest_buffer, dest_size, default_value); }
+
+        int GetInt(const char* field_name, int default_value = 0)
         { return stbj_read_int_name(&context, field_name, default_value); }
 
-        int GetInt(int index, int default_value = 0) const
+        int GetInt(int index, int default_value = 0)
         { return stbj_read_int_index(&context, index, default_value); }
 
-        double GetDouble(const char* field_name, double default_value = 0.0) const
+        int GetInt(const stbj_key& key, int default_value = 0)
+        { return stbj_read_int_key(&context, &key, default_value); }
+
+        double GetDouble(const char* field_name, double default_value = 0.0)
         { return stbj_read_double_name(&context, field_name, default_value); }
 
-        double GetDouble(int index, double default_value = 0.0) const
+        double GetDouble(int index, double default_value = 0.0)
         { return stbj_read_double_index(&context, index, default_value); }
 
-        stb_json MoveCursor(const char* field_name) const
+        double GetDouble(const stbj_key& key, double default_value = 0.0)
+        { return stbj_read_double_key(&context, &key, default_value); }
+
+        stb_json MoveCursor(const char* field_name)
         { return stbj_cursor(stbj_move_cursor_name(&context, field_name)); }
 
-        stb_json MoveCursor(int index) const
+        stb_json MoveCursor(int index)
         { return stbj_cursor(stbj_move_cursor_index(&context, index)); }
 
+        stb_json MoveCursor(const stbj_key& key)
+        { return stbj_cursor(stbj_move_cursor_key(&context, &key)); }
+
+#if STBJ_CPP20
+        // Compile time names: json.Get<"geometry"_k, "coordinates"_k>() moves along the
+        // path, json.Get<"id", int>(-1) reads a value (int or double). Only the keys are
+        // built by the compiler, the path is walked by a loop at run time
+        template<stbj_fixed_key First, stbj_fixed_key... Rest> stb_json Get()
+        {
+            const stbj_key* path[] = { &stbj_key_of<First>, &stbj_key_of<Rest>... };
+            stbj_cursor cursor = context;
+            for(const stbj_key* key : path)
+                if(cursor.type != STBJ_ERROR) cursor = stbj_move_cursor_key(&cursor, key);
+            return cursor;
+        }
+
+        template<stbj_fixed_key Name, class T> T Get(T default_value = T())
+        {
+            static_assert(std::is_same_v<T, int> || std::is_same_v<T, double>, "Get<name, T> reads int or double");
+            if constexpr(std::is_same_v<T, double>) return stbj_read_double_key(&context, &stbj_key_of<Name>, default_value);
+            else return stbj_read_int_key(&context, &stbj_key_of<Name>, default_value);
+        }
+
+        template<stbj_fixed_key Name> void GetString(char* dest_buffer, int dest_size, const char* default_value = "?")
+        { stbj_read_string_key(&context, &stbj_key_of<Name>, dest_buffer, dest_size, default_value); }
+#endif
+
+#ifdef STBJ_ENABLE_THREADS
+        // Calls fn(stb_json element, int index) for each element from many threads.
+        // Read the element at index 0: element.GetInt(0), element.MoveCursor(0)
+        template<class F> stbj_index ParallelFor(F fn, int nthreads = 0)
+        { return stbj_parallel_for(&context, &ParallelForCall<F>, &fn, nthreads); }
+#endif
+
+#if STBJ_CPP17
+        // Fills a struct declared with STBJ_BIND (below) in one pass over the object
+        template<class T> bool Decode(T& out) const;
+#endif
+
+#if STBJ_PMR
+        // Builds the whole tree below the cursor (stbj_dom, below) with memory from resource
+        stbj_dom Materialize(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+#endif
+
         // Helper methods ------------
-        int Count() const { return stbj_count_values(&context); }
+        void AttachCache(stbj_cache* cache) { stbj_attach_cache(&context, cache); }
+        void AttachStructIndex(const stbj_struct_index* index) { stbj_attach_struct_index(&context, index); }
+        void AttachDepthStack(stbj_depth_stack* stack) { stbj_attach_depth_stack(&context, stack); }
+        stbj_index Count() { return stbj_count_values(&context); }
         const char* GetError() const { return stbj_get_last_error(&context); }
         bool HasError() const { return stbj_any_error(&context); }
 
     private:
-        mutable stbj_cursor context;
+#ifdef STBJ_ENABLE_THREADS
+        template<class F> static void ParallelForCall(const stbj_cursor* element, stbj_index index, void* user_data)
+        { (*(F*)user_data)(stb_json(*element), index); }
+#endif
+
+        stbj_cursor context;
+};
+
+#if STBJ_CPP17
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Struct binding ------------
+// STBJ_BIND(Event, id, name, logo, subTopicIds) after struct Event, at namespace scope,
+// lets json.Decode(event) fill it. Every object is walked once with stbj_iterate and
+// each member goes to the field with the same name; missing members and values of the
+// wrong type leave the field as it was. Fields can be any integer (64 bit included),
+// double, float, bool, std::string, std::string_view (points into the buffer, escapes
+// kept), std::vector of any of them and other bound structs. Up to 16 fields per
+// STBJ_BIND.
+template<class T> bool stbj_decode(const stbj_cursor& element, T& out);
+
+template<class T, class Enable = void> struct stbj_decoder
+{
+    // structs declared with STBJ_BIND, stbj_bind_member is found through the type
+    static bool decode(const stbj_cursor& element, T& out)
+    {
+        int error = 0;
+        stbj_cursor object = stbj_move_cursor_index_r(&element, 0, &error);
+        return object.type == STBJ_OBJECT && decode_object(object, out);
+    }
+
+    static bool decode_object(const stbj_cursor& object, T& out)
+    {
+        int error = 0;
+        stbj_iterator it;
+        stbj_iterator_init(&object, &it);
+        while(stbj_iterate_r(&object, &it, &error))
+            if(it.name) stbj_bind_member(out, std::string_view(it.name, it.name_len), it.element);
+        return error == 0;
+    }
+};
+
+// The C functions read int, wider integers (and unsigned int) parse the digits here.
+// Same rules as the INT64 columns: true is 1, false 0, a fraction is cut off
+inline bool stbj__decode_int64(const stbj_cursor& element, long long& out)
+{
+    int error = 0;
+    const char* at = stbj_find_index_r(&element, 0, &error);
+    const char* end = element.buffer + element.len;
+    while(at && at < end && (*at == ' ' || *at == '\n' || *at == '\r' || *at == '\t')) ++at;
+    if(!at || at >= end)
+        return false;
+
+    if(*at == 't' || *at == 'f')
+    {
+        out = (*at == 't');
+        return true;
+    }
+
+    int negative = (*at == '-');
+    at += negative;
+    if(at >= end || *at < '0' || *at > '9')
+        return false;
+
+    unsigned long long result = 0;
+    while(at < end && *at >= '0' && *at <= '9')
+        result = (10 * result) + (unsigned long long)(*at++ - '0');
+    out = (long long)((negative) ? 0ull - result : result);
+    return true;
+}
+
+template<class T> struct stbj_decoder<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static bool decode(const stbj_cursor& element, T& out)
+    {
+        int error = 0;
+        if constexpr(std::is_floating_point<T>::value)
+            out = (T)stbj_read_double_index_r(&element, 0, (double)out, &error);
+        else if constexpr(sizeof(T) > sizeof(int) || (std::is_unsigned<T>::value && sizeof(T) == sizeof(int)))
+        {
+            long long value = 0;
+            if(!stbj__decode_int64(element, value))
+                return false;
+            out = (T)value;
+        }
+        else
+            out = (T)stbj_read_int_index_r(&element, 0, (int)out, &error);
+        return error == 0;
+    }
+};
+
+template<> struct stbj_decoder<std::string_view>
+{
+    static bool decode(const stbj_cursor& element, std::string_view& out)
+    {
+        int error = 0;
+        const char* at = stbj_find_index_r(&element, 0, &error);
+        const char* end = element.buffer + element.len;
+        while(at && at < end && (*at == ' ' || *at == '\n' || *at == '\r' || *at == '\t')) ++at;
+        if(!at || at >= end || *at != '"')
+            return false;
+
+        const char* string_end = ++at;
+        while(string_end < end && *string_end && *string_end != '"')
+            string_end += (*string_end == '\\') ? 2 : 1;
+        if(string_end >= end || *string_end != '"')
+            return false;
+
+        out = std::string_view(at, (size_t)(string_end - at));
+        return true;
+    }
+};
+
+template<> struct stbj_decoder<std::string>
+{
+    static bool decode(const stbj_cursor& element, std::string& out)
+    {
+        std::string_view raw;
+        if(!stbj_decoder<std::string_view>::decode(element, raw))
+            return false;
+        if(raw.find('\\') == std::string_view::npos)
+        {
+            out.assign(raw.data(), raw.size());
+            return true;
+        }
+
+        // escapes never make a string longer
+        int error = 0;
+        out.resize(raw.size() + 1);
+        int len = stbj_read_string_index_r(&element, 0, &out[0], (int)out.size(), "", &error);
+        out.resize((size_t)len);
+        return error == 0;
+    }
+};
+
+template<class T> struct stbj_decoder<std::vector<T>>
+{
+    static bool decode(const stbj_cursor& element, std::vector<T>& out)
+    {
+        int error = 0;
+        stbj_cursor array = stbj_move_cursor_index_r(&element, 0, &error);
+        if(array.type != STBJ_ARRAY)
+            return false;
+
+        out.clear();
+        stbj_iterator it;
+        stbj_iterator_init(&array, &it);
+        while(stbj_iterate_r(&array, &it, &error))
+            stbj_decoder<T>::decode(it.element, out.emplace_back());
+        return error == 0;
+    }
+};
+
+template<class T> bool stbj_decode(const stbj_cursor& element, T& out) { return stbj_decoder<T>::decode(element, out); }
+
+template<class T> bool stb_json::Decode(T& out) const
+{
+    if(context.type != STBJ_OBJECT)
+        return false;
+    return stbj_decoder<T>::decode_object(context, out);
+}
+
+#define STBJ__EXPAND(x) x
+#define STBJ__FOR_EACH_1(m, x) m(x)
+#define STBJ__FOR_EACH_2(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_1(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_3(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_2(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_4(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_3(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_5(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_4(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_6(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_5(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_7(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_6(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_8(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_7(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_9(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_8(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_10(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_9(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_11(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_10(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_12(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_11(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_13(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_12(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_14(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_13(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_15(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_14(m, __VA_ARGS__))
+#define STBJ__FOR_EACH_16(m, x, ...) m(x) STBJ__EXPAND(STBJ__FOR_EACH_15(m, __VA_ARGS__))
+#define STBJ__PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, name, ...) name
+#define STBJ__FOR_EACH(m, ...) STBJ__EXPAND(STBJ__PICK(__VA_ARGS__, \
+    STBJ__FOR_EACH_16, STBJ__FOR_EACH_15, STBJ__FOR_EACH_14, STBJ__FOR_EACH_13, STBJ__FOR_EACH_12, STBJ__FOR_EACH_11, \
+    STBJ__FOR_EACH_10, STBJ__FOR_EACH_9, STBJ__FOR_EACH_8, STBJ__FOR_EACH_7, STBJ__FOR_EACH_6, STBJ__FOR_EACH_5, \
+    STBJ__FOR_EACH_4, STBJ__FOR_EACH_3, STBJ__FOR_EACH_2, STBJ__FOR_EACH_1)(m, __VA_ARGS__))
+
+#define STBJ__BIND_FIELD(field) if(name == #field) return stbj_decode(element, out.field);
+
+#define STBJ_BIND(Type, ...) \
+    inline bool stbj_bind_member(Type& out, std::string_view name, const stbj_cursor& element) \
+    { STBJ__FOR_EACH(STBJ__BIND_FIELD, __VA_ARGS__) return false; }
+#endif
+
+#if STBJ_PMR
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <string_view>
+#include <vector>
+
+// DOM ------------
+// For code that needs the whole tree: json.Materialize(&arena) reads everything below
+// the cursor in one pass over the text. Nodes live in one flat array, parents before
+// children, and list their children by index (four inline, more in a block from the
+// resource). Names and values are views into the buffer, strings without quotes and
+// escapes kept, so the buffer must outlive the tree. All memory comes from the resource:
+// with a std::pmr::monotonic_buffer_resource there is no allocation per node and the
+// whole tree goes away with the arena. Trees are movable but not copyable.
+//
+//      std::pmr::monotonic_buffer_resource arena;
+//      stbj_dom dom = stb_json(buffer, len).Materialize(&arena);
+//      stbj_index events = dom.Find(0, "events");
+//
+// On malformed text dom.error is set (same codes as the cursor, 7 for a number that is not
+// JSON) and nodes is empty.
+enum stbj_node_kind : unsigned char
+{
+    STBJ_NODE_NULL, STBJ_NODE_FALSE, STBJ_NODE_TRUE, STBJ_NODE_NUMBER, STBJ_NODE_STRING, STBJ_NODE_ARRAY, STBJ_NODE_OBJECT
+};
+
+class stbj_node_list
+{
+    public:
+        stbj_node_list() {}
+        stbj_node_list(const stbj_node_list&) = delete;
+        stbj_node_list& operator=(const stbj_node_list&) = delete;
+        stbj_node_list(stbj_node_list&& other) noexcept { memcpy((void*)this, (const void*)&other, sizeof(*this)); other.size_ = 0; other.capacity_ = INLINE; }
+
+        stbj_size size() const { return size_; }
+        const stbj_size* begin() const { return data(); }
+        const stbj_size* end() const { return data() + size_; }
+        stbj_size operator[](stbj_size i) const { return data()[i]; }
+
+        void push_back(stbj_size node, std::pmr::memory_resource* resource)
+        {
+            if(size_ == capacity_)
+            {
+                stbj_size* block = (stbj_size*)resource->allocate(2 * capacity_ * sizeof(stbj_size), alignof(stbj_size));
+                memcpy(block, data(), size_ * sizeof(stbj_size));
+                release(resource);
+                heap_ = block;
+                capacity_ *= 2;
+            }
+            data()[size_++] = node;
+        }
+
+        void erase(stbj_size i) { memmove(data() + i, data() + i + 1, (size_ - i - 1) * sizeof(stbj_size)); --size_; }
+
+        // Gives the block back, for resources that free memory. The list keeps its size
+        void release(std::pmr::memory_resource* resource)
+        { if(capacity_ > INLINE) resource->deallocate(heap_, capacity_ * sizeof(stbj_size), alignof(stbj_size)); }
+
+    private:
+        enum { INLINE = 4 };
+
+        stbj_size* data() { return (capacity_ > INLINE) ? heap_ : inline_; }
+        const stbj_size* data() const { return (capacity_ > INLINE) ? heap_ : inline_; }
+
+        stbj_size size_ = 0, capacity_ = INLINE;
+        union { stbj_size inline_[INLINE]; stbj_size* heap_; };
+};
+
+struct stbj_node
+{
+    stbj_node_kind kind;
+    std::string_view name;      // member name in the parent object, empty in arrays
+    std::string_view text;      // value as written, whole text for arrays and objects
+    stbj_node_list children;    // indices in stbj_dom::nodes
+};
+
+class stbj_dom
+{
+    public:
+        explicit stbj_dom(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : nodes(resource) {}
+        stbj_dom(stbj_dom&& other) = default;
+        stbj_dom& operator=(const stbj_dom&) = delete;
+        ~stbj_dom() { Clear(); }
+
+        // Gives back the blocks of the current children, then takes the nodes and the
+        // resource of other like the move constructor does
+        stbj_dom& operator=(stbj_dom&& other) noexcept
+        {
+            if(this != &other)
+            {
+                Clear();
+                nodes.~vector();
+                new(&nodes) std::pmr::vector<stbj_node>(std::move(other.nodes));
+                error = other.error;
+            }
+            return *this;
+        }
+
+        std::pmr::vector<stbj_node> nodes;      // nodes[0] is the root
+        int error = 0;
+
+        std::pmr::memory_resource* GetResource() const { return nodes.get_allocator().resource(); }
+        bool HasError() const { return error != 0; }
+        const char* GetError() const { stbj_cursor c = stbj_cursor(); c.error = (char)error; return stbj_get_last_error(&c); }
+
+        // Member of an object node, -1 if missing
+        stbj_index Find(stbj_size node, std::string_view name) const
+        {
+            for(stbj_size child : nodes[node].children)
+                if(nodes[child].name == name) return (stbj_index)child;
+            return -1;
+        }
+
+        long long GetInt(stbj_size node, long long default_value = 0) const
+        {
+            const stbj_node& n = nodes[node];
+            if(n.kind == STBJ_NODE_TRUE || n.kind == STBJ_NODE_FALSE) return n.kind == STBJ_NODE_TRUE;
+            if(n.kind != STBJ_NODE_NUMBER) return default_value;
+            char number[64];
+            size_t len = (n.text.size() < sizeof(number)) ? n.text.size() : sizeof(number) - 1;
+            memcpy(number, n.text.data(), len);
+            number[len] = 0;
+            return strtoll(number, 0, 10);
+        }
+
+        double GetDouble(stbj_size node, double default_value = 0.0) const
+        {
+            const stbj_node& n = nodes[node];
+            if(n.kind != STBJ_NODE_NUMBER) return default_value;
+            char number[64];
+            size_t len = (n.text.size() < sizeof(number)) ? n.text.size() : sizeof(number) - 1;
+            memcpy(number, n.text.data(), len);
+            number[len] = 0;
+            return strtod(number, 0);
+        }
+
+        // Appends a node to an array or object, text must outlive the tree
+        stbj_size Add(stbj_size parent, stbj_node_kind kind, std::string_view name, std::string_view text)
+        {
+            stbj_size node = (stbj_size)nodes.size();
+            nodes.push_back({ kind, name, text, stbj_node_list() });
+            nodes[parent].children.push_back(node, GetResource());
+            return node;
+        }
+
+        void Clear()
+        {
+            for(stbj_node& n : nodes) n.children.release(GetResource());
+            nodes.clear();
+        }
+};
+
+inline stbj_dom stb_json::Materialize(std::pmr::memory_resource* resource) const
+{
+    stbj_dom dom(resource);
+    if(context.type == STBJ_ERROR)
+    {
+        dom.error = (context.error) ? context.error : 1;
+        return dom;
+    }
+
+    const char* p = context.cursor;
+    const char* end = context.buffer + context.len;
+    std::pmr::vector<stbj_size> open(resource);     // arrays and objects not closed yet
+    bool after_value = false;                       // a value was read, next is , or the close
+
+    // string at p, moves p past the closing quote
+    auto read_string = [&](std::string_view& out) -> bool
+    {
+        const char* begin = ++p;
+        for(;;)
+        {
+            p = stbj__skip_plain_string(p, end);
+            if(p >= end || !*p || *p == '"') break;
+            p += (*p == '\\') ? 2 : 1;
+        }
+        if(p >= end || *p != '"')
+            return false;
+        out = std::string_view(begin, (size_t)(p++ - begin));
+        return true;
+    };
+
+    dom.nodes.push_back({ (context.type == STBJ_OBJECT) ? STBJ_NODE_OBJECT : STBJ_NODE_ARRAY, std::string_view(), std::string_view(p, 0), stbj_node_list() });
+    open.push_back(0);
+    ++p;
+
+    while(!open.empty())
+    {
+        p = stbj__skip_whitespace(p, end);
+
+        stbj_size parent = open.back();
+        bool object = dom.nodes[parent].kind == STBJ_NODE_OBJECT;
+        int mismatch = (object) ? 5 : 4;
+        if(p >= end || !*p)
+        {
+            dom.error = mismatch;
+            break;
+        }
+
+        if(*p == ((object) ? '}' : ']') && (after_value || dom.nodes[parent].children.size() == 0))
+        {
+            std::string_view& text = dom.nodes[parent].text;
+            text = std::string_view(text.data(), (size_t)(++p - text.data()));
+            open.pop_back();
+            after_value = true;
+            continue;
+        }
+
+        if(after_value)
+        {
+            if(*p != ',')
+            {
+                dom.error = mismatch;
+                break;
+            }
+            ++p;
+            after_value = false;
+            continue;
+        }
+
+        std::string_view name;
+        if(object)
+        {
+            if(*p != '"' || !read_string(name))
+            {
+                dom.error = (*p == '"') ? 8 : 5;
+                break;
+            }
+            p = stbj__skip_whitespace(p, end);
+            if(p >= end || *p != ':')
+            {
+                dom.error = 5;
+                break;
+            }
+            ++p;
+            p = stbj__skip_whitespace(p, end);
+            if(p >= end)
+            {
+                dom.error = 5;
+                break;
+            }
+        }
+
+        stbj_size node = (stbj_size)dom.nodes.size();
+        stbj_node_kind kind = STBJ_NODE_NUMBER;
+        std::string_view text(p, 0);
+        after_value = true;
+
+        if(*p == '{' || *p == '[')
+        {
+            kind = (*p++ == '{') ? STBJ_NODE_OBJECT : STBJ_NODE_ARRAY;
+            open.push_back(node);
+            after_value = false;
+        }
+        else if(*p == '"')
+        {
+            kind = STBJ_NODE_STRING;
+            if(!read_string(text))
+            {
+                dom.error = 8;
+                break;
+            }
+        }
+        else
+        {
+            const char* begin = p;
+            while(p < end && *p && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') ++p;
+            text = std::string_view(begin, (size_t)(p - begin));
+
+            if(text == "true") kind = STBJ_NODE_TRUE;
+            else if(text == "false") kind = STBJ_NODE_FALSE;
+            else if(text == "null") kind = STBJ_NODE_NULL;
+            else if(stbj__validate_number(begin, p) != p)
+            {
+                dom.error = 7;
+                break;
+            }
+        }
+
+        dom.nodes.push_back({ kind, name, text, stbj_node_list() });
+        dom.nodes[parent].children.push_back(node, resource);
+    }
+
+    if(dom.error)
+        dom.Clear();
+    return dom;
+}
+#endif
+
+#if STBJ_CPP20
+#include <array>
+#include <cstdlib>
+#include <string_view>
+#include <type_traits>
+
+// Embedded JSON ------------
+// JSON in a string literal, validated and indexed by the compiler:
+//
+//      constexpr auto config = stbj_embed<R"({"threads": 4, "limits": {"rps": 100.5}})">;
+//      static_assert(config["threads"].as_int() == 4);
+//      double rps = config["limits"]["rps"].as_double();
+//
+// Malformed JSON does not compile (the error names the problem). The result is a tape
+// of offsets with one entry per value, in document order, stored in the binary: no
+// parsing at startup and lookups only hop over entries. Strings are views of the
+// literal, escapes kept. cursor() gives a stbj_cursor for the generic API.
+enum stbj_tape_kind : unsigned char
+{
+    STBJ_TAPE_NULL, STBJ_TAPE_FALSE, STBJ_TAPE_TRUE, STBJ_TAPE_NUMBER, STBJ_TAPE_STRING, STBJ_TAPE_ARRAY, STBJ_TAPE_OBJECT
+};
+
+struct stbj_tape_entry
+{
+    stbj_tape_kind kind;
+    stbj_size begin, end;       // text of the value, strings without quotes
+    stbj_size key, key_len;     // member name without quotes, objects only
+    stbj_size next;             // entry after this value and everything inside it
+    stbj_size count;            // elements of arrays and objects
+};
+
+template<stbj_size N> struct stbj_fixed_text
+{
+    char text[N];
+    constexpr stbj_fixed_text(const char (&str)[N]) : text() { for(stbj_size i = 0; i < N; ++i) text[i] = str[i]; }
+};
+
+// Not constexpr on purpose: reaching it while building a tape stops the compilation
+inline void stbj__embedded_json_error(const char* message) { (void)message; }
+
+// Recursive descent parser that writes the tape, or only counts entries when out is null
+struct stbj__tape_parser
+{
+    const char* text;
+    stbj_size len;
+    stbj_size pos;
+    stbj_tape_entry* out;
+    stbj_size count;
+
+    constexpr char peek() const { return (pos < len) ? text[pos] : 0; }
+    constexpr void whitespace() { while(peek() == ' ' || peek() == '\n' || peek() == '\r' || peek() == '\t') ++pos; }
+    constexpr void expect(char c, const char* message) { if(peek() != c) stbj__embedded_json_error(message); ++pos; }
+    static constexpr bool digit(char c) { return c >= '0' && c <= '9'; }
+
+    constexpr void literal(const char* word)
+    {
+        for(; *word; ++word)
+            expect(*word, "invalid literal, expected true, false or null");
+    }
+
+    constexpr void string()
+    {
+        expect('"', "expected a string");
+        for(;;)
+        {
+            char c = peek();
+            if(c == '"') break;
+            if(pos >= len || (unsigned char)c < 0x20) stbj__embedded_json_error("unterminated string or control character in string");
+            ++pos;
+            if(c != '\\') continue;
+
+            c = peek();
+            ++pos;
+            if(c == 'u')
+            {
+                for(int i = 0; i < 4; ++i, ++pos)
+                {
+                    char h = peek();
+                    if(!digit(h) && !(h >= 'a' && h <= 'f') && !(h >= 'A' && h <= 'F')) stbj__embedded_json_error("invalid \\u escape");
+                }
+            }
+            else if(c != '"' && c != '\\' && c != '/' && c != 'b' && c != 'f' && c != 'n' && c != 'r' && c != 't')
+                stbj__embedded_json_error("invalid escape in string");
+        }
+        ++pos;
+    }
+
+    constexpr void number()
+    {
+        if(peek() == '-') ++pos;
+        if(peek() == '0') ++pos;
+        else if(digit(peek())) while(digit(peek())) ++pos;
+        else stbj__embedded_json_error("invalid number");
+
+        if(peek() == '.')
+        {
+            ++pos;
+            if(!digit(peek())) stbj__embedded_json_error("invalid number, digits expected after '.'");
+            while(digit(peek())) ++pos;
+        }
+        if(peek() == 'e' || peek() == 'E')
+        {
+            ++pos;
+            if(peek() == '+' || peek() == '-') ++pos;
+            if(!digit(peek())) stbj__embedded_json_error("invalid number, digits expected in exponent");
+            while(digit(peek())) ++pos;
+        }
+    }
+
+    constexpr void value(stbj_size key, stbj_size key_len, int depth)
+    {
+        if(depth > 256) stbj__embedded_json_error("JSON nested too deep");
+
+        whitespace();
+        stbj_size at = count++;
+        stbj_tape_entry entry = { STBJ_TAPE_NULL, pos, pos, key, key_len, 0, 0 };
+
+        switch(peek())
+        {
+            case '{': case '[':
+            {
+                char close = (peek() == '{') ? '}' : ']';
+                entry.kind = (close == '}') ? STBJ_TAPE_OBJECT : STBJ_TAPE_ARRAY;
+                ++pos;
+                whitespace();
+                if(peek() != close)
+                {
+                    for(;;)
+                    {
+                        stbj_size name = 0, name_len = 0;
+                        if(close == '}')
+                        {
+                            whitespace();
+                            name = pos + 1;
+                            string();
+                            name_len = pos - 1 - name;
+                            whitespace();
+                            expect(':', "expected ':' after member name");
+                        }
+                        value(name, name_len, depth + 1);
+                        ++entry.count;
+                        whitespace();
+                        if(peek() != ',') break;
+                        ++pos;
+                    }
+                }
+                expect(close, (close == '}') ? "expected ',' or '}' in object" : "expected ',' or ']' in array");
+                entry.end = pos;
+            } break;
+            case '"':
+                entry.kind = STBJ_TAPE_STRING;
+                string();
+                entry.begin += 1;
+                entry.end = pos - 1;
+            break;
+            case 't': entry.kind = STBJ_TAPE_TRUE; literal("true"); entry.end = pos; break;
+            case 'f': entry.kind = STBJ_TAPE_FALSE; literal("false"); entry.end = pos; break;
+            case 'n': entry.kind = STBJ_TAPE_NULL; literal("null"); entry.end = pos; break;
+            default: entry.kind = STBJ_TAPE_NUMBER; number(); entry.end = pos; break;
+        }
+
+        entry.next = count;
+        if(out) out[at] = entry;
+    }
+
+    constexpr void document()
+    {
+        value(0, 0, 0);
+        whitespace();
+        if(pos != len) stbj__embedded_json_error("unexpected characters after the JSON value");
+    }
 };
 
+struct stbj_tape_value
+{
+    const stbj_tape_entry* tape;    // null when the value is missing
+    const char* text;
+    stbj_size text_len;
+    stbj_size at;
+
+    constexpr bool valid() const { return tape != nullptr; }
+    constexpr stbj_tape_kind kind() const { return (tape) ? tape[at].kind : STBJ_TAPE_NULL; }
+    constexpr stbj_size count() const { return (tape) ? tape[at].count : 0; }
+    constexpr std::string_view text_view() const { return (tape) ? std::string_view(text + tape[at].begin, tape[at].end - tape[at].begin) : std::string_view(); }
+
+    // Member by name (compared as written in the literal) or element by index
+    constexpr stbj_tape_value operator[](std::string_view name) const
+    {
+        if(kind() != STBJ_TAPE_OBJECT) return { nullptr, text, text_len, 0 };
+        for(stbj_size i = at + 1, n = 0; n < tape[at].count; i = tape[i].next, ++n)
+            if(std::string_view(text + tape[i].key, tape[i].key_len) == name)
+                return { tape, text, text_len, i };
+        return { nullptr, text, text_len, 0 };
+    }
+
+    constexpr stbj_tape_value operator[](stbj_size index) const
+    {
+        if((kind() != STBJ_TAPE_ARRAY && kind() != STBJ_TAPE_OBJECT) || index >= tape[at].count) return { nullptr, text, text_len, 0 };
+        stbj_size i = at + 1;
+        while(index--) i = tape[i].next;
+        return { tape, text, text_len, i };
+    }
+
+    constexpr std::string_view name() const { return (tape) ? std::string_view(text + tape[at].key, tape[at].key_len) : std::string_view(); }
+    constexpr std::string_view as_string(std::string_view default_value = {}) const { return (kind() == STBJ_TAPE_STRING) ? text_view() : default_value; }
+    constexpr bool as_bool(bool default_value = false) const { return (kind() == STBJ_TAPE_TRUE) ? true : (kind() == STBJ_TAPE_FALSE) ? false : default_value; }
+
+    // Integers as written, fractions truncated toward zero, exponents applied. Numbers out
+    // of the long long range give default_value
+    constexpr long long as_int(long long default_value = 0) const
+    {
+        if(kind() == STBJ_TAPE_TRUE) return 1;
+        if(kind() == STBJ_TAPE_FALSE) return 0;
+        if(kind() != STBJ_TAPE_NUMBER) return default_value;
+        std::string_view number = text_view();
+        if(number.find_first_of("eE") != std::string_view::npos)
+        {
+            double value = as_double();
+            return (value > -9223372036854775808.0 && value < 9223372036854775808.0) ? (long long)value : default_value;
+        }
+        stbj_size i = (number[0] == '-') ? 1 : 0;
+        unsigned long long result = 0;
+        for(; i < number.size() && number[i] >= '0' && number[i] <= '9'; ++i)
+        {
+            if(result > (~0ull - 9) / 10) return default_value;
+            result = 10 * result + (unsigned long long)(number[i] - '0');
+        }
+        if(result > ((number[0] == '-') ? 9223372036854775808ull : 9223372036854775807ull)) return default_value;
+        return (long long)((number[0] == '-') ? 0ull - result : result);
+    }
+
+    // Correctly rounded: mantissas up to 2^53 with exponents up to 22 are exact with one
+    // multiplication or division, the rest go to strtod. At compile time those are scaled
+    // by steps of 1e22 instead and can be an ulp off
+    constexpr double as_double(double default_value = 0.0) const
+    {
+        constexpr double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        if(kind() != STBJ_TAPE_NUMBER) return default_value;
+        std::string_view number = text_view();
+        stbj_size i = (number[0] == '-') ? 1 : 0;
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        bool truncated = false;
+        for(; i < number.size() && number[i] >= '0' && number[i] <= '9'; ++i)
+        {
+            if(mantissa <= (~0ull - 9) / 10) mantissa = 10 * mantissa + (unsigned long long)(number[i] - '0');
+            else { ++exponent; truncated = true; }
+        }
+        if(i < number.size() && number[i] == '.')
+            for(++i; i < number.size() && number[i] >= '0' && number[i] <= '9'; ++i)
+            {
+                if(mantissa <= (~0ull - 9) / 10) { mantissa = 10 * mantissa + (unsigned long long)(number[i] - '0'); --exponent; }
+                else truncated = true;
+            }
+        if(i < number.size() && (number[i] == 'e' || number[i] == 'E'))
+        {
+            int sign = 1, value = 0;
+            if(number[++i] == '-' || number[i] == '+') sign = (number[i++] == '-') ? -1 : 1;
+            for(; i < number.size(); ++i)
+                if(value < 100000) value = 10 * value + (number[i] - '0');
+            exponent += sign * value;
+        }
+
+        double result = (double)mantissa;
+        if(mantissa == 0)
+            result = 0.0;
+        else if(!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+            result = (exponent < 0) ? result / powers[-exponent] : result * powers[exponent];
+        else if(!std::is_constant_evaluated())
+            return std::strtod(text + tape[at].begin, nullptr);
+        else
+        {
+            for(; exponent > 22; exponent -= 22) result *= 1e22;
+            for(; exponent < -22; exponent += 22) result /= 1e22;
+            result = (exponent < 0) ? result / powers[-exponent] : result * powers[exponent];
+        }
+        return (number[0] == '-') ? -result : result;
+    }
+
+    // The generic API on the same text, for arrays and objects
+    stbj_cursor cursor() const
+    {
+        stbj_cursor ret = stbj_load_buffer(text, text_len + 1);
+        if(kind() == STBJ_TAPE_ARRAY || kind() == STBJ_TAPE_OBJECT)
+        {
+            ret.type = (kind() == STBJ_TAPE_ARRAY) ? STBJ_ARRAY : STBJ_OBJECT;
+            ret.cursor = text + tape[at].begin;
+            ret.error = 0;
+        }
+        return ret;
+    }
+};
+
+template<stbj_fixed_text Json> struct stbj_embedded_json
+{
+    static constexpr stbj_size text_len = sizeof(Json.text) - 1;
+
+    static consteval stbj_size count()
+    {
+        stbj__tape_parser parser = { Json.text, text_len, 0, nullptr, 0 };
+        parser.document();
+        return parser.count;
+    }
+
+    static consteval std::array<stbj_tape_entry, count()> build()
+    {
+        std::array<stbj_tape_entry, count()> tape = {};
+        stbj__tape_parser parser = { Json.text, text_len, 0, tape.data(), 0 };
+        parser.document();
+        return tape;
+    }
+
+    static constexpr std::array<stbj_tape_entry, count()> tape = build();
+};
+
+template<stbj_fixed_text Json> inline constexpr stbj_tape_value stbj_embed = { stbj_embedded_json<Json>::tape.data(), Json.text, sizeof(Json.text) - 1, 0 };
+#endif
+
 #endif // STB_JSON_HPP
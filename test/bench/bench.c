@@ -0,0 +1,399 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+// Micro benchmark for every public stbj_* function
+//
+// Each function runs in a tight loop over a controlled input and we report per call
+// and per byte figures. On Linux hardware counters are read with perf_event_open
+// (cycles, instructions, branch-misses, L1D and LLC misses). If the counters are not
+// available (other OS, perf_event_paranoid, VMs) only wall time is reported.
+//
+// Usage: bench [iterations]
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STB_JSON_IMPLEMENTATION
+#include "../../src/stb_json.h"
+
+#define KB 1024
+
+#define NUM_VALUES 1000
+#define NUM_KEYS 256
+#define NUM_RECORDS 64
+#define DEEP_LEVELS 2000
+
+///////////////////////////////////////////////
+//
+//  Hardware counters
+//
+enum counters { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES, NUM_COUNTERS };
+
+static const char* counter_names[NUM_COUNTERS] = { "cycles", "instr", "br-miss", "L1D-miss", "LLC-miss" };
+static int counter_fd[NUM_COUNTERS] = { -1, -1, -1, -1, -1 };
+
+static void open_counters()
+{
+#if defined(__linux__)
+    unsigned int types[NUM_COUNTERS] =
+        { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+    unsigned long long configs[NUM_COUNTERS] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+
+    for(int i = 0; i < NUM_COUNTERS; ++i)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        counter_fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+static void start_counters()
+{
+#if defined(__linux__)
+    for(int i = 0; i < NUM_COUNTERS; ++i)
+    {
+        if(counter_fd[i] < 0) continue;
+        ioctl(counter_fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static void stop_counters(long long* values)
+{
+    for(int i = 0; i < NUM_COUNTERS; ++i)
+    {
+        values[i] = -1;
+#if defined(__linux__)
+        unsigned long long value = 0;
+        if(counter_fd[i] < 0) continue;
+        ioctl(counter_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if(read(counter_fd[i], &value, sizeof(value)) == sizeof(value))
+            values[i] = (long long)value;
+#endif
+    }
+}
+
+static double now_ns()
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+#else
+    return (double)clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+///////////////////////////////////////////////
+//
+//  Controlled inputs
+//
+static char json_ints[16*KB];       // [0,1,2, ... ]
+static char json_doubles[16*KB];    // [0.5,1.5,2.5, ... ]
+static char json_strings[16*KB];    // ["item0","item1", ... ]
+static char json_pairs[16*KB];      // [[0,0],[1,1], ... ]
+static char json_object[16*KB];     // {"key0": 0, "key1": 1, ... }
+static char json_nested[16*KB];     // {"key0": {"v": 0}, "key1": {"v": 1}, ... }
+static char json_records[16*KB];    // [{"id": 100, "name": "item0", "v": 0}, ... ]
+static char json_deep[16*KB];       // [[[[ ... 0 ... ]]]],1]
+
+static void build_inputs()
+{
+    char* p;
+
+    p = json_ints; p += sprintf(p, "[");
+    for(int i = 0; i < NUM_VALUES; ++i) p += sprintf(p, (i) ? ",%i" : "%i", i);
+    sprintf(p, "]");
+
+    p = json_doubles; p += sprintf(p, "[");
+    for(int i = 0; i < NUM_VALUES; ++i) p += sprintf(p, (i) ? ",%i.5" : "%i.5", i);
+    sprintf(p, "]");
+
+    p = json_strings; p += sprintf(p, "[");
+    for(int i = 0; i < NUM_VALUES; ++i) p += sprintf(p, (i) ? ",\"item%i\"" : "\"item%i\"", i);
+    sprintf(p, "]");
+
+    p = json_pairs; p += sprintf(p, "[");
+    for(int i = 0; i < NUM_VALUES; ++i) p += sprintf(p, (i) ? ",[%i,%i]" : "[%i,%i]", i, i);
+    sprintf(p, "]");
+
+    p = json_object; p += sprintf(p, "{");
+    for(int i = 0; i < NUM_KEYS; ++i) p += sprintf(p, (i) ? ", \"key%i\": %i" : "\"key%i\": %i", i, i);
+    sprintf(p, "}");
+
+    p = json_nested; p += sprintf(p, "{");
+    for(int i = 0; i < NUM_KEYS; ++i) p += sprintf(p, (i) ? ", \"key%i\": {\"v\": %i}" : "\"key%i\": {\"v\": %i}", i, i);
+    sprintf(p, "}");
+
+    p = json_records; p += sprintf(p, "[");
+    for(int i = 0; i < NUM_RECORDS; ++i) p += sprintf(p, (i) ? ", {\"id\": %i, \"name\": \"item%02i\", \"v\": %i}" : "{\"id\": %i, \"name\": \"item%02i\", \"v\": %i}", 100 + i, i, i);
+    sprintf(p, "]");
+
+    p = json_deep; p += sprintf(p, "[");
+    for(int i = 0; i < DEEP_LEVELS; ++i) *p++ = '[';
+    *p++ = '0';
+    for(int i = 0; i < DEEP_LEVELS; ++i) *p++ = ']';
+    sprintf(p, ",1]");
+}
+
+///////////////////////////////////////////////
+//
+//  Benchmarks: each one runs a single call over its input
+//
+static volatile double sink = 0.0;
+static char str[64];
+static char last_key[16];
+
+static stbj_cursor load(const char* json) { return stbj_load_buffer(json, (unsigned int)strlen(json) + 1); }
+
+static void bench_load_buffer()     { stbj_cursor c = load(json_object); sink += c.type; }
+static void bench_count_values()    { stbj_cursor c = load(json_ints); sink += stbj_count_values(&c); }
+static void bench_move_cursor_index() { stbj_cursor c = load(json_pairs); stbj_cursor r = stbj_move_cursor_index(&c, NUM_VALUES-1); sink += r.type; }
+static void bench_move_cursor_name(){ stbj_cursor c = load(json_nested); stbj_cursor r = stbj_move_cursor_name(&c, last_key); sink += r.type; }
+static void bench_find_index()      { stbj_cursor c = load(json_ints); sink += (stbj_find_index(&c, NUM_VALUES-1) != 0); }
+static void bench_find_name()       { stbj_cursor c = load(json_object); sink += stbj_find_name(&c, last_key); }
+static void bench_read_int_index()  { stbj_cursor c = load(json_ints); sink += stbj_read_int_index(&c, NUM_VALUES-1, 0); }
+static void bench_read_int_name()   { stbj_cursor c = load(json_object); sink += stbj_read_int_name(&c, last_key, 0); }
+static void bench_read_double_index() { stbj_cursor c = load(json_doubles); sink += stbj_read_double_index(&c, NUM_VALUES-1, 0.0); }
+static void bench_read_double_name(){ stbj_cursor c = load(json_object); sink += stbj_read_double_name(&c, last_key, 0.0); }
+static void bench_read_string_index() { stbj_cursor c = load(json_strings); sink += stbj_read_string_index(&c, NUM_VALUES-1, str, 64, ""); }
+static void bench_read_string_name(){ stbj_cursor c = load(json_object); sink += stbj_read_string_name(&c, last_key, str, 64, ""); }
+
+static stbj_cache_entry cache_entries[256];
+static stbj_cache cache;
+static stbj_cursor cached_nested;
+static void bench_move_cursor_name_cached() { stbj_cursor r = stbj_move_cursor_name(&cached_nested, last_key); sink += stbj_read_int_name(&r, "v", 0); }
+
+// rewrites the last "v" with the same digit and reads it back through the cache
+static unsigned int edit_offset;
+static void bench_apply_edit()
+{
+    char old = json_nested[edit_offset];
+    sink += stbj_apply_edit(&cached_nested, edit_offset, &old, 1, 1, 0);
+    bench_move_cursor_name_cached();
+}
+
+// one read per record with a cold cache, so only the shape entries can hit
+static stbj_cache_entry record_entries[256];
+static stbj_cache record_cache;
+static stbj_cursor records[NUM_RECORDS];
+static void bench_read_records(int shapes)
+{
+    stbj_cache_clear(&record_cache);
+    record_cache.shapes = shapes;
+    for(int i = 0; i < NUM_RECORDS; ++i) sink += stbj_read_int_name(&records[i], "v", 0);
+}
+static void bench_read_records_cached() { bench_read_records(0); }
+static void bench_read_records_shapes() { bench_read_records(1); }
+static stbj_key key_last, key_v_name;
+static void bench_read_int_key()    { stbj_cursor c = load(json_object); sink += stbj_read_int_key(&c, &key_last, 0); }
+static void bench_iterate()
+{
+    stbj_cursor c = load(json_ints);
+    stbj_iterator it;
+    stbj_iterator_init(&c, &it);
+    while(stbj_iterate(&c, &it)) sink += stbj_read_int_index(&it.element, 0, 0);
+}
+static void bench_read_records_key()
+{
+    stbj_cache_clear(&record_cache);
+    record_cache.shapes = 0;
+    for(int i = 0; i < NUM_RECORDS; ++i) sink += stbj_read_int_key(&records[i], &key_v_name, 0);
+}
+
+static long long column_ids[NUM_RECORDS];
+static int column_offsets[NUM_RECORDS + 1];
+static char column_bytes[16*NUM_RECORDS];
+static double column_values[NUM_RECORDS];
+static unsigned char column_validity[3][(NUM_RECORDS + 7) / 8];
+static stbj_column columns[3] =
+{
+    { "id", STBJ_COLUMN_INT64, column_ids, column_validity[0], 0, 0, 0 },
+    { "name", STBJ_COLUMN_STRING, column_offsets, column_validity[1], column_bytes, sizeof(column_bytes), 0 },
+    { "v", STBJ_COLUMN_DOUBLE, column_values, column_validity[2], 0, 0, 0 },
+};
+static void bench_extract_columns() { stbj_cursor c = load(json_records); sink += stbj_extract_columns(&c, columns, 3, NUM_RECORDS); }
+
+static stbj_field_slot field_slots[2*NUM_RECORDS];
+static stbj_field_index field_index;
+static void bench_build_field_index() { stbj_cursor c = load(json_records); sink += stbj_build_field_index(&c, "id", &field_index, field_slots, 2*NUM_RECORDS); }
+static int count_key(const stbj_cursor* member, int depth, void* user_data) { (void)member; (void)depth; (void)user_data; return 0; }
+static void bench_find_all_key() { stbj_cursor c = load(json_nested); sink += stbj_find_all_key(&c, "v", count_key, 0); }
+static char minified[16*KB];
+static void bench_minify() { sink += stbj_minify(json_records, (unsigned int)strlen(json_records) + 1, minified); }
+static void bench_validate_strict() { sink += stbj_validate(json_records, (stbj_size)strlen(json_records) + 1, STBJ_VALIDATE_STRICT); }
+static void bench_validate_lenient() { sink += stbj_validate(json_records, (stbj_size)strlen(json_records) + 1, STBJ_VALIDATE_LENIENT); }
+static char struct_memory[STBJ_STRUCT_INDEX_SIZE(16*KB)];
+static stbj_struct_index struct_index;
+static stbj_cursor indexed_nested;
+static void bench_build_struct_index() { stbj_cursor c = load(json_nested); sink += stbj_build_struct_index(&c, &struct_index, struct_memory, sizeof(struct_memory)); }
+static void bench_find_index_indexed() { sink += (stbj_find_index(&indexed_nested, NUM_KEYS-1) != 0); }
+static void bench_count_values_indexed() { sink += stbj_count_values(&indexed_nested); }
+
+static unsigned long long depth_words[DEEP_LEVELS / 64 + 1];
+static stbj_depth_stack depth_stack = { depth_words, DEEP_LEVELS / 64 + 1 };
+static void bench_count_values_deep() { stbj_cursor c = load(json_deep); stbj_attach_depth_stack(&c, &depth_stack); sink += stbj_count_values(&c); }
+
+static char dict_memory[STBJ_DICT_SIZE(64, 1*KB)];
+static stbj_dict dict;
+static stbj_store_doc store_docs[NUM_RECORDS];
+static stbj_store_entry store_entries[4*NUM_RECORDS];
+static stbj_store store;
+static int key_v;
+static void bench_store_add()
+{
+    stbj_store_init(&store, &dict, store_docs, NUM_RECORDS, store_entries, 4*NUM_RECORDS);
+    for(int i = 0; i < NUM_RECORDS; ++i) sink += stbj_store_add(&store, &records[i]);
+}
+static void bench_store_member()
+{
+    for(int i = 0; i < NUM_RECORDS; ++i) { stbj_cursor m = stbj_store_member(&store, i, key_v); sink += stbj_read_int_index(&m, 0, 0); }
+}
+
+static stbj_slice slices[16];
+static void bench_project() { const char* paths[] = { "key0.v", last_key }; stbj_cursor c = load(json_nested); sink += stbj_project(&c, paths, 2, slices, 16); }
+static void bench_lookup_field_int() { stbj_cursor r = stbj_lookup_field_int(&field_index, 100 + NUM_RECORDS - 1); sink += r.type; }
+
+typedef struct
+{
+    const char* name;
+    void (*fn)();
+    const char* input;
+} benchmark;
+
+static void run(const benchmark* b, int iterations)
+{
+    long long values[NUM_COUNTERS];
+    double bytes = (double)strlen(b->input);
+
+    // warm up caches and branch predictors
+    for(int i = 0; i < iterations / 10 + 1; ++i) b->fn();
+
+    double start = now_ns();
+    start_counters();
+    for(int i = 0; i < iterations; ++i) b->fn();
+    stop_counters(values);
+    double ns = now_ns() - start;
+
+    printf("%-24s %8.0f %10.1f", b->name, bytes, ns / iterations);
+    for(int i = 0; i < NUM_COUNTERS; ++i)
+    {
+        if(values[i] >= 0) printf(" %10.1f", (double)values[i] / iterations);
+        else printf(" %10s", "n/a");
+    }
+
+    if(values[CYCLES] >= 0) printf(" %8.3f", (double)values[CYCLES] / iterations / bytes);
+    else printf(" %8.3f", ns / iterations / bytes);
+
+    if(values[INSTRUCTIONS] >= 0) printf(" %8.3f\n", (double)values[INSTRUCTIONS] / iterations / bytes);
+    else printf(" %8s\n", "n/a");
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 10000;
+    if(iterations <= 0) iterations = 10000;
+
+    build_inputs();
+    sprintf(last_key, "key%i", NUM_KEYS-1);
+    key_last = stbj_make_key(last_key);
+    key_v_name = stbj_make_key("v");
+    stbj_cache_init(&cache, cache_entries, 256);
+    cached_nested = load(json_nested);
+    stbj_attach_cache(&cached_nested, &cache);
+    edit_offset = (unsigned int)(strrchr(json_nested, ':') + 2 - json_nested);
+    indexed_nested = load(json_nested);
+    stbj_build_struct_index(&indexed_nested, &struct_index, struct_memory, sizeof(struct_memory));
+    stbj_attach_struct_index(&indexed_nested, &struct_index);
+
+    stbj_cache_init(&record_cache, record_entries, 256);
+    stbj_cursor record_array = load(json_records);
+    for(int i = 0; i < NUM_RECORDS; ++i)
+    {
+        records[i] = stbj_move_cursor_index(&record_array, i);
+        stbj_attach_cache(&records[i], &record_cache);
+    }
+    stbj_dict_init(&dict, dict_memory, sizeof(dict_memory), 64);
+    bench_store_add();
+    key_v = stbj_key_id(&dict, "v");
+    open_counters();
+
+    benchmark benchmarks[] =
+    {
+        { "stbj_load_buffer", bench_load_buffer, json_object },
+        { "stbj_count_values", bench_count_values, json_ints },
+        { "stbj_move_cursor_index", bench_move_cursor_index, json_pairs },
+        { "stbj_move_cursor_name", bench_move_cursor_name, json_nested },
+        { "stbj_find_index", bench_find_index, json_ints },
+        { "stbj_find_name", bench_find_name, json_object },
+        { "stbj_read_int_index", bench_read_int_index, json_ints },
+        { "stbj_read_int_name", bench_read_int_name, json_object },
+        { "stbj_read_double_index", bench_read_double_index, json_doubles },
+        { "stbj_read_double_name", bench_read_double_name, json_object },
+        { "stbj_read_string_index", bench_read_string_index, json_strings },
+        { "stbj_read_string_name", bench_read_string_name, json_object },
+        { "move_cursor_name+cache", bench_move_cursor_name_cached, json_nested },
+        { "read_int_name x64", bench_read_records_cached, json_records },
+        { "read_int_name x64+shapes", bench_read_records_shapes, json_records },
+        { "stbj_read_int_key", bench_read_int_key, json_object },
+        { "read_int_key x64", bench_read_records_key, json_records },
+        { "stbj_iterate+read_int", bench_iterate, json_ints },
+        { "stbj_extract_columns", bench_extract_columns, json_records },
+        { "stbj_build_field_index", bench_build_field_index, json_records },
+        { "stbj_lookup_field_int", bench_lookup_field_int, json_records },
+        { "stbj_find_all_key", bench_find_all_key, json_nested },
+        { "stbj_minify", bench_minify, json_records },
+        { "stbj_validate strict", bench_validate_strict, json_records },
+        { "stbj_validate lenient", bench_validate_lenient, json_records },
+        { "stbj_project", bench_project, json_nested },
+        { "stbj_apply_edit+cache", bench_apply_edit, json_nested },
+        { "stbj_build_struct_index", bench_build_struct_index, json_nested },
+        { "find_index+struct_index", bench_find_index_indexed, json_nested },
+        { "count_values+struct_index", bench_count_values_indexed, json_nested },
+        { "count_values+depth_stack", bench_count_values_deep, json_deep },
+        { "stbj_store_add x64", bench_store_add, json_records },
+        { "store_member x64", bench_store_member, json_records },
+    };
+
+    printf("Benchmark for STB_JSON lib (%i iterations per function)\n", iterations);
+    if(counter_fd[CYCLES] < 0)
+        printf("Hardware counters not available, per byte figure is ns/byte\n");
+
+    printf("%-24s %8s %10s", "function", "bytes", "ns/call");
+    for(int i = 0; i < NUM_COUNTERS; ++i) printf(" %10s", counter_names[i]);
+    printf(" %8s %8s\n", "cyc/B", "ins/B");
+
+    for(unsigned int i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+        run(&benchmarks[i], iterations);
+
+    printf("cache hits %u misses %u\n", cache.hits, cache.misses);
+
+    return 0;
+}
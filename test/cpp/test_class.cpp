@@ -6,11 +6,47 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define STBJ_ENABLE_THREADS
 #include "../../src/stb_json.hpp"
 
 #define KB 1024
 #define MB 1048576
 
+#if STBJ_CPP17
+struct Event
+{
+    int id = 0;
+    std::string name;
+    std::string_view logo = "-empty-";
+    std::vector<int> subTopicIds;
+};
+STBJ_BIND(Event, id, name, logo, subTopicIds)
+
+struct Counters
+{
+    long long total = 0;
+    long long lowest = 0;
+    unsigned int hits = 0;
+    short retries = 0;
+    bool enabled = false;
+};
+STBJ_BIND(Counters, total, lowest, hits, retries, enabled)
+#endif
+
+#if STBJ_PMR
+// Counts the blocks given out and not back yet
+class counting_resource : public std::pmr::memory_resource
+{
+    public:
+        int blocks = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override { ++blocks; return std::pmr::new_delete_resource()->allocate(bytes, alignment); }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override { --blocks; std::pmr::new_delete_resource()->deallocate(p, bytes, alignment); }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+#endif
+
 int main()
 {
 
@@ -49,8 +85,12 @@ int main()
             json.GetString("type", str, 100);
             printf("-type : %s\n", str);
 
+#if STBJ_CPP20
+            json = json.Get<"geometry"_k, "coordinates"_k>();
+#else
             json = json.MoveCursor("geometry");
             json = json.MoveCursor("coordinates");
+#endif
 
             if(json.HasError()) 
                 printf("ERROR: %s\n", json.GetError());
@@ -115,7 +155,11 @@ int main()
                 json2.GetString("logo", str, 100);
                 printf("Logo: %s\n", str);
 
+#if STBJ_CPP20
+                printf("Id: %i\n", json2.Get<"id", int>());
+#else
                 printf("Id: %i\n", json2.GetInt("id"));
+#endif
 
                 if(json.HasError()) 
                     printf("ERROR: %s\n", json.GetError());
@@ -124,5 +168,127 @@ int main()
         else
             printf("Could not open citm_catalog.json\n");
     }
+
+    {
+        // Parallel for test ---------------
+        printf("PARALLEL FOR ---------------------\n");
+        char numbers[] = "[1, 2, 3, 4, 5, 6, 7, 8]";
+        int values[8] = {0};
+        stb_json json(numbers, sizeof(numbers));
+        stbj_index count = json.ParallelFor([&values](stb_json element, stbj_index index) { values[index] = 10 * element.GetInt(0); }, 4);
+        printf("%i elements: %i %i %i, error: %s\n", (int)count, values[0], values[3], values[7], json.GetError());
+        stbj_pool_shutdown();
+    }
+
+#if STBJ_CPP17
+    {
+        // Struct binding test ---------------
+        printf("BINDING CITM_CATALOG.JSON EVENTS ---------------------\n");
+        FILE* fp = fopen("citm_catalog.json", "rb");
+        if(fp)
+        {
+            unsigned int len = fread(buf, 1, 2*MB, fp);
+            fclose(fp);
+
+            stb_json json = stb_json(buf, len).MoveCursor("events");
+            int count = json.Count();
+            size_t sub_topics = 0;
+
+            for(int a=0; a < count; ++a)
+            {
+                Event event;
+                json.MoveCursor(a).Decode(event);
+                sub_topics += event.subTopicIds.size();
+
+                if(a < 3)
+                    printf("Event %i: %i %s (logo %.*s)\n", a, event.id, event.name.c_str(), (int)event.logo.size(), event.logo.data());
+            }
+
+            printf("%i events with %i sub topics\n", count, (int)sub_topics);
+        }
+        else
+            printf("Could not open citm_catalog.json\n");
+
+        // integers wider than int keep all their digits
+        char counters_json[] = "{\"total\": 5000000000, \"lowest\": -9223372036854775807, \"hits\": 3000000000, \"retries\": 7, \"enabled\": true}";
+        Counters counters;
+        stb_json(counters_json, sizeof(counters_json)).Decode(counters);
+        printf("Counters: %lld %lld %u %i %i\n", counters.total, counters.lowest, counters.hits, (int)counters.retries, (int)counters.enabled);
+    }
+#endif
+
+
+#if STBJ_PMR
+    {
+        // DOM test ---------------
+        printf("MATERIALIZING CITM_CATALOG.JSON ---------------------\n");
+        FILE* fp = fopen("citm_catalog.json", "rb");
+        if(fp)
+        {
+            unsigned int len = fread(buf, 1, 2*MB, fp);
+            fclose(fp);
+
+            std::pmr::monotonic_buffer_resource arena;
+            stbj_dom dom = stb_json(buf, len).Materialize(&arena);
+            if(dom.HasError())
+                printf("ERROR: %s\n", dom.GetError());
+            else
+            {
+                stbj_index events = dom.Find(0, "events");
+                printf("%i nodes, %i events\n", (int)dom.nodes.size(), (int)dom.nodes[events].children.size());
+
+                stbj_size first = dom.nodes[events].children[0];
+                std::string_view name = dom.nodes[dom.Find(first, "name")].text;
+                printf("Event %.*s: %lld %.*s\n", (int)dom.nodes[first].name.size(), dom.nodes[first].name.data(),
+                        dom.GetInt(dom.Find(first, "id")), (int)name.size(), name.data());
+            }
+        }
+        else
+            printf("Could not open citm_catalog.json\n");
+
+        // assigning a tree gives back the blocks of the old one
+        counting_resource counting;
+        char wide[] = "[[1, 2, 3, 4, 5, 6], [7, 8, 9, 10, 11]]";
+        char narrow[] = "{\"a\": [1, 2.5e3, -0.25, 0]}";
+        stbj_dom tree = stb_json(wide, sizeof(wide)).Materialize(&counting);
+        int wide_blocks = counting.blocks;
+        tree = stb_json(narrow, sizeof(narrow)).Materialize(&counting);
+        printf("Blocks: %i, then %i (%i nodes, a[1] = %.1f)\n", wide_blocks, counting.blocks, (int)tree.nodes.size(),
+               tree.GetDouble(tree.nodes[tree.Find(0, "a")].children[1]));
+        tree = stbj_dom(&counting);
+        printf("Blocks after clearing: %i\n", counting.blocks);
+
+        // numbers follow the JSON grammar
+        const char* numbers[] = { "[1abc]", "[01]", "[-]", "[1.]", "[.5]", "[1e]", "[--1]", "[+1]", "[0, -0.5e-3, 10E+2]" };
+        for(const char* number : numbers)
+            printf("%s: error %i\n", number, stb_json(number, (stbj_size)strlen(number) + 1).Materialize(&counting).error);
+    }
+#endif
+
+#if STBJ_CPP20
+    {
+        // Embedded JSON test ----------------
+        printf("EMBEDDED JSON ---------------------\n");
+        constexpr auto config = stbj_embed<R"({"threads": 4, "name": "bench", "limits": {"rps": 100.5, "ports": [8080, 8081]}})">;
+        static_assert(config["threads"].as_int() == 4);
+        static_assert(config["limits"]["ports"].count() == 2);
+        static_assert(config["missing"].as_int(5) == 5 && config["name"].as_int(5) == 5 && config["limits"].as_int(-1) == -1);
+        constexpr auto flags = stbj_embed<R"([true, false, null])">;
+        static_assert(flags[0].as_int(5) == 1 && flags[1].as_int(5) == 0 && flags[2].as_int(5) == 5);
+        constexpr auto numbers = stbj_embed<R"([0.3, 1e-7, 2.2250738585072014e-308, 1e3, -2.5E+1, 1e30, 123456789012345678901234567890])">;
+        static_assert(numbers[0].as_double() == 0.3 && numbers[1].as_double() == 1e-7);
+        static_assert(numbers[2].as_double() == 2.2250738585072014e-308);
+        static_assert(numbers[3].as_int() == 1000 && numbers[4].as_int() == -25 && numbers[4].as_double() == -25.0);
+        static_assert(numbers[5].as_int(-1) == -1 && numbers[6].as_int(-1) == -1);
+
+        printf("Threads: %lld\n", config["threads"].as_int());
+        printf("Name: %.*s\n", (int)config["name"].as_string().size(), config["name"].as_string().data());
+        printf("Rps: %0.1f\n", config["limits"]["rps"].as_double());
+        printf("Numbers: %.17g %.17g %.17g %.17g\n", numbers[0].as_double(), numbers[1].as_double(), numbers[2].as_double(), numbers[6].as_double());
+
+        stb_json ports = stb_json(config["limits"]["ports"].cursor());
+        printf("Ports: %i %i\n", ports.GetInt(0), ports.GetInt(1));
+    }
+#endif
 }
 
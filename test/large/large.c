@@ -0,0 +1,113 @@
+// Checks STBJ_LARGE_DOCUMENTS on a document bigger than 4 GB
+//
+// The document is an array of 2.3e9 zeros followed by {"last": 7}, about 4.6 GB. It is
+// written to _file_ on the first run and mapped read only, so it needs the disk space
+// but not the memory. The structural index checks need about 1.2 GB more of memory.
+// Not part of the normal test run, it takes a while.
+//
+// Usage: large <file>
+
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STBJ_LARGE_DOCUMENTS
+#define STB_JSON_IMPLEMENTATION
+#include "../../src/stb_json.h"
+
+#define NUM_ZEROS 2300000000ull
+#define CHUNK (1 << 20)
+
+static int checks_failed = 0;
+#define CHECK(x) do { if(!(x)) { printf("CHECK FAILED %s:%i: %s\n", __FILE__, __LINE__, #x); ++checks_failed; } } while(0)
+
+static int write_document(const char* path)
+{
+    static char chunk[CHUNK];
+    FILE* fp = fopen(path, "wb");
+    if(!fp)
+        return 0;
+
+    for(int i = 0; i < CHUNK; i += 2) { chunk[i] = '0'; chunk[i + 1] = ','; }
+
+    unsigned long long left = NUM_ZEROS * 2;
+    int ok = (fputc('[', fp) != EOF);
+    while(ok && left > 0)
+    {
+        size_t size = (left < CHUNK) ? (size_t)left : CHUNK;
+        ok = (fwrite(chunk, 1, size, fp) == size);
+        left -= size;
+    }
+    ok = ok && (fputs("{\"last\": 7}]", fp) != EOF);
+    return (fclose(fp) == 0) && ok;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage: large <file>\n");
+        return 1;
+    }
+
+    struct stat info;
+    if(stat(argv[1], &info) != 0)
+    {
+        printf("Writing %s ...\n", argv[1]);
+        if(!write_document(argv[1]) || stat(argv[1], &info) != 0)
+        {
+            printf("Could not write %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    const char* buffer = (fd >= 0) ? (const char*)mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : 0;
+    if(!buffer || buffer == MAP_FAILED)
+    {
+        printf("Could not map %s\n", argv[1]);
+        return 1;
+    }
+
+    stbj_size len = (stbj_size)info.st_size;
+    printf("Document of %zu bytes\n", len);
+    CHECK(len > 0xffffffffull);
+
+    // plain scans
+    stbj_cursor context = stbj_load_buffer(buffer, len);
+    stbj_index count = stbj_count_values(&context);
+    CHECK(count == (stbj_index)NUM_ZEROS + 1 && context.error == 0);
+
+    const char* last = stbj_find_index(&context, (stbj_index)NUM_ZEROS);
+    CHECK(last != 0 && (stbj_size)(last - buffer) > 0xffffffffull && *last == '{');
+
+    stbj_cursor object = stbj_move_cursor_index(&context, (stbj_index)NUM_ZEROS);
+    CHECK(object.type == STBJ_OBJECT && stbj_read_int_name(&object, "last", -1) == 7);
+    CHECK(stbj_read_int_index(&context, (stbj_index)NUM_ZEROS - 1, -1) == 0);
+    CHECK(stbj_validate(buffer, len, STBJ_VALIDATE_LENIENT) == -1);
+
+    // the same through a structural index
+    stbj_size memory_size = STBJ_STRUCT_INDEX_SIZE(len);
+    void* memory = malloc(memory_size);
+    stbj_struct_index index;
+    CHECK(memory && stbj_build_struct_index(&context, &index, memory, memory_size) > 0);
+    if(memory && context.error == 0)
+    {
+        stbj_attach_struct_index(&context, &index);
+        CHECK(stbj_count_values(&context) == count);
+        CHECK(stbj_find_index(&context, (stbj_index)NUM_ZEROS) == last);
+    }
+
+    free(memory);
+    munmap((void*)buffer, (size_t)info.st_size);
+    close(fd);
+
+    printf("%i checks failed\n", checks_failed);
+    return checks_failed != 0;
+}
@@ -9,16 +9,213 @@
 #define KB 1024
 #define MB 1048576
 
+#define STBJ_ENABLE_THREADS
 #define STB_JSON_IMPLEMENTATION
 #include "../src/stb_json.h"
 
-char buffer0[] = "{\"name\": \"John\", \"married\": true, \"height\": 181.55, \"eye colors\": [3,3] }";
+// Checks print the failed condition and make the test return non zero
+static int checks_failed = 0;
+#define CHECK(x) do { if(!(x)) { printf("CHECK FAILED %s:%i: %s\n", __FILE__, __LINE__, #x); ++checks_failed; } } while(0)
 
-char buffer1[] = "{\"name\": \"  John the Great\", \"last name\" : a e o  u   , \"age\":1234567890123  , \"height\": \"  -345.1234567\", \"eye colors\": [\"green\",\"blue\"] }";
-char buffer2[] = "[0,1,true,false,   null  ,    true , tnull, 3, 3true, false4, null 45]";
-char buffer3[] = "[      -5,-665.65.367     ,  +7   ,-8, 1.1, 23.45, 444444.0000, 0.12345, .3141621   ]";
+// Buffers have room for STBJ_PADDING zero bytes, so they also work in padded mode (test_padded)
+char buffer0[256] = "{\"name\": \"John\", \"married\": true, \"height\": 181.55, \"eye colors\": [3,3] }";
+
+char buffer1[256] = "{\"name\": \"  John the Great\", \"last name\" : a e o  u   , \"age\":1234567890123  , \"height\": \"  -345.1234567\", \"eye colors\": [\"green\",\"blue\"] }";
+char buffer2[256] = "[0,1,true,false,   null  ,    true , tnull, 3, 3true, false4, null 45]";
+char buffer3[256] = "[      -5,-665.65.367     ,  +7   ,-8, 1.1, 23.45, 444444.0000, 0.12345, .3141621   ]";
 //char buffer4[] = "[[1,2,3],["a","b",[]], {"a":34},{}, [], 4, {}]";
-char buffer4[] = "[\"34\", [1,2,[{},{}]], 4, {},true,4,\"false\",\"null\",  null]";
+char buffer4[256] = "[\"34\", [1,2,[{},{}]], 4, {},true,4,\"false\",\"null\",  null]";
+
+#ifdef STBJ_ENABLE_TRACE
+// Trace callback, keeps the exit events (test_trace)
+typedef struct
+{
+    stbj_trace_event events[32];
+    int count;
+} trace_log;
+
+static void log_trace(const stbj_trace_event* event, void* user_data)
+{
+    trace_log* log = (trace_log*)user_data;
+    if(event->leave && log->count < 32)
+        log->events[log->count++] = *event;
+}
+
+// The exit event of func in log, or 0
+static const stbj_trace_event* find_trace(const trace_log* log, enum stbj_trace_func func)
+{
+    for(int i = 0; i < log->count; ++i)
+        if(log->events[i].func == func)
+            return &log->events[i];
+    return 0;
+}
+#endif
+
+// Parallel for callbacks, each element writes its own slot so no locking is needed
+static void store_int(const stbj_cursor* element, stbj_index index, void* user_data)
+{
+    int error;
+    ((int*)user_data)[index] = stbj_read_int_index_r(element, 0, -1, &error);
+}
+
+static void sum_inner(const stbj_cursor* element, stbj_index index, void* user_data)
+{
+    int error;
+    int values[8] = {0};
+    stbj_cursor inner = stbj_move_cursor_index_r(element, 0, &error);
+    stbj_index count = stbj_parallel_for_r(&inner, store_int, values, 0, &error); // nested call
+    ((int*)user_data)[index] = (count == 2) ? values[0] + values[1] : -1;
+}
+
+static void store_event_id(const stbj_cursor* element, stbj_index index, void* user_data)
+{
+    int error;
+    stbj_cursor event = stbj_move_cursor_index_r(element, 0, &error);
+    ((int*)user_data)[index] = stbj_read_int_name_r(&event, "id", -1, &error);
+}
+
+// Key search callback, records the values and depths it is called with
+typedef struct { int values[8]; int depths[8]; int count; int stop_after; } found_keys;
+
+static int record_key(const stbj_cursor* member, int depth, void* user_data)
+{
+    found_keys* found = (found_keys*)user_data;
+    int error;
+    if(found->count < 8)
+    {
+        found->values[found->count] = stbj_read_int_index_r(member, 0, -1, &error);
+        found->depths[found->count] = depth;
+    }
+    return ++found->count == found->stop_after;
+}
+
+// Joins the slices of a projection into out, returns the length
+static int join_slices(const stbj_slice* slices, int num_slices, char* out, int out_size)
+{
+    int len = 0;
+    for(int i = 0; i < num_slices; ++i)
+    {
+        if(len + (int)slices[i].len >= out_size) return -1;
+        memcpy(out + len, slices[i].base, slices[i].len);
+        len += (int)slices[i].len;
+    }
+    out[len] = 0;
+    return len;
+}
+
+// Reads a few values everywhere in the edit test document into out
+static void read_edited(stbj_cursor* root, int* out)
+{
+    char str[16];
+    stbj_cursor a = stbj_move_cursor_name(root, "a");
+    stbj_cursor y = stbj_move_cursor_name(&a, "y");
+    stbj_cursor b = stbj_move_cursor_name(root, "b");
+    stbj_cursor c = stbj_move_cursor_name(root, "c");
+    stbj_cursor c1 = stbj_move_cursor_index(&c, 1);
+    out[0] = stbj_read_int_name(&a, "x", -1);
+    out[1] = stbj_read_int_index(&y, 0, -1);
+    out[2] = stbj_read_int_index(&y, 2, -1);
+    out[3] = stbj_read_int_name(&b, "x", -1);
+    out[4] = stbj_read_string_name(&b, "s", str, 16, "");
+    out[5] = stbj_read_int_name(&c1, "v", -1);
+    out[6] = stbj_read_int_name(root, "d", -1);
+    out[7] = (int)stbj_find_name(root, "d");
+}
+
+// Replaces the first _from_ in doc with _to_ and tells the cache of root about it
+static int edit_document(char* doc, stbj_cursor* root, const char* from, const char* to, stbj_cursor* container)
+{
+    char old_bytes[32];
+    char* at = strstr(doc, from);
+    size_t old_len = strlen(from);
+    size_t new_len = strlen(to);
+    memcpy(old_bytes, at, old_len);
+    memmove(at + new_len, at + old_len, strlen(at + old_len) + 1);
+    memcpy(at, to, new_len);
+    return stbj_apply_edit(root, (stbj_size)(at - doc), old_bytes, (stbj_size)old_len, (stbj_size)new_len, container);
+}
+
+// Compares the _key functions for name with the _name and _index ones, _r versions
+// included. Returns mismatches
+static int compare_key(stbj_cursor* context, const char* name)
+{
+    char str[64], str2[64];
+    int error;
+    stbj_key key = stbj_make_key(name);
+    stbj_index position = stbj_find_name(context, name);
+    int name_error = context->error;
+    int mismatches = 0;
+
+    mismatches += (stbj_find_key(context, &key) != position || context->error != name_error);
+    mismatches += (stbj_find_key_r(context, &key, &error) != position || error != name_error);
+
+    stbj_cursor by_key = stbj_move_cursor_key(context, &key);
+    stbj_cursor by_name = stbj_move_cursor_name(context, name);
+    mismatches += (by_key.type != by_name.type || by_key.cursor != by_name.cursor || by_key.error != by_name.error);
+    int name_r_error;
+    by_name = stbj_move_cursor_name_r(context, name, &name_r_error);
+    by_key = stbj_move_cursor_key_r(context, &key, &error);
+    mismatches += (by_key.type != by_name.type || by_key.cursor != by_name.cursor || by_key.error != by_name.error || error != name_r_error);
+    if(position >= 0)
+        mismatches += (by_key.cursor != stbj_move_cursor_index(context, position).cursor);
+
+    int value = stbj_read_int_name(context, name, -7);
+    mismatches += (stbj_read_int_key(context, &key, -7) != value);
+    mismatches += (stbj_read_int_key_r(context, &key, -7, &error) != value || error != context->error);
+    double number = stbj_read_double_name(context, name, -7.0);
+    mismatches += (stbj_read_double_key(context, &key, -7.0) != number);
+    mismatches += (stbj_read_double_key_r(context, &key, -7.0, &error) != number || error != context->error);
+    if(position >= 0)
+        mismatches += (stbj_read_int_index(context, position, -7) != value);
+
+    stbj_read_string_name(context, name, str, sizeof(str), "-");
+    memcpy(str2, str, sizeof(str));
+    stbj_read_string_key(context, &key, str2, sizeof(str2), "-");
+    mismatches += (strcmp(str, str2) != 0);
+    stbj_read_string_key_r(context, &key, str2, sizeof(str2), "-", &error);
+    mismatches += (strcmp(str, str2) != 0 || error != context->error);
+    return mismatches;
+}
+
+// Compares every container under plain with the same one read through a structural
+// index. Big arrays are sampled, the plain scan of element i costs i. Returns mismatches
+static int compare_indexed(stbj_cursor* indexed, stbj_cursor* plain)
+{
+    stbj_index count = stbj_count_values(plain);
+    if(stbj_count_values(indexed) != count || indexed->error != plain->error)
+        return 1;
+
+    int mismatches = 0;
+    for(stbj_index i = 0; i < count; i = (count <= 64 || i < 16 || i >= count - 16) ? i + 1 : i + count / 16)
+    {
+        if(stbj_find_index(indexed, i) != stbj_find_index(plain, i))
+            return mismatches + 1;
+
+        stbj_cursor indexed_child = stbj_move_cursor_index(indexed, i);
+        stbj_cursor plain_child = stbj_move_cursor_index(plain, i);
+        if(plain_child.type != STBJ_ERROR)
+            mismatches += compare_indexed(&indexed_child, &plain_child);
+    }
+    return mismatches;
+}
+
+static unsigned long long struct_index_memory[STBJ_STRUCT_INDEX_SIZE(3*MB) / 8 + 1];
+
+// Nests _levels_ arrays inside the root array
+static void make_deep(char* doc, int levels)
+{
+    int len = 0;
+    for(int i = 0; i <= levels; ++i) doc[len++] = '[';
+    for(int i = 0; i <= levels; ++i) doc[len++] = ']';
+    doc[len] = 0;
+}
+
+static char deep[8*KB + STBJ_PADDING];
+static unsigned long long deep_words[64];
+
+static char numbers[128*KB];
+static char minified[2*MB + STBJ_PADDING];
+static int values[20000];
 
 int main()
 {
@@ -33,7 +230,7 @@ int main()
 		}
 		else
 		{
-			printf("Found %i values at current cursor\n", stbj_count_values(&cursor));
+			printf("Found %i values at current cursor\n", (int)stbj_count_values(&cursor));
 
 			char buf[10];
 			stbj_read_string_name(&cursor, "name", buf, 10, "not found");
@@ -83,27 +280,27 @@ int main()
 
         stbj_read_string_name(&context, "name", buf, 10, "error");
         printf("tag \"name\" found at %i is \"%s\"\n", 
-                stbj_find_name(&context, "name"), 
+                (int)stbj_find_name(&context, "name"), 
                 buf);
 
         stbj_read_string_name(&context, "last name", buf, 10, "error");
         printf("tag \"last name\" found at %i is \"%s\"\n", 
-                stbj_find_name(&context, "last name"),
+                (int)stbj_find_name(&context, "last name"),
                 buf);
 
         printf("tag \"age\" found at %i is %i\n", 
-                stbj_find_name(&context, "age"),
+                (int)stbj_find_name(&context, "age"),
                 stbj_read_int_name(&context, "age", 0));
 
         printf("tag \"height\" found at %i is %f\n", 
-                stbj_find_name(&context, "height"),
+                (int)stbj_find_name(&context, "height"),
                 stbj_read_double_name(&context, "height", 0.0));
 
         printf("tag \"error\" found at %i\n", 
-                stbj_find_name(&context, "error"));
+                (int)stbj_find_name(&context, "error"));
 
         printf("tag \"eye colors\" found at %i ...\n",
-                stbj_find_name(&context, "eye colors"));
+                (int)stbj_find_name(&context, "eye colors"));
 
         {
             stbj_cursor eye_context = stbj_move_cursor_name(&context, "eye colors");
@@ -186,6 +383,618 @@ int main()
         }
     }
 
+    {
+        // Validation test -------------------
+        char* buffers[] = { buffer0, buffer1, buffer2, buffer3, buffer4 };
+
+        for(int i = 0; i < 5; ++i)
+            printf("buffer%i validation: strict %i lenient %i\n", i,
+                    (int)stbj_validate(buffers[i], strlen(buffers[i])+1, STBJ_VALIDATE_STRICT),
+                    (int)stbj_validate(buffers[i], strlen(buffers[i])+1, STBJ_VALIDATE_LENIENT));
+
+        // offset of the first bad byte in strict mode, lenient only fails the unclosed string
+        const char* invalid[] = { "[01]", "[1.]", "[\"\\x\"]", "[\"\xff\"]", "[1] x", "{\"a\":}", "[\"abc", "[tru]", "[1,]",
+                                  "[\"\xC0\xAF\"]", "[\"\xED\xA0\x80\"]" };
+        int offsets[] = { 2, 1, 3, 2, 4, 5, 5, 1, 3, 2, 2 };
+        for(int i = 0; i < 11; ++i)
+        {
+            stbj_size len = (stbj_size)strlen(invalid[i]) + 1;
+            CHECK(stbj_validate(invalid[i], len, STBJ_VALIDATE_STRICT) == offsets[i]);
+            CHECK(stbj_validate(invalid[i], len, STBJ_VALIDATE_LENIENT) == ((i == 6) ? 5 : -1));
+        }
+
+        // what strict validation accepts the readers read
+        char exponents[] = "[1e5, -0.5E-3, 2.5e+1, 1E400, 0.3, 2.2250738585072014e-308]";
+        stbj_cursor context = stbj_load_buffer(exponents, sizeof(exponents));
+        CHECK(stbj_validate(exponents, sizeof(exponents), STBJ_VALIDATE_STRICT) == -1);
+        CHECK(stbj_read_double_index(&context, 0, 0.0) == 1e5 && stbj_read_double_index(&context, 1, 0.0) == -0.5E-3);
+        CHECK(stbj_read_int_index(&context, 0, 0) == 100000 && stbj_read_int_index(&context, 2, 0) == 25);
+        CHECK(stbj_read_double_index(&context, 4, 0.0) == 0.3 && stbj_read_double_index(&context, 5, 0.0) == 2.2250738585072014e-308);
+        CHECK(stbj_read_int_index(&context, 3, -1) == -1 && context.error == 7);
+        CHECK(stbj_read_double_index(&context, 3, 0.0) > 1.7976931348623157e308 && context.error == 0);
+
+        char bad_exponents[] = "[1e, 1e+, 1ex, 1.5e2.5]";
+        context = stbj_load_buffer(bad_exponents, sizeof(bad_exponents));
+        for(int i = 0; i < 4; ++i)
+            CHECK(stbj_read_double_index(&context, i, -1.0) == -1.0 && context.error == 7);
+    }
+
+    {
+        // Reentrant API test ----------------
+        // errors go to the out parameter and the cursor is never written
+        printf("REENTRANT API ---------------------\n");
+        char doc[256] = "{\"i\": 5, \"d\": 2.5, \"s\": \"str\", \"arr\": [10, 20], \"bad\": 1.2.3, \"o\": {\"p\": 1}}";
+        char str[16];
+        int error = -1;
+
+        stbj_cursor context = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+        context.error = 99; // must survive every _r call
+        stbj_cursor before = context;
+
+        CHECK(stbj_count_values_r(&context, &error) == 6 && error == 0);
+        CHECK(stbj_find_name_r(&context, "arr", &error) == 3 && error == 0);
+        CHECK(stbj_find_name_r(&context, "zz", &error) == -1 && error == 5); // reached the '}'
+        CHECK(stbj_find_index_r(&context, 6, &error) == 0 && error == 3);
+        CHECK(stbj_read_int_name_r(&context, "i", -1, &error) == 5 && error == 0);
+        CHECK(stbj_read_int_name_r(&context, "zz", -1, &error) == -1 && error == 5);
+        CHECK(stbj_read_int_name_r(&context, "s", -1, &error) == -1 && error == 7);
+        CHECK(stbj_read_int_name_r(&context, "bad", -1, &error) == -1 && error == 7);
+        CHECK(stbj_read_double_name_r(&context, "d", -1.0, &error) == 2.5 && error == 0);
+        CHECK(stbj_read_double_name_r(&context, "bad", -1.0, &error) == -1.0 && error == 7);
+        CHECK(stbj_read_string_name_r(&context, "s", str, 16, "?", &error) == 3 && strcmp(str, "str") == 0 && error == 0);
+        CHECK(stbj_read_string_name_r(&context, "arr", str, 16, "?", &error) == 0 && error == 8);
+        CHECK(stbj_read_string_name_r(&context, "zz", str, 16, "?", &error) == 0 && strcmp(str, "?") == 0 && error == 5);
+
+        stbj_cursor arr = stbj_move_cursor_name_r(&context, "arr", &error);
+        CHECK(arr.type == STBJ_ARRAY && arr.error == 0 && error == 0);
+        CHECK(stbj_read_int_index_r(&arr, 1, -1, &error) == 20 && error == 0);
+        CHECK(stbj_read_int_index_r(&arr, 2, -1, &error) == -1 && error == 3);
+        CHECK(stbj_find_name_r(&arr, "p", &error) == -1 && error == 6);
+
+        stbj_cursor missing = stbj_move_cursor_name_r(&context, "zz", &error);
+        CHECK(missing.type == STBJ_ERROR && missing.error == 2 && error == 5);
+        stbj_cursor value = stbj_move_cursor_name_r(&context, "i", &error);
+        CHECK(value.type == STBJ_ERROR && error == 0); // not an array or object
+
+        CHECK(context.type == before.type && context.cursor == before.cursor && context.error == 99);
+
+        // the cache is only used by the non reentrant functions
+        stbj_cache cache;
+        stbj_cache_entry entries[16];
+        stbj_cache_init(&cache, entries, 16);
+        stbj_attach_cache(&context, &cache);
+        CHECK(stbj_read_int_name_r(&context, "i", -1, &error) == 5 && stbj_find_index_r(&context, 2, &error) != 0);
+        CHECK(stbj_move_cursor_name_r(&context, "o", &error).cache == &cache);
+        CHECK(cache.hits == 0 && cache.misses == 0);
+        CHECK(stbj_read_int_name(&context, "i", -1) == 5 && stbj_read_int_name(&context, "i", -1) == 5);
+        CHECK(cache.hits > 0 && cache.misses > 0);
+        context.cache = 0;
+
+        // mismatched and unclosed brackets
+        char mismatch[] = "[1, [2}, 3]";
+        char nested[] = "{\"a\": {\"b\": [1}, \"c\": 2}";
+        char unclosed[] = "[1, 2";
+        context = stbj_load_buffer(mismatch, sizeof(mismatch));
+        CHECK(stbj_count_values_r(&context, &error) == -1 && error == 5);
+        context = stbj_load_buffer(nested, sizeof(nested));
+        CHECK(stbj_find_name_r(&context, "c", &error) == -1 && error == 5);
+        context = stbj_load_buffer(unclosed, sizeof(unclosed));
+        CHECK(stbj_count_values_r(&context, &error) == -1 && error == 3);
+        context = stbj_load_buffer("  x", 4);
+        CHECK(context.type == STBJ_ERROR && context.error == 1);
+
+        CHECK(strcmp(stbj_get_error_string(0), "No error") == 0);
+        CHECK(strcmp(stbj_get_error_string(6), "Context must be of type Object") == 0);
+        CHECK(strcmp(stbj_get_error_string(99), "Unknown error") == 0);
+        printf("done\n");
+    }
+
+    {
+        // Columns test ----------------------
+        printf("COLUMNS ---------------------\n");
+        char doc[256] = "[{\"i\": 1, \"d\": 1.5, \"s\": \"one\"}, {\"i\": null, \"s\": 2, \"d\": \"x\"}, {}, {\"i\": -9007199254740993, \"s\": \"three\", \"d\": -2000.25}]";
+        long long ints[4];
+        double doubles[4];
+        int offsets[5];
+        char bytes[16];
+        unsigned char validity[3][1];
+        stbj_column columns[3] =
+        {
+            { "i", STBJ_COLUMN_INT64, ints, validity[0], 0, 0, 0 },
+            { "d", STBJ_COLUMN_DOUBLE, doubles, validity[1], 0, 0, 0 },
+            { "s", STBJ_COLUMN_STRING, offsets, validity[2], bytes, sizeof(bytes), 0 },
+        };
+
+        stbj_cursor context = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+        CHECK(stbj_extract_columns(&context, columns, 3, 4) == 4 && context.error == 0);
+        CHECK(validity[0][0] == 0x9 && ints[0] == 1 && ints[3] == -9007199254740993LL);
+        CHECK(validity[1][0] == 0x9 && doubles[0] == 1.5 && doubles[3] == -2000.25);
+        CHECK(validity[2][0] == 0xb && offsets[0] == 0 && offsets[4] == 9 && memcmp(bytes, "one2three", 9) == 0);
+        CHECK(columns[0].null_count == 2 && columns[1].null_count == 2 && columns[2].null_count == 1);
+
+        // rows stop at max_rows, strings that don't fit are null
+        CHECK(stbj_extract_columns(&context, columns, 3, 2) == 2);
+        columns[2].bytes_size = 6;
+        CHECK(stbj_extract_columns(&context, columns, 3, 4) == 4 && context.error == 9);
+        CHECK(validity[2][0] == 0x3 && columns[2].null_count == 2);
+        printf("done\n");
+    }
+
+    {
+        // Key search test -------------------
+        printf("KEY SEARCH ---------------------\n");
+        // keys inside strings and keys that only start with "k" don't count
+        char doc[256] = "{\"k\": 1, \"a\": {\"k\": 2, \"s\": \"\\\"k\\\": 9\", \"b\": [{\"k\": 3}, {\"kk\": 4}]}, \"k \": 5, \"z\": [[{\"k\": 6}]]}";
+        char mismatch[] = "{\"a\": [1}, \"k\": 2}";
+        found_keys found = { {0}, {0}, 0, 0 };
+
+        stbj_cursor context = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+        CHECK(stbj_find_all_key(&context, "k", record_key, &found) == 4 && context.error == 0);
+        CHECK(found.values[0] == 1 && found.values[1] == 2 && found.values[2] == 3 && found.values[3] == 6);
+        CHECK(found.depths[0] == 0 && found.depths[1] == 1 && found.depths[2] == 3 && found.depths[3] == 3);
+
+        found.count = 0;
+        found.stop_after = 2;
+        CHECK(stbj_find_all_key(&context, "k", record_key, &found) == 2 && found.count == 2);
+        CHECK(stbj_find_all_key(&context, "missing", record_key, &found) == 0);
+
+        context = stbj_load_buffer(mismatch, sizeof(mismatch));
+        CHECK(stbj_find_all_key(&context, "k", record_key, &found) == -1 && context.error == 5);
+        printf("done\n");
+    }
+
+    {
+        // Keys test -------------------------
+        printf("KEYS ---------------------\n");
+        // string values equal to the key, names that share the first 8 bytes, nested names
+        char doc[256] = "{\"s\": \"k\", \"k\": 5, \"long_name_a\": 2.5, \"long_name_b\": \"x\", \"n\": {\"deep\": 9}, \"arr\": [\"k\", \"n\"], \"z\":7}";
+        char array[] = "[\"k\", 1]";
+        char mismatch[] = "{\"a\": [1}, \"k\": 2}";
+        const char* names[] = { "k", "s", "long_name_a", "long_name_b", "long_name", "long_name_ab", "n", "deep", "arr", "z", "missing", "" };
+        stbj_cursor context = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+        for(int i = 0; i < 12; ++i)
+            CHECK(compare_key(&context, names[i]) == 0);
+
+        stbj_key k = stbj_make_key("k");
+        stbj_key deep = stbj_make_key("deep");
+        CHECK(stbj_find_key(&context, &k) == 1 && stbj_read_int_key(&context, &k, -1) == 5);
+        CHECK(stbj_find_key(&context, &deep) == -1 && context.error == 5);  // reached the '}' of context
+        stbj_cursor nested = stbj_move_cursor_name(&context, "n");
+        CHECK(stbj_read_int_key(&nested, &deep, -1) == 9);
+
+        // with a cache the key and name lookups share the entries
+        stbj_cache cache;
+        stbj_cache_entry entries[16];
+        stbj_cache_init(&cache, entries, 16);
+        stbj_attach_cache(&context, &cache);
+        CHECK(stbj_find_name(&context, "z") == 6);
+        unsigned int hits = cache.hits;
+        stbj_key z = stbj_make_key("z");
+        CHECK(stbj_find_key(&context, &z) == 6 && cache.hits == hits + 1);
+        CHECK(compare_key(&context, "long_name_b") == 0 && compare_key(&context, "missing") == 0);
+
+        context = stbj_load_buffer(array, sizeof(array));
+        CHECK(compare_key(&context, "k") == 0 && stbj_find_key(&context, &k) == -1 && context.error == 6);
+        context = stbj_load_buffer(mismatch, sizeof(mismatch));
+        CHECK(compare_key(&context, "k") == 0 && stbj_find_key(&context, &k) == -1 && context.error == 5);
+        printf("done\n");
+    }
+
+    {
+        // Minify test -----------------------
+        printf("MINIFY ---------------------\n");
+        char doc[256] = "{ \"a b\" : [ 1 ,\t2 ],\n \"s\": \"x \\\" y\\\\\" ,\r\n \"e\" : { } }";
+        const char* expected = "{\"a b\":[1,2],\"s\":\"x \\\" y\\\\\",\"e\":{}}";
+        char out[256];
+
+        stbj_size len = stbj_minify(doc, (stbj_size)strlen(doc), out);
+        CHECK(len == (stbj_size)strlen(expected) && memcmp(out, expected, len) == 0);
+        len = stbj_minify_in_place(doc, (stbj_size)strlen(doc));
+        CHECK(len == (stbj_size)strlen(expected) && memcmp(doc, expected, len) == 0);
+
+        // an unclosed string keeps everything after the quote
+        char unclosed[] = "[\"abc  , ]";
+        CHECK(stbj_minify(unclosed, (stbj_size)strlen(unclosed), out) == (stbj_size)strlen(unclosed));
+        printf("done\n");
+    }
+
+    {
+        // Projection test -------------------
+        printf("PROJECTION ---------------------\n");
+        char doc[256] = "{\"id\": 7, \"meta\": {\"a\": 1, \"b\": {\"c\": [1, 2]}, \"d\": \"x\"}, \"list\": [{\"a\": 1}], \"name\": \"n\"}";
+        const char* paths[] = { "name", "meta.b.c", "id", "list.a", "missing", "meta.d" };
+        const char* whole[] = { "meta" };
+        const char* none[] = { "missing" };
+        stbj_slice slices[32];
+        char out[256 + STBJ_PADDING];
+
+        // members keep the document order, arrays can't be walked into
+        stbj_cursor context = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+        int num_slices = stbj_project(&context, paths, 6, slices, 32);
+        int len = join_slices(slices, num_slices, out, 256);
+        CHECK(num_slices > 0 && context.error == 0);
+        CHECK(strcmp(out, "{\"id\": 7,\"meta\": {\"b\": {\"c\": [1, 2]},\"d\": \"x\"},\"name\": \"n\"}") == 0);
+        CHECK(stbj_validate(out, (stbj_size)len + 1, STBJ_VALIDATE_STRICT) == -1);
+
+        stbj_cursor projected = stbj_load_buffer(out, (stbj_size)len + 1);
+        stbj_cursor meta = stbj_move_cursor_name(&projected, "meta");
+        CHECK(stbj_read_int_name(&projected, "id", -1) == 7 && stbj_find_name(&meta, "a") == -1);
+
+        num_slices = stbj_project(&context, whole, 1, slices, 32);
+        join_slices(slices, num_slices, out, 256);
+        CHECK(strcmp(out, "{\"meta\": {\"a\": 1, \"b\": {\"c\": [1, 2]}, \"d\": \"x\"}}") == 0);
+        num_slices = stbj_project(&context, none, 1, slices, 32);
+        join_slices(slices, num_slices, out, 256);
+        CHECK(strcmp(out, "{}") == 0);
+        CHECK(stbj_project(&context, paths, 6, slices, 2) == -1 && context.error == 9);
+
+        // a dot inside a name is escaped, the plain path only walks into objects
+        char dotted[] = "{\"a.b\": 5, \"a\": {\"b\": 6}}";
+        const char* escaped[] = { "a\\.b" };
+        const char* nested[] = { "a.b" };
+        context = stbj_load_buffer(dotted, sizeof(dotted));
+        num_slices = stbj_project(&context, escaped, 1, slices, 32);
+        join_slices(slices, num_slices, out, 256);
+        CHECK(strcmp(out, "{\"a.b\": 5}") == 0);
+        num_slices = stbj_project(&context, nested, 1, slices, 32);
+        join_slices(slices, num_slices, out, 256);
+        CHECK(strcmp(out, "{\"a\": {\"b\": 6}}") == 0);
+
+        // paths deeper than the projection can walk are an error, not an empty result
+        char deep_path[80] = "a";
+        for(int i = 1; i < 33; ++i)
+            strcat(deep_path, ".a");
+        const char* too_deep[] = { "a", deep_path };
+        CHECK(stbj_project(&context, too_deep, 2, slices, 32) == -1 && context.error == 10);
+        deep_path[strlen(deep_path) - 2] = 0;
+        CHECK(stbj_project(&context, too_deep, 2, slices, 32) > 0 && context.error == 0);
+
+        // names only match whole member names, never the end of a string or a value
+        char names[] = "{\"v\": \"id\", \"name\": \"Meneses\", \"xname\": 1, \"s\": 2, \"id\": 3}";
+        context = stbj_load_buffer(names, sizeof(names));
+        CHECK(stbj_find_name(&context, "s") == 3 && stbj_find_name(&context, "name") == 1 && stbj_find_name(&context, "id") == 4);
+        printf("done\n");
+    }
+
+    {
+        // Edits test ------------------------
+        // after each edit reads through the cache must match reads without it
+        printf("EDITS ---------------------\n");
+        char doc[256] = "{\"a\": {\"x\": 1, \"y\": [10, 20, 30]}, \"b\": {\"x\": 2, \"s\": \"str\"}, \"c\": [{\"v\": 5}, {\"v\": 6}], \"d\": 7}";
+        stbj_cache cache;
+        stbj_cache_entry entries[64];
+        stbj_cache_init(&cache, entries, 64);
+
+        stbj_cursor root = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+        stbj_attach_cache(&root, &cache);
+        stbj_cursor container;
+        int cached[8], plain[8];
+        read_edited(&root, cached);
+
+        const char* edits[][2] =
+        {
+            { "\"x\": 1", "\"x\": 12345" },        // wider
+            { "[10, 20", "[1, 20" },               // narrower
+            { "\"str\"", "\"\"" },                  // empty string
+            { "{\"v\": 5}", "{\"v\": [5, 5, 5]}" }, // new nested array
+            { "\"x\": 2", "\"x\": 2, \"w\": 0" },   // new member
+            { "\"a\": ", "\"e\": 0, \"a\": " },     // new member before everything
+        };
+        int expected[][8] =
+        {
+            { 12345, 10, 30, 2, 3, 6, 7, 3 },
+            { 12345, 1, 30, 2, 3, 6, 7, 3 },
+            { 12345, 1, 30, 2, 1, 6, 7, 3 },
+            { 12345, 1, 30, 2, 1, 6, 7, 3 },
+            { 12345, 1, 30, 2, 1, 6, 7, 3 },
+            { 12345, 1, 30, 2, 1, 6, 7, 4 },
+        };
+
+        for(int i = 0; i < 6; ++i)
+        {
+            CHECK(edit_document(doc, &root, edits[i][0], edits[i][1], &container) == 0);
+            CHECK(root.len == (stbj_size)strlen(doc) + 1 && stbj_validate(doc, root.len, STBJ_VALIDATE_STRICT) == -1);
+            unsigned int hits = cache.hits;
+            read_edited(&root, cached);
+            CHECK(cache.hits > hits);
+            stbj_cursor uncached = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+            read_edited(&uncached, plain);
+            CHECK(memcmp(cached, plain, sizeof(plain)) == 0 && memcmp(cached, expected[i], sizeof(plain)) == 0);
+        }
+
+        // the container is the smallest object or array around the edit
+        CHECK(edit_document(doc, &root, "20", "21", &container) == 0);
+        CHECK(container.type == STBJ_ARRAY && *container.cursor == '[' && stbj_read_int_index(&container, 1, -1) == 21);
+
+        // an unclosed bracket changes the whole document, the cache is cleared
+        CHECK(edit_document(doc, &root, "\"d\": 7", "\"d\": [7", &container) == 1);
+        int used = 0;
+        for(int i = 0; i < 64; ++i)
+            used += (entries[i].found != 0);
+        CHECK(used == 0);
+        printf("done\n");
+    }
+
+    {
+        // Structural index test -------------
+        printf("STRUCTURAL INDEX ---------------------\n");
+        // unbalanced brackets, commas, colons and escaped quotes inside strings
+        const char* docs[] = { "[1, [2, 3], {\"a\": [], \"b\": {}}, \"[x]\", [[[]]], \"q\\\"]\"]", "{\"a\": [1, 2}", "[1, {\"b\": 2]]", "[1, 2",
+                               "[\"[\"]", "{\"a\": \"[\", \"b\": 2}", "[\"a\\\",b\", 1, 2]", "{\"a\\\"b\": 1, \"b\": 2}",
+                               "{\"a:b\": [1, \"}\"], \"c\": {\"d\": \"]\\\\\"}, \"e\": [\"{\", {\"f\": \",\"}]}" };
+        int errors[] = { 0, 5, 4, 3, 0, 0, 0, 0, 0 }; // the error names the closing bracket that was found
+        char doc[128];
+        for(int i = 0; i < 9; ++i)
+        {
+            strcpy(doc, docs[i]);
+            stbj_cursor context = stbj_load_buffer(doc, (stbj_size)strlen(doc) + 1);
+            stbj_cursor indexed = context;
+            stbj_struct_index index;
+            stbj_size used = stbj_build_struct_index(&indexed, &index, struct_index_memory, sizeof(struct_index_memory));
+            CHECK(indexed.error == errors[i] && (used > 0) == (errors[i] == 0));
+            if(used == 0) continue;
+
+            stbj_attach_struct_index(&indexed, &index);
+            CHECK(compare_indexed(&indexed, &context) == 0);
+        }
+
+        // the plain scans skip strings whole
+        char open_bracket[] = "[\"[\"]";
+        char bracket_value[] = "{\"a\": \"[\", \"b\": 2}";
+        char escaped_value[] = "[\"a\\\",b\", 1, 2]";
+        char escaped_name[] = "{\"a\\\"b\": 1, \"b\": 2, \"c:d\": 3}";
+        char unclosed[] = "{\"a\": 1, \"b\": \"[1, 2}";
+        stbj_key b = stbj_make_key("b");
+        stbj_cursor context = stbj_load_buffer(open_bracket, sizeof(open_bracket));
+        CHECK(stbj_count_values(&context) == 1 && context.error == 0);
+        context = stbj_load_buffer(bracket_value, sizeof(bracket_value));
+        CHECK(stbj_read_int_name(&context, "b", -1) == 2 && context.error == 0);
+        CHECK(stbj_read_int_key(&context, &b, -1) == 2 && context.error == 0);
+        context = stbj_load_buffer(escaped_value, sizeof(escaped_value));
+        CHECK(stbj_count_values(&context) == 3 && stbj_read_int_index(&context, 2, -1) == 2);
+        context = stbj_load_buffer(escaped_name, sizeof(escaped_name));
+        CHECK(stbj_find_name(&context, "b") == 1 && stbj_read_int_name(&context, "b", -1) == 2);
+        CHECK(stbj_find_key(&context, &b) == 1 && stbj_read_int_name(&context, "c:d", -1) == 3);
+        CHECK(stbj_read_int_index(&context, 2, -1) == 3 && stbj_count_values(&context) == 3);
+        context = stbj_load_buffer(unclosed, sizeof(unclosed));
+        CHECK(stbj_count_values(&context) == -1 && context.error == 3);
+        CHECK(stbj_find_name(&context, "c") == -1 && context.error == 8);
+        CHECK(stbj_find_key(&context, &b) == 1 && stbj_find_index(&context, 2) == 0 && context.error == 3);
+        printf("done\n");
+    }
+
+    {
+        // Depth test ------------------------
+        printf("DEPTH ---------------------\n");
+        int error;
+        make_deep(deep, STBJ_MAX_DEPTH);
+        stbj_cursor context = stbj_load_buffer(deep, (stbj_size)strlen(deep) + 1);
+        CHECK(stbj_count_values(&context) == 1 && context.error == 0);
+
+        make_deep(deep, STBJ_MAX_DEPTH + 1);
+        context = stbj_load_buffer(deep, (stbj_size)strlen(deep) + 1);
+        CHECK(stbj_count_values(&context) == -1 && context.error == 10);
+
+        // stbj_validate has no cursor, the root is one of its levels
+        make_deep(deep, STBJ_MAX_DEPTH - 1);
+        CHECK(stbj_validate(deep, (stbj_size)strlen(deep) + 1, STBJ_VALIDATE_STRICT) == -1);
+        make_deep(deep, STBJ_MAX_DEPTH);
+        CHECK(stbj_validate(deep, (stbj_size)strlen(deep) + 1, STBJ_VALIDATE_STRICT) != -1);
+
+        // attached words hold 64 levels each, cursors moved from context keep them
+        stbj_depth_stack stack = { deep_words, 64 };
+        make_deep(deep, 64 * 64);
+        context = stbj_load_buffer(deep, (stbj_size)strlen(deep) + 1);
+        stbj_attach_depth_stack(&context, &stack);
+        CHECK(stbj_count_values(&context) == 1 && context.error == 0);
+        stbj_cursor inner = stbj_move_cursor_index(&context, 0);
+        CHECK(inner.depth_stack == &stack && stbj_count_values(&inner) == 1 && inner.error == 0);
+
+        // the reentrant functions don't write the words, they stop at STBJ_MAX_DEPTH
+        CHECK(stbj_count_values_r(&context, &error) == -1 && error == 10);
+        CHECK(stbj_move_cursor_index_r(&context, 0, &error).depth_stack == &stack);
+
+        make_deep(deep, 64 * 64 + 1);
+        context = stbj_load_buffer(deep, (stbj_size)strlen(deep) + 1);
+        stbj_attach_depth_stack(&context, &stack);
+        CHECK(stbj_count_values(&context) == -1 && context.error == 10);
+        printf("done\n");
+    }
+
+    {
+        // Lookup cache test -----------------
+        printf("LOOKUP CACHE ---------------------\n");
+        // the "v" of the second record is at the same offset as the first one, but nested
+        char records[256] = "[{\"a\":1,\"b\":2,\"v\":3},{\"q\":{\"rr\":1,\"v\":5},\"v\":6},{\"a\":7,\"b\":8,\"v\":9},{\"a\":10,\"v\":11}]";
+        stbj_cache cache;
+        stbj_cache_entry entries[64];
+        stbj_cache_init(&cache, entries, 64);
+        cache.shapes = 1;
+
+        stbj_cursor array = stbj_load_buffer(records, (stbj_size)strlen(records) + 1);
+        stbj_attach_cache(&array, &cache);
+        stbj_key v = stbj_make_key("v");
+        int expected[] = {3, 6, 9, 11};
+        int positions[] = {2, 1, 2, 1};
+
+        // twice, the second time everything comes from the cache
+        for(int pass = 0; pass < 2; ++pass)
+            for(int i = 0; i < 4; ++i)
+            {
+                stbj_cursor record = stbj_move_cursor_index(&array, i);
+                CHECK(stbj_read_int_name(&record, "v", -1) == expected[i]);
+                CHECK(stbj_find_name(&record, "v") == positions[i]);
+                CHECK(stbj_read_int_index(&record, positions[i], -1) == expected[i]);
+                CHECK(stbj_read_int_key(&record, &v, -1) == expected[i]);
+                CHECK(stbj_count_values(&record) == positions[i] + 1);
+            }
+
+        // a shape hit: same keys at the same offsets as the first record
+        stbj_cache_clear(&cache);
+        stbj_cursor first = stbj_move_cursor_index(&array, 0);
+        stbj_cursor third = stbj_move_cursor_index(&array, 2);
+        CHECK(stbj_read_int_name(&first, "v", -1) == 3);
+        unsigned int hits = cache.hits;
+        CHECK(stbj_find_name(&third, "v") == 2 && cache.hits == hits + 1);
+        printf("done\n");
+    }
+
+    {
+        // Padded buffers test ---------------
+        // Same checks in both builds, so padded mode reads the same as the default one
+        printf("PADDED BUFFERS ---------------------\n");
+        const char src[] = "{\"a\": [1, 22, 333], \"b\": \"text\", \"c\": {\"d\": -4.5}, \"e\": true}";
+        stbj_size len = (stbj_size)strlen(src);
+        char padded[sizeof(src) + STBJ_PADDING];
+
+        memset(padded, 'x', sizeof(padded));
+        CHECK(stbj_pad_buffer(padded, STBJ_PADDED_SIZE(len) - 1, src, len) == 0);
+        CHECK(stbj_pad_buffer(padded, sizeof(padded), src, len) == len);
+        CHECK(memcmp(padded, src, len) == 0);
+        for(int i = 0; i < STBJ_PADDING; ++i)
+            CHECK(padded[len + i] == 0);
+
+        // in place, over what was there
+        memset(padded + len, 'x', STBJ_PADDING);
+        CHECK(stbj_pad_buffer(padded, sizeof(padded), padded, len) == len);
+        CHECK(memcmp(padded, src, len) == 0 && padded[len] == 0 && padded[len + STBJ_PADDING - 1] == 0);
+
+        char str[16];
+        stbj_cursor context = stbj_load_buffer(padded, len + 1);
+        CHECK(stbj_count_values(&context) == 4);
+        CHECK(stbj_find_name(&context, "e") == 3);
+        CHECK(stbj_read_int_name(&context, "e", 0) == 1);
+        CHECK(stbj_read_string_name(&context, "b", str, 16, "") == 4 && strcmp(str, "text") == 0);
+
+        stbj_cursor a = stbj_move_cursor_name(&context, "a");
+        CHECK(a.type == STBJ_ARRAY && stbj_count_values(&a) == 3);
+        CHECK(stbj_read_int_index(&a, 2, 0) == 333);
+        CHECK(stbj_read_int_index(&a, 3, -1) == -1 && a.error == 3);
+
+        stbj_cursor c = stbj_move_cursor_name(&context, "c");
+        CHECK(stbj_read_double_name(&c, "d", 0.0) == -4.5);
+        CHECK(stbj_validate(padded, len + 1, STBJ_VALIDATE_STRICT) == -1);
+
+        // unclosed documents stop at the '\0' of the padding
+        padded[len - 1] = ' ';
+        context = stbj_load_buffer(padded, len + 1);
+        CHECK(stbj_count_values(&context) == -1 && context.error == 3);
+        CHECK(stbj_validate(padded, len + 1, STBJ_VALIDATE_STRICT) != -1);
+        printf("done\n");
+    }
+
+    {
+        // Document store test -----------------
+        printf("DOCUMENT STORE ---------------------\n");
+        char str[16], str2[16];
+        static char dict_memory[STBJ_DICT_SIZE(8, 64)];
+        stbj_dict dict;
+        stbj_store_doc docs[3];
+        stbj_store_entry members[8];
+        stbj_store store;
+        CHECK(stbj_dict_init(&dict, dict_memory, sizeof(dict_memory), 8));
+        CHECK(!stbj_dict_init(&dict, dict_memory, 16, 8));
+        stbj_dict_init(&dict, dict_memory, sizeof(dict_memory), 8);
+        stbj_store_init(&store, &dict, docs, 3, members, 8);
+
+        char first[] = "{\"a\": 1, \"b\": \"two\", \"c\": [3, 4]}";
+        char second[] = "{ \"c\" : 5.5 , \"a\" : \"a\" }";
+        stbj_cursor documents[2] = { stbj_load_buffer(first, sizeof(first)), stbj_load_buffer(second, sizeof(second)) };
+        CHECK(stbj_store_add(&store, &documents[0]) == 0 && documents[0].error == 0);
+        CHECK(stbj_store_add(&store, &documents[1]) == 1 && documents[1].error == 0);
+        CHECK(dict.num_keys == 3 && store.num_members == 5);
+
+        // members read like the _name functions, missing ones give error 2
+        const char* names[] = { "a", "b", "c" };
+        int same_members = 1;
+        for(int doc = 0; doc < 2; ++doc)
+        {
+            for(int k = 0; k < 3; ++k)
+            {
+                stbj_cursor member = stbj_store_member(&store, doc, stbj_key_id(&dict, names[k]));
+                stbj_cursor named = stbj_move_cursor_name(&documents[doc], names[k]);
+                same_members &= (member.error == 2) == (named.error == 2);
+                if(member.error != 0)
+                {
+                    same_members &= (member.error == 2 && member.type == STBJ_ERROR);
+                    continue;
+                }
+                stbj_read_string_index(&member, 0, str, sizeof(str), "-");
+                stbj_read_string_name(&documents[doc], names[k], str2, sizeof(str2), "-");
+                same_members &= (strcmp(str, str2) == 0);
+                same_members &= (stbj_read_double_index(&member, 0, -1.0) == stbj_read_double_name(&documents[doc], names[k], -1.0));
+                stbj_cursor value = stbj_move_cursor_index(&member, 0);
+                same_members &= (value.type == named.type && value.cursor == named.cursor && value.error == named.error);
+            }
+        }
+        CHECK(same_members);
+        CHECK(stbj_store_member(&store, 1, stbj_key_id(&dict, "b")).error == 2);
+        CHECK(stbj_store_member(&store, 0, stbj_key_id(&dict, "missing")).error == 2);
+        CHECK(stbj_store_document(&store, 1).cursor == second);
+
+        // a full store or dictionary gives error 9 and keeps what was added before
+        char many[] = "{\"d\": 1, \"e\": 2, \"f\": 3, \"g\": 4}";
+        char array[] = "[1, 2]";
+        stbj_cursor context = stbj_load_buffer(many, sizeof(many));
+        CHECK(stbj_store_add(&store, &context) == -1 && context.error == 9);
+        CHECK(store.num_docs == 2 && store.num_members == 5);
+        stbj_cursor member = stbj_store_member(&store, 0, stbj_key_id(&dict, "a"));
+        CHECK(stbj_read_int_index(&member, 0, -1) == 1);
+        context = stbj_load_buffer(array, sizeof(array));
+        CHECK(stbj_store_add(&store, &context) == -1 && context.error == 6);
+        context = stbj_load_buffer(first, sizeof(first));
+        CHECK(stbj_store_add(&store, &context) == 2 && context.error == 0);
+        CHECK(stbj_store_add(&store, &context) == -1 && context.error == 9);
+        printf("done\n");
+    }
+
+    {
+        // Parallel for test -----------------
+        printf("PARALLEL FOR ---------------------\n");
+        int error;
+        int n = 0;
+        numbers[n++] = '[';
+        for(int i = 0; i < 20000; ++i)
+            n += sprintf(numbers + n, (i == 0) ? "%i" : ", %i", i);
+        numbers[n++] = ']';
+        numbers[n] = 0;
+
+        stbj_cursor context = stbj_load_buffer(numbers, n + 1);
+        int threads[] = {1, 3, 0, 0};   // the last runs reuse the pool threads
+        for(int t = 0; t < 4; ++t)
+        {
+            memset(values, 0xff, sizeof(values));
+            CHECK(stbj_parallel_for_r(&context, store_int, values, threads[t], &error) == 20000 && error == 0);
+            int ordered = 1;
+            for(int i = 0; i < 20000; ++i)
+                ordered &= (values[i] == i);
+            CHECK(ordered);
+        }
+
+        char nested[] = "[[1, 2], [3, 4], [5, 6], [7, 8], [9, 10], [11, 12]]";
+        context = stbj_load_buffer(nested, sizeof(nested));
+        CHECK(stbj_parallel_for(&context, sum_inner, values, 4) == 6 && context.error == 0);
+        CHECK(values[0] == 3 && values[3] == 15 && values[5] == 23);
+
+        char empty[] = "[ ]";
+        char empty_object[] = "{}";
+        char mismatch[] = "[1, 2}";
+        context = stbj_load_buffer(empty, sizeof(empty));
+        CHECK(stbj_parallel_for(&context, store_int, 0, 4) == 0 && context.error == 0);
+        context = stbj_load_buffer(empty_object, sizeof(empty_object));
+        CHECK(stbj_parallel_for(&context, store_int, 0, 4) == 0 && context.error == 0);
+        context = stbj_load_buffer(mismatch, sizeof(mismatch));
+        CHECK(stbj_parallel_for(&context, store_int, values, 4) == -1 && context.error == 3);
+
+        // the threads are joined and started again by the next call
+        stbj_pool_shutdown();
+        stbj_pool_shutdown();
+        context = stbj_load_buffer(nested, sizeof(nested));
+        CHECK(stbj_parallel_for(&context, sum_inner, values, 4) == 6 && values[5] == 23);
+        stbj_pool_shutdown();
+        printf("done\n");
+    }
+
     char buf[3*MB];
     {
 
@@ -199,6 +1008,7 @@ int main()
             int len = fread(buf, 1, 3*MB, fp);
             printf("canada.json opened correctly, size %i\n", len);
             fclose(fp);
+            stbj_pad_buffer(buf, sizeof(buf), buf, len);
 
             stbj_cursor context = stbj_load_buffer(buf, len);
             int count = stbj_count_values(&context);
@@ -214,6 +1024,13 @@ int main()
 
             printf("Type : %s\n", str);
 
+            // the structural index finds the same values as the plain scan
+            stbj_struct_index index;
+            stbj_cursor indexed = context;
+            CHECK(stbj_build_struct_index(&indexed, &index, struct_index_memory, sizeof(struct_index_memory)) > 0);
+            stbj_attach_struct_index(&indexed, &index);
+            CHECK(compare_indexed(&indexed, &context) == 0);
+
             if(stbj_any_error(&context)) 
                 printf("ERROR: %s\n", stbj_get_last_error(&context));
 
@@ -260,7 +1077,7 @@ int main()
 
     {
         // Huge JSON test 2 ---------------------
-        char str[100];
+        char str[100], str2[100];
 
         printf("READING CITM_CATALOG.JSON ---------------------\n");
         FILE* fp = fopen("citm_catalog.json", "rb");
@@ -269,6 +1086,7 @@ int main()
             int len = fread(buf, 1, 2*MB, fp);
             printf("citm_catalog.json opened correctly, size %i\n", len);
             fclose(fp);
+            stbj_pad_buffer(buf, sizeof(buf), buf, len);
 
             stbj_cursor context = stbj_load_buffer(buf, len);
             int count = stbj_count_values(&context);
@@ -277,6 +1095,14 @@ int main()
             if(stbj_any_error(&context)) 
                 printf("ERROR: %s\n", stbj_get_last_error(&context));
 
+            // the structural index finds the same values as the plain scan
+            stbj_struct_index index;
+            stbj_cursor indexed = context;
+            CHECK(stbj_build_struct_index(&indexed, &index, struct_index_memory, sizeof(struct_index_memory)) > 0);
+            stbj_attach_struct_index(&indexed, &index);
+            CHECK(compare_indexed(&indexed, &context) == 0);
+            CHECK(stbj_build_struct_index(&indexed, &index, struct_index_memory, 1024) == 0 && indexed.error == 9);
+
             context = stbj_move_cursor_name(&context, "events");
             count = stbj_count_values(&context);
             printf("Num element on events: %i\n", count);
@@ -303,9 +1129,237 @@ int main()
                     printf("ERROR: %s\n", stbj_get_last_error(&context));
 
             }
+
+            // events is an object, parallel for calls fn once per member
+            memset(values, 0, sizeof(values));
+            CHECK(count > 0 && count < 20000);
+            CHECK(stbj_parallel_for(&context, store_event_id, values, 0) == count);
+            int same_ids = 1;
+            for(int a = 0; a < count; ++a)
+            {
+                stbj_cursor event = stbj_move_cursor_index(&context, a);
+                same_ids &= (values[a] == stbj_read_int_name(&event, "id", -2));
+            }
+            CHECK(same_ids);
+
+            // the _key functions read every event like the _name ones
+            const char* event_names[] = { "id", "name", "logo", "subTopicIds", "subjectCode", "missing" };
+            int key_mismatches = 0;
+            for(int a = 0; a < count; ++a)
+            {
+                stbj_cursor event = stbj_move_cursor_index(&context, a);
+                for(int i = 0; i < 6; ++i)
+                    key_mismatches += compare_key(&event, event_names[i]);
+            }
+            CHECK(key_mismatches == 0);
+
+            // columns hold the same values the _name functions read
+            stbj_cursor root = stbj_load_buffer(buf, len);
+            stbj_cursor performances = stbj_move_cursor_name(&root, "performances");
+            static long long ids[256], starts[256];
+            static double event_ids[256];
+            static int venue_offsets[257], name_offsets[257];
+            static char venue_bytes[8*KB], name_bytes[64];
+            static unsigned char validity[5][32];
+            stbj_column columns[5] =
+            {
+                { "id", STBJ_COLUMN_INT64, ids, validity[0], 0, 0, 0 },
+                { "start", STBJ_COLUMN_INT64, starts, validity[1], 0, 0, 0 },
+                { "eventId", STBJ_COLUMN_DOUBLE, event_ids, validity[2], 0, 0, 0 },
+                { "venueCode", STBJ_COLUMN_STRING, venue_offsets, validity[3], venue_bytes, sizeof(venue_bytes), 0 },
+                { "name", STBJ_COLUMN_STRING, name_offsets, validity[4], name_bytes, sizeof(name_bytes), 0 },
+            };
+            int rows = stbj_extract_columns(&performances, columns, 5, 256);
+            CHECK(rows == stbj_count_values(&performances) && performances.error == 0);
+            CHECK(columns[0].null_count == 0 && columns[3].null_count == 0 && columns[4].null_count == rows); // names are null
+
+            int same_columns = 1;
+            for(int row = 0; row < rows && row < 256; ++row)
+            {
+                stbj_cursor performance = stbj_move_cursor_index(&performances, row);
+                stbj_read_string_name(&performance, "venueCode", str, 100, "");
+                int venue_len = venue_offsets[row + 1] - venue_offsets[row];
+                same_columns &= (validity[0][row / 8] >> (row % 8)) & (validity[3][row / 8] >> (row % 8)) & 1;
+                same_columns &= !((validity[4][row / 8] >> (row % 8)) & 1);
+                same_columns &= (ids[row] == stbj_read_int_name(&performance, "id", -1));
+                same_columns &= (starts[row] == (long long)stbj_read_double_name(&performance, "start", -1.0));
+                same_columns &= (event_ids[row] == stbj_read_double_name(&performance, "eventId", -1.0));
+                same_columns &= (venue_len == (int)strlen(str) && memcmp(venue_bytes + venue_offsets[row], str, venue_len) == 0);
+            }
+            CHECK(same_columns);
+
+            // the field index finds every performance by id, without touching the cache
+            static stbj_field_slot slots[512];
+            stbj_field_index by_id;
+            stbj_cache cache;
+            stbj_cache_entry entries[64];
+            stbj_cache_init(&cache, entries, 64);
+            stbj_attach_cache(&performances, &cache);
+            CHECK(stbj_build_field_index(&performances, "id", &by_id, slots, 512) == rows && performances.error == 0);
+            CHECK(by_id.context.cache == 0 && by_id.context.depth_stack == 0);
+
+            int same_objects = 1;
+            for(int row = 0; row < rows && row < 256; ++row)
+            {
+                stbj_cursor found = stbj_lookup_field_int(&by_id, ids[row]);
+                same_objects &= (found.error == 0 && found.cursor == stbj_move_cursor_index(&performances, row).cursor);
+            }
+            CHECK(same_objects);
+            performances.cache = 0;
+            unsigned int lookups = cache.hits + cache.misses;
+            CHECK(stbj_lookup_field(&by_id, "339887544").cursor == stbj_move_cursor_index(&performances, 0).cursor);
+            CHECK(stbj_lookup_field(&by_id, "1").error == 2);
+            CHECK(cache.hits + cache.misses == lookups);
+
+            // the store finds the same members as the _name functions
+            static char dict_memory[STBJ_DICT_SIZE(64, 1*KB)];
+            static stbj_store_doc store_docs[256];
+            static stbj_store_entry store_members[256*16];
+            stbj_dict dict;
+            stbj_store store;
+            stbj_dict_init(&dict, dict_memory, sizeof(dict_memory), 64);
+            stbj_store_init(&store, &dict, store_docs, 256, store_members, 256*16);
+            int same_stored = 1;
+            for(int row = 0; row < rows && row < 256; ++row)
+            {
+                stbj_cursor performance = stbj_move_cursor_index(&performances, row);
+                same_stored &= (stbj_store_add(&store, &performance) == row && performance.error == 0);
+            }
+            int key_id = stbj_key_id(&dict, "id"), key_start = stbj_key_id(&dict, "start"), key_venue = stbj_key_id(&dict, "venueCode");
+            for(int row = 0; row < store.num_docs; ++row)
+            {
+                stbj_cursor performance = stbj_move_cursor_index(&performances, row);
+                stbj_cursor id = stbj_store_member(&store, row, key_id);
+                stbj_cursor start = stbj_store_member(&store, row, key_start);
+                stbj_cursor venue = stbj_store_member(&store, row, key_venue);
+                stbj_read_string_index(&venue, 0, str, 100, "");
+                stbj_read_string_name(&performance, "venueCode", str2, 100, "-");
+                same_stored &= (stbj_read_int_index(&id, 0, -1) == stbj_read_int_name(&performance, "id", -2));
+                same_stored &= (stbj_read_double_index(&start, 0, -1.0) == stbj_read_double_name(&performance, "start", -2.0));
+                same_stored &= (strcmp(str, str2) == 0);
+                same_stored &= (stbj_store_member(&store, row, stbj_key_id(&dict, "areaId")).error == 2);
+            }
+            CHECK(same_stored && store.num_docs == rows && key_id >= 0 && key_venue >= 0);
+
+            // every event and performance has an id, every area of a seat category an areaId
+            found_keys found = { {0}, {0}, 0, 0 };
+            CHECK(stbj_find_all_key(&root, "id", record_key, &found) == count + rows && root.error == 0);
+
+            int areas = 0;
+            for(int row = 0; row < rows; ++row)
+            {
+                stbj_cursor performance = stbj_move_cursor_index(&performances, row);
+                stbj_cursor categories = stbj_move_cursor_name(&performance, "seatCategories");
+                int num_categories = stbj_count_values(&categories);
+                for(int i = 0; i < num_categories; ++i)
+                {
+                    stbj_cursor category = stbj_move_cursor_index(&categories, i);
+                    stbj_cursor category_areas = stbj_move_cursor_name(&category, "areas");
+                    areas += stbj_count_values(&category_areas);
+                }
+            }
+            found.count = 0;
+            CHECK(stbj_find_all_key(&root, "areaId", record_key, &found) == areas && areas > 0);
+
+            // the minified document reads the same
+            stbj_size minified_len = stbj_minify(buf, (stbj_size)len, minified);
+            stbj_pad_buffer(minified, sizeof(minified), minified, minified_len);
+            CHECK(minified_len < (stbj_size)len && stbj_validate(minified, minified_len, STBJ_VALIDATE_STRICT) == -1);
+            stbj_cursor small_root = stbj_load_buffer(minified, minified_len);
+            stbj_cursor small_performances = stbj_move_cursor_name(&small_root, "performances");
+            CHECK(stbj_count_values(&small_root) == stbj_count_values(&root));
+            CHECK(stbj_count_values(&small_performances) == rows);
+
+            int same_reads = 1;
+            for(int row = 0; row < rows; ++row)
+            {
+                stbj_cursor performance = stbj_move_cursor_index(&small_performances, row);
+                stbj_read_string_name(&performance, "venueCode", str, 100, "");
+                same_reads &= (ids[row] == stbj_read_int_name(&performance, "id", -1));
+                same_reads &= (memcmp(venue_bytes + venue_offsets[row], str, strlen(str)) == 0);
+            }
+            CHECK(same_reads);
+
+            // projected events read like the original ones
+            const char* event_paths[] = { "name", "id", "subTopicIds" };
+            stbj_slice slices[16];
+            char projected[1024];
+            int same_projections = 1;
+            for(int a = 0; a < count; ++a)
+            {
+                stbj_cursor event = stbj_move_cursor_index(&context, a);
+                int num_slices = stbj_project(&event, event_paths, 3, slices, 16);
+                int projected_len = join_slices(slices, num_slices, projected, 1024 - STBJ_PADDING);
+                same_projections &= (num_slices > 0 && projected_len > 0);
+                if(projected_len <= 0) continue;
+
+                stbj_pad_buffer(projected, sizeof(projected), projected, (stbj_size)projected_len + 1);
+                stbj_cursor small_event = stbj_load_buffer(projected, (stbj_size)projected_len + 1);
+                stbj_cursor topics = stbj_move_cursor_name(&small_event, "subTopicIds");
+                stbj_cursor original_topics = stbj_move_cursor_name(&event, "subTopicIds");
+                same_projections &= (stbj_count_values(&small_event) == 3);
+                same_projections &= (stbj_read_int_name(&small_event, "id", -1) == stbj_read_int_name(&event, "id", -2));
+                same_projections &= (stbj_count_values(&topics) == stbj_count_values(&original_topics));
+                same_projections &= (stbj_read_int_index(&topics, 0, -1) == stbj_read_int_index(&original_topics, 0, -1));
+            }
+            CHECK(same_projections);
         }
         else
             printf("Could not open citm_catalog.json\n");
     }
+
+#ifdef STBJ_ENABLE_TRACE
+    {
+        // Trace test ------------------------
+        // name and key functions scan from the cursor to the end of the value they read
+        printf("TRACE -----------------------------\n");
+        char doc[] = "{\"a\": 1, \"bb\": [1, 2], \"c\": \"xyz\"}";
+        stbj_size string_end = (stbj_size)sizeof(doc) - 1; // the reader stops past the '}' after "xyz"
+        stbj_key key_c = stbj_make_key("c"), key_bb = stbj_make_key("bb"), key_a = stbj_make_key("a");
+        stbj_cursor context = stbj_load_buffer(doc, sizeof(doc));
+        char str[8];
+        trace_log log;
+        stbj_set_trace_callback(log_trace, &log);
+
+        log.count = 0;
+        stbj_read_string_name(&context, "c", str, 8, "");
+        const stbj_trace_event* name = find_trace(&log, STBJ_TRACE_READ_STRING_NAME);
+        CHECK(find_trace(&log, STBJ_TRACE_FIND_NAME) && find_trace(&log, STBJ_TRACE_READ_STRING_INDEX));
+        CHECK(name && name->scanned == string_end && strcmp(name->name, "c") == 0);
+
+        log.count = 0;
+        stbj_read_string_key(&context, &key_c, str, 8, "");
+        const stbj_trace_event* key = find_trace(&log, STBJ_TRACE_READ_STRING_KEY);
+        CHECK(key && key->scanned == string_end && find_trace(&log, STBJ_TRACE_FIND_KEY));
+        CHECK(!find_trace(&log, STBJ_TRACE_READ_STRING_NAME) && !find_trace(&log, STBJ_TRACE_FIND_NAME));
+
+        // the same member read by name and by key reports the same distance
+        log.count = 0;
+        stbj_move_cursor_name(&context, "bb");
+        stbj_move_cursor_key(&context, &key_bb);
+        stbj_read_int_name(&context, "a", 0);
+        stbj_read_int_key(&context, &key_a, 0);
+        stbj_read_double_name(&context, "a", 0.0);
+        stbj_read_double_key(&context, &key_a, 0.0);
+        const stbj_trace_event* pairs[][2] = {
+            { find_trace(&log, STBJ_TRACE_MOVE_CURSOR_NAME), find_trace(&log, STBJ_TRACE_MOVE_CURSOR_KEY) },
+            { find_trace(&log, STBJ_TRACE_READ_INT_NAME), find_trace(&log, STBJ_TRACE_READ_INT_KEY) },
+            { find_trace(&log, STBJ_TRACE_READ_DOUBLE_NAME), find_trace(&log, STBJ_TRACE_READ_DOUBLE_KEY) } };
+        for(int i = 0; i < 3; ++i)
+            CHECK(pairs[i][0] && pairs[i][1] && pairs[i][0]->scanned > 0 && pairs[i][0]->scanned == pairs[i][1]->scanned);
+        CHECK(pairs[0][0] && pairs[0][0]->scanned == (stbj_size)(strchr(doc, '[') - doc));
+
+        // a missing name scans the whole object
+        log.count = 0;
+        stbj_read_int_name(&context, "missing", 0);
+        name = find_trace(&log, STBJ_TRACE_READ_INT_NAME);
+        CHECK(name && name->scanned == (stbj_size)(strrchr(doc, '}') - doc));
+
+        stbj_set_trace_callback(0, 0);
+    }
+#endif
+
+    printf("%i checks failed\n", checks_failed);
+    return checks_failed != 0;
 }
 
@@ -0,0 +1,149 @@
+// Parses the citm catalog sample with the generated citm_catalog_parse.h and checks
+// the fields against the generic API. numbers_parse.h (from numbers.json) checks the
+// number parsers
+//
+// Usage: citm_test <citm_catalog.json>
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#define STB_JSON_IMPLEMENTATION
+#include "../../src/stb_json.h"
+
+#define CATALOG_PARSE_IMPLEMENTATION
+#include "citm_catalog_parse.h"
+
+#define NUMBERS_PARSE_IMPLEMENTATION
+#include "numbers_parse.h"
+
+#define MB 1048576
+
+static int checks_failed = 0;
+#define CHECK(x) do { if(!(x)) { printf("CHECK FAILED %s:%i: %s\n", __FILE__, __LINE__, #x); ++checks_failed; } } while(0)
+
+static char buf[2*MB + STBJ_PADDING];
+
+// 1 if the generated string holds the same text stbj_read_string_name reads. The
+// generated one keeps escapes, \" and the like are compared without the backslash
+static int same_string(stbj_gen_string value, stbj_cursor* object, const char* name)
+{
+    char str[256], plain[256];
+    stbj_size len = 0;
+    stbj_read_string_name(object, name, str, sizeof(str), "");
+    for(stbj_size i = 0; i < value.len && len < sizeof(plain); ++i)
+    {
+        if(value.at[i] == '\\')
+            ++i;
+        plain[len++] = value.at[i];
+    }
+    return len == strlen(str) && memcmp(plain, str, len) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage: citm_test <citm_catalog.json>\n");
+        return 1;
+    }
+
+    FILE* fp = fopen(argv[1], "rb");
+    if(!fp)
+    {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+    int len = (int)fread(buf, 1, 2*MB, fp);
+    fclose(fp);
+
+    int error;
+    Catalog catalog;
+    stbj_cursor root = stbj_load_buffer(buf, (stbj_size)len);
+    CHECK(stbj_parse_Catalog(&root, &catalog, &error) == 11 && error == 0);
+    CHECK(catalog.present == 0x7ff);
+    stbj_cursor venue_names = stbj_move_cursor_name(&root, "venueNames");
+    CHECK(catalog.venueNames.present == 1 && same_string(catalog.venueNames.PLEYEL_PLEYEL, &venue_names, "PLEYEL_PLEYEL"));
+
+    // every event, members of an object
+    stbj_cursor events = stbj_move_cursor_name(&root, "events");
+    int num_events = stbj_count_values(&events);
+    CHECK(num_events > 0 && catalog.events.cursor == events.cursor);
+
+    int same_events = 1;
+    for(int i = 0; i < num_events; ++i)
+    {
+        Catalog_events_item event;
+        stbj_cursor object = stbj_move_cursor_index(&events, i);
+        same_events &= (stbj_parse_Catalog_events_item(&object, &event, &error) > 0 && error == 0);
+        same_events &= (event.id == (long long)stbj_read_double_name(&object, "id", -1.0));
+        same_events &= same_string(event.name, &object, "name");
+
+        stbj_cursor sub_topics = stbj_move_cursor_name(&object, "subTopicIds");
+        same_events &= (event.subTopicIds.cursor == sub_topics.cursor);
+    }
+    CHECK(same_events);
+
+    // every performance, elements of an array
+    stbj_cursor performances = stbj_move_cursor_name(&root, "performances");
+    int num_performances = stbj_count_values(&catalog.performances);
+    CHECK(num_performances > 0 && num_performances == stbj_count_values(&performances));
+
+    int same_performances = 1, areas = 0;
+    for(int i = 0; i < num_performances; ++i)
+    {
+        Catalog_performances_item performance;
+        stbj_cursor object = stbj_move_cursor_index(&catalog.performances, i);
+        same_performances &= (stbj_parse_Catalog_performances_item(&object, &performance, &error) > 0 && error == 0);
+        same_performances &= (performance.id == (long long)stbj_read_double_name(&object, "id", -1.0));
+        same_performances &= (performance.eventId == (long long)stbj_read_double_name(&object, "eventId", -1.0));
+        same_performances &= (performance.start == (long long)stbj_read_double_name(&object, "start", -1.0));
+        same_performances &= same_string(performance.venueCode, &object, "venueCode");
+
+        int num_categories = stbj_count_values(&performance.seatCategories);
+        for(int c = 0; c < num_categories; ++c)
+        {
+            Catalog_performances_item_seatCategories_item category;
+            stbj_cursor category_object = stbj_move_cursor_index(&performance.seatCategories, c);
+            same_performances &= (stbj_parse_Catalog_performances_item_seatCategories_item(&category_object, &category, &error) == 2);
+            areas += stbj_count_values(&category.areas);
+        }
+    }
+    CHECK(same_performances && areas > 0);
+
+    // not a catalog
+    char array[] = "[1, 2]";
+    stbj_cursor context = stbj_load_buffer(array, sizeof(array));
+    CHECK(stbj_parse_Catalog(&context, &catalog, &error) == -1 && error == 6);
+
+    // every number grammar, exact when it fits
+    char numbers[] = "{\"x\": 1.5e2, \"y\": -0.5E-3, \"n\": 42 }";
+    Numbers number;
+    context = stbj_load_buffer(numbers, sizeof(numbers));
+    CHECK(stbj_parse_Numbers(&context, &number, &error) == 3 && error == 0);
+    CHECK(number.x == 150.0 && number.y == -0.5E-3 && number.n == 42);
+
+    char big_numbers[] = "{\"x\": 0.3, \"y\": 2.2250738585072014e-308, \"n\": -7}";
+    context = stbj_load_buffer(big_numbers, sizeof(big_numbers));
+    CHECK(stbj_parse_Numbers(&context, &number, &error) == 3 && number.x == 0.3 && number.y > 0.0 && number.n == -7);
+
+    // malformed numbers are errors, not missing fields
+    const char* bad_numbers[] = { "{\"x\": 1.5e}", "{\"x\": 1.}", "{\"x\": -}", "{\"x\": 1.5x}", "{\"n\": 1e3}", "{\"n\": 2.5}" };
+    for(int i = 0; i < 6; ++i)
+    {
+        context = stbj_load_buffer(bad_numbers[i], (stbj_size)strlen(bad_numbers[i]) + 1);
+        CHECK(stbj_parse_Numbers(&context, &number, &error) == -1 && error == 7);
+    }
+
+    // other types are not numbers, the field is left out
+    char not_numbers[] = "{\"x\": null, \"n\": \"3\"}";
+    context = stbj_load_buffer(not_numbers, sizeof(not_numbers));
+    CHECK(stbj_parse_Numbers(&context, &number, &error) == 0 && error == 0 && number.present == 0);
+
+    printf("%i events, %i performances, %i areas\n", num_events, num_performances, areas);
+    printf("%i checks failed\n", checks_failed);
+    return checks_failed != 0;
+}
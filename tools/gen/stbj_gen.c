@@ -0,0 +1,824 @@
+// stbj_gen - writes specialized parsers for a fixed JSON format
+//
+// Usage: stbj_gen <input.json> <TypeName> [output.h]
+//
+// input.json is a sample document (types are inferred from every value found in it)
+// or a JSON Schema (an object with "$schema", or "type" and "properties"). The output
+// is a header with one struct and one stbj_parse_<Type> function per object type:
+//
+//      int stbj_parse_Catalog(const stbj_cursor* object, Catalog* out, int* error);
+//
+// The function walks the members of object once, finds the field with a switch on
+// the name length and first byte, and reads the value with a parser for its type.
+// Returns the number of fields read or -1 on error. Strings are slices of the buffer
+// (escapes kept), arrays, maps and values of mixed types are stbj_cursor, to be read
+// with the generic API. Objects whose keys are all numbers, or that have more than 64
+// different keys, are maps.
+//
+// Include stb_json.h before the generated header, and #define <TYPENAME>_PARSE_IMPLEMENTATION
+// in one file like STB_JSON_IMPLEMENTATION.
+//
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_JSON_IMPLEMENTATION
+#include "../../src/stb_json.h"
+
+#define GEN_MAX_FIELDS 64
+
+enum gen_kinds
+{
+    GEN_NULL = 1, GEN_BOOL = 2, GEN_INT = 4, GEN_DOUBLE = 8, GEN_STRING = 16, GEN_OBJECT = 32, GEN_ARRAY = 64
+};
+
+// what a field becomes in the generated struct
+enum gen_field_types { GEN_T_NONE, GEN_T_BOOL, GEN_T_INT, GEN_T_DOUBLE, GEN_T_STRING, GEN_T_STRUCT, GEN_T_CURSOR };
+
+typedef struct gen_node gen_node;
+
+typedef struct
+{
+    char* key;          // as in the document, escapes kept
+    int key_len;
+    char ident[64];     // C identifier
+    gen_node* node;
+} gen_field;
+
+struct gen_node
+{
+    int kinds;
+    int is_map;
+    gen_field* fields;
+    int num_fields;
+    gen_node* item;     // array elements and map values
+    char type_name[256];
+    int emitted;
+};
+
+static void* gen_alloc(size_t size)
+{
+    void* p = calloc(1, size);
+    if(!p) { fprintf(stderr, "stbj_gen: out of memory\n"); exit(1); }
+    return p;
+}
+
+static gen_node* gen_item(gen_node* node)
+{
+    if(!node->item) node->item = (gen_node*)gen_alloc(sizeof(gen_node));
+    return node->item;
+}
+
+static void gen_merge(gen_node* dst, const gen_node* src);
+
+static gen_field* gen_field_of(gen_node* node, const char* key, int key_len)
+{
+    for(int i = 0; i < node->num_fields; ++i)
+        if(node->fields[i].key_len == key_len && memcmp(node->fields[i].key, key, (size_t)key_len) == 0)
+            return &node->fields[i];
+
+    if(!node->fields)
+        node->fields = (gen_field*)gen_alloc(sizeof(gen_field) * (GEN_MAX_FIELDS + 1));
+
+    gen_field* field = &node->fields[node->num_fields++];
+    field->key = (char*)gen_alloc((size_t)key_len + 1);
+    memcpy(field->key, key, (size_t)key_len);
+    field->key_len = key_len;
+    field->node = (gen_node*)gen_alloc(sizeof(gen_node));
+    return field;
+}
+
+// too many different keys to be a struct, all values go to the item
+static void gen_make_map(gen_node* node)
+{
+    node->is_map = 1;
+    for(int i = 0; i < node->num_fields; ++i)
+        gen_merge(gen_item(node), node->fields[i].node);
+    node->num_fields = 0;
+}
+
+static void gen_merge(gen_node* dst, const gen_node* src)
+{
+    dst->kinds |= src->kinds;
+    if(src->item)
+        gen_merge(gen_item(dst), src->item);
+
+    if(src->is_map && !dst->is_map)
+        gen_make_map(dst);
+
+    for(int i = 0; i < src->num_fields; ++i)
+    {
+        if(dst->is_map)
+            gen_merge(gen_item(dst), src->fields[i].node);
+        else
+        {
+            gen_field* field = gen_field_of(dst, src->fields[i].key, src->fields[i].key_len);
+            gen_merge(field->node, src->fields[i].node);
+            if(dst->num_fields > GEN_MAX_FIELDS)
+                gen_make_map(dst);
+        }
+    }
+}
+
+///////////////////////////////////////////////
+//
+//  Types from a sample document
+//
+
+static const char* gen_skip_whitespace(const char* p)
+{
+    while(*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') ++p;
+    return p;
+}
+
+static void gen_infer_container(gen_node* node, const stbj_cursor* context);
+
+static void gen_infer_value(gen_node* node, const stbj_cursor* element)
+{
+    int error = 0;
+    const char* value = stbj_find_index_r(element, 0, &error);
+    if(!value)
+        return;
+
+    value = gen_skip_whitespace(value);
+    switch(*value)
+    {
+        case '{': case '[':
+        {
+            stbj_cursor context = stbj_move_cursor_index_r(element, 0, &error);
+            if(context.type != STBJ_ERROR)
+                gen_infer_container(node, &context);
+        } break;
+        case '"': node->kinds |= GEN_STRING; break;
+        case 't': case 'f': node->kinds |= GEN_BOOL; break;
+        case 'n': node->kinds |= GEN_NULL; break;
+        default:
+        {
+            int kind = GEN_INT;
+            for(const char* p = value; (*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E'; ++p)
+                if(*p == '.' || *p == 'e' || *p == 'E') kind = GEN_DOUBLE;
+            node->kinds |= kind;
+        }
+    }
+}
+
+static int gen_is_number(const char* key, stbj_size len)
+{
+    if(len == 0) return 0;
+    for(stbj_size i = 0; i < len; ++i)
+        if(key[i] < '0' || key[i] > '9') return 0;
+    return 1;
+}
+
+static void gen_infer_container(gen_node* node, const stbj_cursor* context)
+{
+    stbj_iterator it;
+    int error = 0;
+
+    if(context->type == STBJ_ARRAY)
+    {
+        node->kinds |= GEN_ARRAY;
+        stbj_iterator_init(context, &it);
+        while(stbj_iterate_r(context, &it, &error))
+            gen_infer_value(gen_item(node), &it.element);
+        return;
+    }
+
+    node->kinds |= GEN_OBJECT;
+
+    // ids used as keys ("138586341": {...}) make a map
+    int numbers = 0, members = 0;
+    stbj_iterator_init(context, &it);
+    while(stbj_iterate_r(context, &it, &error))
+    {
+        ++members;
+        numbers += gen_is_number(it.name, it.name_len);
+    }
+    if(members > 0 && numbers == members && !node->is_map)
+        gen_make_map(node);
+
+    stbj_iterator_init(context, &it);
+    while(stbj_iterate_r(context, &it, &error))
+    {
+        if(!it.name)
+            continue;
+        if(node->is_map)
+            gen_infer_value(gen_item(node), &it.element);
+        else
+        {
+            gen_infer_value(gen_field_of(node, it.name, (int)it.name_len)->node, &it.element);
+            if(node->num_fields > GEN_MAX_FIELDS)
+                gen_make_map(node);
+        }
+    }
+}
+
+///////////////////////////////////////////////
+//
+//  Types from a JSON Schema
+//
+
+static int gen_schema_type(const char* type, int len)
+{
+    static const struct { const char* name; int kinds; } types[] =
+    {
+        { "null", GEN_NULL }, { "boolean", GEN_BOOL }, { "integer", GEN_INT }, { "number", GEN_DOUBLE },
+        { "string", GEN_STRING }, { "object", GEN_OBJECT }, { "array", GEN_ARRAY },
+    };
+
+    for(unsigned int i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+        if((int)strlen(types[i].name) == len && memcmp(types[i].name, type, (size_t)len) == 0)
+            return types[i].kinds;
+    return 0;
+}
+
+// Reads "type": "string" or "type": ["string", "null"]
+static int gen_schema_kinds(stbj_cursor* schema)
+{
+    char type[32];
+    int kinds = 0;
+
+    if(stbj_find_name(schema, "type") < 0)
+        return 0;
+
+    stbj_cursor list = stbj_move_cursor_name(schema, "type");
+    if(list.type == STBJ_ARRAY)
+    {
+        stbj_iterator it;
+        stbj_iterator_init(&list, &it);
+        while(stbj_iterate(&list, &it))
+        {
+            int len = stbj_read_string_index(&it.element, 0, type, sizeof(type), "");
+            kinds |= gen_schema_type(type, len);
+        }
+        return kinds;
+    }
+
+    int len = stbj_read_string_name(schema, "type", type, sizeof(type), "");
+    return gen_schema_type(type, len);
+}
+
+static void gen_from_schema(gen_node* node, stbj_cursor* schema)
+{
+    node->kinds |= gen_schema_kinds(schema);
+
+    stbj_cursor properties = stbj_move_cursor_name(schema, "properties");
+    if(properties.type == STBJ_OBJECT)
+    {
+        stbj_iterator it;
+        node->kinds |= GEN_OBJECT;
+        stbj_iterator_init(&properties, &it);
+        while(stbj_iterate(&properties, &it))
+        {
+            stbj_cursor property = stbj_move_cursor_index(&it.element, 0);
+            if(it.name && property.type == STBJ_OBJECT)
+                gen_from_schema(gen_field_of(node, it.name, (int)it.name_len)->node, &property);
+        }
+        if(node->num_fields > GEN_MAX_FIELDS)
+            gen_make_map(node);
+    }
+    else if(node->kinds & GEN_OBJECT)
+    {
+        stbj_cursor values = stbj_move_cursor_name(schema, "additionalProperties");
+        node->is_map = 1;
+        if(values.type == STBJ_OBJECT)
+            gen_from_schema(gen_item(node), &values);
+    }
+
+    stbj_cursor items = stbj_move_cursor_name(schema, "items");
+    if(items.type == STBJ_OBJECT)
+    {
+        node->kinds |= GEN_ARRAY;
+        gen_from_schema(gen_item(node), &items);
+    }
+}
+
+///////////////////////////////////////////////
+//
+//  Output
+//
+
+static int gen_field_type(const gen_node* node)
+{
+    int kinds = node->kinds & ~GEN_NULL;
+
+    switch(kinds)
+    {
+        case 0: return GEN_T_NONE;
+        case GEN_BOOL: return GEN_T_BOOL;
+        case GEN_INT: return GEN_T_INT;
+        case GEN_DOUBLE: case GEN_INT | GEN_DOUBLE: return GEN_T_DOUBLE;
+        case GEN_STRING: return GEN_T_STRING;
+        case GEN_OBJECT: return (!node->is_map && node->num_fields > 0) ? GEN_T_STRUCT : GEN_T_CURSOR;
+        default: return GEN_T_CURSOR;
+    }
+}
+
+static void gen_identifier(char* ident, size_t size, const char* key, int key_len)
+{
+    size_t len = 0;
+    if(key_len == 0 || (key[0] >= '0' && key[0] <= '9'))
+        ident[len++] = '_';
+
+    for(int i = 0; i < key_len && len < size - 1; ++i)
+    {
+        char c = key[i];
+        int alnum = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        ident[len++] = (alnum) ? c : '_';
+    }
+    ident[len] = 0;
+}
+
+// C identifiers for every field, unique in their struct
+static void gen_identifiers(gen_node* node)
+{
+    for(int i = 0; i < node->num_fields; ++i)
+    {
+        gen_field* field = &node->fields[i];
+        char base[48];
+        gen_identifier(base, sizeof(base), field->key, field->key_len);
+        strcpy(field->ident, base);
+
+        for(int suffix = 2, j = 0; j < i; ++j)
+        {
+            if(strcmp(node->fields[j].ident, field->ident) == 0)
+            {
+                sprintf(field->ident, "%s_%i", base, suffix++);
+                j = -1;
+            }
+        }
+    }
+}
+
+static void gen_string_literal(FILE* out, const char* bytes, int len)
+{
+    fputc('"', out);
+    for(int i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)bytes[i];
+        if(c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if(c < 0x20 || c >= 0x7f || c == '?') fprintf(out, "\\%03o", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void gen_emit_struct(FILE* out, gen_node* node, const char* type_name);
+
+// 1 << field type for every field written, to leave out unused helpers
+static int gen_used_types = 0;
+
+// Struct types reachable from node through arrays and maps
+static void gen_emit_items(FILE* out, gen_node* node, const char* base)
+{
+    char name[256];
+    gen_node* item = node->item;
+    if(!item)
+        return;
+
+    snprintf(name, sizeof(name), "%s_item", base);
+    if(gen_field_type(item) == GEN_T_STRUCT)
+        gen_emit_struct(out, item, name);
+    else
+        gen_emit_items(out, item, name);
+}
+
+static const char* gen_describe(const gen_node* node)
+{
+    static char text[300];
+    const gen_node* item = node->item;
+    while(item && !item->type_name[0] && item->item)
+        item = item->item;
+
+    if(item && item->type_name[0])
+        snprintf(text, sizeof(text), "%s of %s", (node->kinds & GEN_ARRAY) ? "array" : "object", item->type_name);
+    else if((node->kinds & ~GEN_NULL) == GEN_ARRAY)
+        snprintf(text, sizeof(text), "array");
+    else if((node->kinds & ~GEN_NULL) == GEN_OBJECT)
+        snprintf(text, sizeof(text), "object");
+    else
+        snprintf(text, sizeof(text), "mixed types");
+    return text;
+}
+
+static void gen_emit_struct(FILE* out, gen_node* node, const char* type_name)
+{
+    char name[256];
+
+    if(node->emitted)
+        return;
+    node->emitted = 1;
+    snprintf(node->type_name, sizeof(node->type_name), "%s", type_name);
+    gen_identifiers(node);
+
+    // nested types first
+    for(int i = 0; i < node->num_fields; ++i)
+    {
+        gen_field* field = &node->fields[i];
+        snprintf(name, sizeof(name), "%s_%s", type_name, field->ident);
+        if(gen_field_type(field->node) == GEN_T_STRUCT)
+            gen_emit_struct(out, field->node, name);
+        else
+            gen_emit_items(out, field->node, name);
+    }
+
+    fprintf(out, "typedef struct\n{\n");
+    fprintf(out, "    unsigned long long present;   // bit n is set when field n was read\n");
+    for(int i = 0; i < node->num_fields; ++i)
+    {
+        gen_field* field = &node->fields[i];
+        gen_used_types |= 1 << gen_field_type(field->node);
+        switch(gen_field_type(field->node))
+        {
+            case GEN_T_BOOL:   fprintf(out, "    int %s;", field->ident); break;
+            case GEN_T_INT:    fprintf(out, "    long long %s;", field->ident); break;
+            case GEN_T_DOUBLE: fprintf(out, "    double %s;", field->ident); break;
+            case GEN_T_STRING: fprintf(out, "    stbj_gen_string %s;", field->ident); break;
+            case GEN_T_STRUCT: fprintf(out, "    %s %s;", field->node->type_name, field->ident); break;
+            case GEN_T_CURSOR: fprintf(out, "    stbj_cursor %s; // %s", field->ident, gen_describe(field->node)); break;
+            default:
+                fprintf(out, "    // %i ", i);
+                gen_string_literal(out, field->key, field->key_len);
+                fprintf(out, " is always null\n");
+            continue;
+        }
+        fprintf(out, " // %i ", i);
+        gen_string_literal(out, field->key, field->key_len);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "} %s;\n\n", type_name);
+    fprintf(out, "STBJ_GEN_DEF int stbj_parse_%s(const stbj_cursor* object, %s* out, int* error);\n\n", type_name, type_name);
+}
+
+static void gen_emit_function(FILE* out, gen_node* node)
+{
+    int max_len = 0;
+
+    if(node->emitted != 1)
+        return;
+    node->emitted = 2;
+
+    for(int i = 0; i < node->num_fields; ++i)
+    {
+        gen_node* child = node->fields[i].node;
+        gen_emit_function(out, child);
+        for(gen_node* item = child->item; item; item = item->item)
+            gen_emit_function(out, item);
+        if(node->fields[i].key_len > max_len)
+            max_len = node->fields[i].key_len;
+    }
+
+    const char* type_name = node->type_name;
+    fprintf(out, "STBJ_GEN_DEF int stbj_parse_%s(const stbj_cursor* object, %s* out, int* error)\n{\n", type_name, type_name);
+    fprintf(out, "    stbj_iterator it;\n");
+    fprintf(out, "    int found = 0;\n\n");
+    fprintf(out, "    memset(out, 0, sizeof(*out));\n");
+    fprintf(out, "    *error = 6;\n");
+    fprintf(out, "    if(object->type != STBJ_OBJECT)\n        return -1;\n\n");
+    fprintf(out, "    *error = 0;\n");
+    fprintf(out, "    stbj_iterator_init(object, &it);\n");
+    fprintf(out, "    while(stbj_iterate_r(object, &it, error))\n    {\n");
+    fprintf(out, "        int field = -1, ok = 0;\n\n");
+
+    // switch on the length, then on the first byte, then one memcmp
+    fprintf(out, "        switch(it.name_len)\n        {\n");
+    for(int len = 0; len <= max_len; ++len)
+    {
+        int any = 0;
+        for(int i = 0; i < node->num_fields; ++i)
+            any |= (node->fields[i].key_len == len && gen_field_type(node->fields[i].node) != GEN_T_NONE);
+        if(!any)
+            continue;
+
+        fprintf(out, "            case %i:\n", len);
+        if(len == 0)
+        {
+            for(int i = 0; i < node->num_fields; ++i)
+                if(node->fields[i].key_len == 0)
+                    fprintf(out, "                field = %i;\n", i);
+            fprintf(out, "                break;\n");
+            continue;
+        }
+
+        fprintf(out, "                switch((unsigned char)it.name[0])\n                {\n");
+        for(int c = 0; c < 256; ++c)
+        {
+            int first = 1;
+            for(int i = 0; i < node->num_fields; ++i)
+            {
+                gen_field* field = &node->fields[i];
+                if(field->key_len != len || (unsigned char)field->key[0] != c || gen_field_type(field->node) == GEN_T_NONE)
+                    continue;
+
+                if(first && c >= ' ' && c < 0x7f && c != '\'' && c != '\\')
+                    fprintf(out, "                    case '%c':\n", c);
+                else if(first)
+                    fprintf(out, "                    case %i:\n", c);
+
+                fprintf(out, "                        %sif(memcmp(it.name, ", (first) ? "" : "else ");
+                first = 0;
+                gen_string_literal(out, field->key, field->key_len);
+                fprintf(out, ", %i) == 0) field = %i;\n", len, i);
+            }
+            if(!first)
+                fprintf(out, "                        break;\n");
+        }
+        fprintf(out, "                }\n");
+        fprintf(out, "                break;\n");
+    }
+    fprintf(out, "        }\n\n");
+
+    fprintf(out, "        switch(field)\n        {\n");
+    for(int i = 0; i < node->num_fields; ++i)
+    {
+        gen_field* field = &node->fields[i];
+        const char* ident = field->ident;
+        switch(gen_field_type(field->node))
+        {
+            case GEN_T_BOOL:   fprintf(out, "            case %i: ok = stbj_gen__bool(&it, &out->%s); break;\n", i, ident); break;
+            case GEN_T_INT:    fprintf(out, "            case %i: ok = stbj_gen__int(&it, &out->%s); break;\n", i, ident); break;
+            case GEN_T_DOUBLE: fprintf(out, "            case %i: ok = stbj_gen__double(&it, &out->%s); break;\n", i, ident); break;
+            case GEN_T_STRING: fprintf(out, "            case %i: ok = stbj_gen__string(&it, &out->%s); break;\n", i, ident); break;
+            case GEN_T_CURSOR: fprintf(out, "            case %i: ok = stbj_gen__cursor(object, &it, &out->%s); break;\n", i, ident); break;
+            case GEN_T_STRUCT:
+                fprintf(out, "            case %i:\n            {\n", i);
+                fprintf(out, "                stbj_cursor member;\n");
+                fprintf(out, "                if(stbj_gen__cursor(object, &it, &member) && member.type == STBJ_OBJECT)\n");
+                fprintf(out, "                {\n");
+                fprintf(out, "                    if(stbj_parse_%s(&member, &out->%s, error) < 0)\n", field->node->type_name, ident);
+                fprintf(out, "                        return -1;\n");
+                fprintf(out, "                    ok = 1;\n");
+                fprintf(out, "                }\n");
+                fprintf(out, "            } break;\n");
+            break;
+            default: break;
+        }
+    }
+    fprintf(out, "            default: continue;\n");
+    fprintf(out, "        }\n\n");
+    fprintf(out, "        if(ok < 0)\n        {\n");
+    fprintf(out, "            *error = 7;\n");
+    fprintf(out, "            return -1;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "        if(ok)\n        {\n");
+    fprintf(out, "            out->present |= 1ull << field;\n");
+    fprintf(out, "            ++found;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n\n");
+    fprintf(out, "    return (*error) ? -1 : found;\n");
+    fprintf(out, "}\n\n");
+}
+
+// Helpers used by the generated functions, each one once per file
+static const char* gen_helpers[] =
+{
+    // GEN_T_NONE: the value of a member
+    "#ifndef STBJ_GEN_VALUE\n"
+    "#define STBJ_GEN_VALUE\n"
+    "// First byte of the value of the member at it, 0 if there is none\n"
+    "static const char* stbj_gen__value(const stbj_iterator* it)\n"
+    "{\n"
+    "    const char* p = it->name + it->name_len + 1;\n"
+    "    while(p < it->next && (*p == ' ' || *p == '\\n' || *p == '\\r' || *p == '\\t')) ++p;\n"
+    "    if(p >= it->next || *p++ != ':')\n"
+    "        return 0;\n"
+    "    while(p < it->next && (*p == ' ' || *p == '\\n' || *p == '\\r' || *p == '\\t')) ++p;\n"
+    "    return (p < it->next) ? p : 0;\n"
+    "}\n"
+    "#endif\n\n",
+    // GEN_T_BOOL
+    "#ifndef STBJ_GEN_BOOL\n"
+    "#define STBJ_GEN_BOOL\n"
+    "static int stbj_gen__bool(const stbj_iterator* it, int* out)\n"
+    "{\n"
+    "    const char* p = stbj_gen__value(it);\n"
+    "    if(!p || (*p != 't' && *p != 'f'))\n"
+    "        return 0;\n"
+    "    *out = (*p == 't');\n"
+    "    return 1;\n"
+    "}\n"
+    "#endif\n\n",
+    // GEN_T_INT
+    "#ifndef STBJ_GEN_INT\n"
+    "#define STBJ_GEN_INT\n"
+    "// Plain integers, up to 19 digits. -1 for a fraction, an exponent or a malformed number\n"
+    "static int stbj_gen__int(const stbj_iterator* it, long long* out)\n"
+    "{\n"
+    "    const char* p = stbj_gen__value(it);\n"
+    "    unsigned long long value = 0;\n"
+    "    int negative = 0;\n"
+    "    if(!p || (*p != '-' && (*p < '0' || *p > '9')))\n"
+    "        return 0;\n"
+    "    if(*p == '-') { negative = 1; ++p; }\n"
+    "    if(p >= it->next || *p < '0' || *p > '9')\n"
+    "        return -1;\n"
+    "    while(p < it->next && *p >= '0' && *p <= '9')\n"
+    "        value = 10 * value + (unsigned long long)(*p++ - '0');\n"
+    "    while(p < it->next && (*p == ' ' || *p == '\\n' || *p == '\\r' || *p == '\\t')) ++p;\n"
+    "    if(p < it->next)\n"
+    "        return -1;\n"
+    "    *out = (long long)((negative) ? 0ull - value : value);\n"
+    "    return 1;\n"
+    "}\n"
+    "#endif\n\n",
+    // GEN_T_DOUBLE
+    "#ifndef STBJ_GEN_DOUBLE\n"
+    "#define STBJ_GEN_DOUBLE\n"
+    "// The whole JSON number grammar, -1 for a malformed number. Exact when the digits fit\n"
+    "// in 53 bits and the exponent is within 22, the rest goes to stbj_read_double_index_r\n"
+    "static int stbj_gen__double(const stbj_iterator* it, double* out)\n"
+    "{\n"
+    "    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,\n"
+    "        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };\n"
+    "    const char* p = stbj_gen__value(it);\n"
+    "    const char* end = it->next;\n"
+    "    unsigned long long mantissa = 0;\n"
+    "    int exponent = 0, negative = 0, error = 0;\n"
+    "    if(!p || (*p != '-' && (*p < '0' || *p > '9')))\n"
+    "        return 0;\n"
+    "    if(*p == '-') { negative = 1; ++p; }\n"
+    "    if(p >= end || *p < '0' || *p > '9')\n"
+    "        return -1;\n"
+    "    if(*p == '0')\n"
+    "        ++p;\n"
+    "    for(; p < end && *p >= '0' && *p <= '9'; ++p)\n"
+    "    {\n"
+    "        if(mantissa < 100000000000000000ull) mantissa = 10 * mantissa + (unsigned long long)(*p - '0');\n"
+    "        else ++exponent;\n"
+    "    }\n"
+    "    if(p < end && *p == '.')\n"
+    "    {\n"
+    "        if(++p >= end || *p < '0' || *p > '9')\n"
+    "            return -1;\n"
+    "        for(; p < end && *p >= '0' && *p <= '9'; ++p)\n"
+    "            if(mantissa < 100000000000000000ull) { mantissa = 10 * mantissa + (unsigned long long)(*p - '0'); --exponent; }\n"
+    "    }\n"
+    "    if(p < end && (*p == 'e' || *p == 'E'))\n"
+    "    {\n"
+    "        int sign = 1, value = 0;\n"
+    "        if(++p < end && (*p == '-' || *p == '+'))\n"
+    "            sign = (*p++ == '-') ? -1 : 1;\n"
+    "        if(p >= end || *p < '0' || *p > '9')\n"
+    "            return -1;\n"
+    "        for(; p < end && *p >= '0' && *p <= '9'; ++p)\n"
+    "            if(value < 10000) value = 10 * value + (*p - '0');\n"
+    "        exponent += sign * value;\n"
+    "    }\n"
+    "    while(p < end && (*p == ' ' || *p == '\\n' || *p == '\\r' || *p == '\\t')) ++p;\n"
+    "    if(p < end)\n"
+    "        return -1;\n"
+    "    if(mantissa == 0)\n"
+    "        *out = (negative) ? -0.0 : 0.0;\n"
+    "    else if(mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)\n"
+    "    {\n"
+    "        *out = (exponent < 0) ? (double)mantissa / powers[-exponent] : (double)mantissa * powers[exponent];\n"
+    "        if(negative) *out = -*out;\n"
+    "    }\n"
+    "    else\n"
+    "        *out = stbj_read_double_index_r(&it->element, 0, 0.0, &error);\n"
+    "    return (error) ? -1 : 1;\n"
+    "}\n"
+    "#endif\n\n",
+    // GEN_T_STRING
+    "#ifndef STBJ_GEN_STRING_VALUE\n"
+    "#define STBJ_GEN_STRING_VALUE\n"
+    "static int stbj_gen__string(const stbj_iterator* it, stbj_gen_string* out)\n"
+    "{\n"
+    "    const char* p = stbj_gen__value(it);\n"
+    "    const char* end;\n"
+    "    if(!p || *p != '\"')\n"
+    "        return 0;\n"
+    "    for(end = ++p; end < it->next && *end != '\"'; end += (*end == '\\\\') ? 2 : 1);\n"
+    "    if(end >= it->next)\n"
+    "        return 0;\n"
+    "    out->at = p;\n"
+    "    out->len = (stbj_size)(end - p);\n"
+    "    return 1;\n"
+    "}\n"
+    "#endif\n\n",
+    // GEN_T_STRUCT: nothing
+    "",
+    // GEN_T_CURSOR, also used by structs
+    "#ifndef STBJ_GEN_CURSOR\n"
+    "#define STBJ_GEN_CURSOR\n"
+    "// Arrays and objects, with the structural index of the parent if it has one\n"
+    "static int stbj_gen__cursor(const stbj_cursor* object, const stbj_iterator* it, stbj_cursor* out)\n"
+    "{\n"
+    "    int error = 0;\n"
+    "    *out = stbj_move_cursor_index_r(&it->element, 0, &error);\n"
+    "    out->struct_index = object->struct_index;\n"
+    "    return out->type != STBJ_ERROR;\n"
+    "}\n"
+    "#endif\n\n",
+};
+
+static char* gen_read_file(const char* path, size_t* len)
+{
+    FILE* fp = fopen(path, "rb");
+    if(!fp)
+        return 0;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char* buffer = (char*)gen_alloc((size_t)size + 1);
+    *len = fread(buffer, 1, (size_t)size, fp);
+    fclose(fp);
+    return buffer;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: stbj_gen <input.json> <TypeName> [output.h]\n");
+        return 1;
+    }
+
+    size_t len = 0;
+    char* buffer = gen_read_file(argv[1], &len);
+    if(!buffer)
+    {
+        fprintf(stderr, "stbj_gen: could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    stbj_index invalid = stbj_validate(buffer, (stbj_size)len + 1, STBJ_VALIDATE_LENIENT);
+    if(invalid >= 0)
+    {
+        fprintf(stderr, "stbj_gen: %s is not valid JSON at offset %i\n", argv[1], (int)invalid);
+        return 1;
+    }
+
+    stbj_cursor root = stbj_load_buffer(buffer, (stbj_size)len + 1);
+    if(stbj_any_error(&root))
+    {
+        fprintf(stderr, "stbj_gen: %s: %s\n", argv[1], stbj_get_last_error(&root));
+        return 1;
+    }
+
+    gen_node* node = (gen_node*)gen_alloc(sizeof(gen_node));
+    int schema = root.type == STBJ_OBJECT &&
+                 (stbj_find_name(&root, "$schema") >= 0 || (stbj_find_name(&root, "properties") >= 0 && stbj_find_name(&root, "type") >= 0));
+    if(schema)
+        gen_from_schema(node, &root);
+    else
+        gen_infer_container(node, &root);
+
+    // an array at the root is parsed one element at a time
+    while(node->item && gen_field_type(node) != GEN_T_STRUCT)
+        node = node->item;
+    if(gen_field_type(node) != GEN_T_STRUCT)
+    {
+        fprintf(stderr, "stbj_gen: no object with fixed keys in %s\n", argv[1]);
+        return 1;
+    }
+
+    FILE* out = (argc > 3) ? fopen(argv[3], "wb") : stdout;
+    if(!out)
+    {
+        fprintf(stderr, "stbj_gen: could not write %s\n", argv[3]);
+        return 1;
+    }
+
+    char guard[256];
+    size_t g = 0;
+    for(const char* c = argv[2]; *c && g < sizeof(guard) - 32; ++c)
+        guard[g++] = (*c >= 'a' && *c <= 'z') ? (char)(*c - 'a' + 'A') : *c;
+    guard[g] = 0;
+
+    fprintf(out, "// Generated by stbj_gen from %s (%s), do not edit\n", argv[1], (schema) ? "schema" : "sample");
+    fprintf(out, "//\n");
+    fprintf(out, "// Include stb_json.h first and #define %s_PARSE_IMPLEMENTATION in one file.\n", guard);
+    fprintf(out, "// Strings point into the buffer, escapes kept. Arrays, maps and mixed values are\n");
+    fprintf(out, "// cursors for the generic API.\n\n");
+    fprintf(out, "#ifndef %s_PARSE_H\n#define %s_PARSE_H\n\n", guard, guard);
+    fprintf(out, "#ifndef STBJ_GEN_DEF\n#define STBJ_GEN_DEF STBJDEF\n#endif\n\n");
+    fprintf(out, "#ifndef STBJ_GEN_STRING\n#define STBJ_GEN_STRING\n");
+    fprintf(out, "typedef struct\n{\n    const char* at;\n    stbj_size len;\n} stbj_gen_string;\n#endif\n\n");
+
+    gen_emit_struct(out, node, argv[2]);
+
+    fprintf(out, "#endif // %s_PARSE_H\n\n", guard);
+    fprintf(out, "#ifdef %s_PARSE_IMPLEMENTATION\n", guard);
+    fprintf(out, "#include <string.h>\n\n");
+    if(gen_used_types & ((1 << GEN_T_BOOL) | (1 << GEN_T_INT) | (1 << GEN_T_DOUBLE) | (1 << GEN_T_STRING)))
+        fputs(gen_helpers[GEN_T_NONE], out);
+    for(int type = GEN_T_BOOL; type <= GEN_T_STRING; ++type)
+        if(gen_used_types & (1 << type))
+            fputs(gen_helpers[type], out);
+    if(gen_used_types & ((1 << GEN_T_STRUCT) | (1 << GEN_T_CURSOR)))
+        fputs(gen_helpers[GEN_T_CURSOR], out);
+    gen_emit_function(out, node);
+    fprintf(out, "#endif // %s_PARSE_IMPLEMENTATION\n", guard);
+
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}